@@ -0,0 +1,136 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#include "vtkFacetedVisualizerBitSet.h"
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerBitSet::Resize(unsigned int size)
+{
+	if(size < this->Size && size % BitsPerWord != 0)
+	{
+		// keep the bits past the new size unset, the word operations rely on it
+		this->Words[size / BitsPerWord] &= (1UL << (size % BitsPerWord)) - 1;
+	}
+	this->Words.resize((size + BitsPerWord - 1) / BitsPerWord, 0);
+	this->Size = size;
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerBitSet::Clear()
+{
+	for (size_t w = 0; w < this->Words.size(); ++w)
+	{
+		this->Words[w] = 0;
+	}
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerBitSet::Union(const vtkFacetedVisualizerBitSet& other)
+{
+	if(other.Size > this->Size)
+	{
+		this->Resize(other.Size);
+	}
+	const size_t n = other.Words.size();
+	unsigned long *words = n > 0 ? &this->Words[0] : NULL;
+	const unsigned long *otherWords = n > 0 ? &other.Words[0] : NULL;
+	for (size_t w = 0; w < n; ++w)
+	{
+		words[w] |= otherWords[w];
+	}
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerBitSet::Intersect(const vtkFacetedVisualizerBitSet& other)
+{
+	const size_t common = other.Words.size() < this->Words.size() ?
+			other.Words.size() : this->Words.size();
+	for (size_t w = 0; w < common; ++w)
+	{
+		this->Words[w] &= other.Words[w];
+	}
+	for (size_t w = common; w < this->Words.size(); ++w)
+	{
+		this->Words[w] = 0;
+	}
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerBitSet::Subtract(const vtkFacetedVisualizerBitSet& other)
+{
+	const size_t common = other.Words.size() < this->Words.size() ?
+			other.Words.size() : this->Words.size();
+	for (size_t w = 0; w < common; ++w)
+	{
+		this->Words[w] &= ~other.Words[w];
+	}
+}
+
+//----------------------------------------------------------------------------
+unsigned int vtkFacetedVisualizerBitSet::Count() const
+{
+	unsigned int count = 0;
+	for (size_t w = 0; w < this->Words.size(); ++w)
+	{
+		// clears the lowest set bit until the word is empty
+		for (unsigned long word = this->Words[w]; word != 0; word &= word - 1)
+		{
+			++count;
+		}
+	}
+	return count;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFacetedVisualizerBitSet::Any() const
+{
+	for (size_t w = 0; w < this->Words.size(); ++w)
+	{
+		if(this->Words[w] != 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+//----------------------------------------------------------------------------
+int vtkFacetedVisualizerBitSet::NextSetBit(unsigned int from) const
+{
+	if(from >= this->Size)
+	{
+		return -1;
+	}
+	size_t w = from / BitsPerWord;
+	// drop the bits below from in the first word
+	unsigned long word = this->Words[w] & (~0UL << (from % BitsPerWord));
+	while(word == 0)
+	{
+		if(++w == this->Words.size())
+		{
+			return -1;
+		}
+		word = this->Words[w];
+	}
+	unsigned int bit = 0;
+	while((word & 1UL) == 0)
+	{
+		word >>= 1;
+		++bit;
+	}
+	return static_cast< int >(w * BitsPerWord + bit);
+}
@@ -0,0 +1,105 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkFacetedVisualizerBitSet - set of display candidates of a query
+// .SECTION Description
+// Fixed width bit set over the dense indices the faceted visualizer logic gives to the
+// models that can be displayed. Query results are combined a machine word at a time,
+// so union, intersection and difference cost one pass over (number of models / 64)
+// words. The set grows when a bit beyond its size is set; bits beyond the size of
+// the other operand of an operation count as unset.
+
+#ifndef __vtkFacetedVisualizerBitSet_h
+#define __vtkFacetedVisualizerBitSet_h
+
+#include "vtkSlicerFacetedVisualizerModuleLogicExport.h"
+
+// STD includes
+#include <cstddef>
+#include <vector>
+
+class VTK_SLICER_FACETEDVISUALIZER_MODULE_LOGIC_EXPORT vtkFacetedVisualizerBitSet
+{
+public:
+  vtkFacetedVisualizerBitSet()
+  {
+	  this->Size = 0;
+  }
+
+  explicit vtkFacetedVisualizerBitSet(unsigned int size)
+  {
+	  this->Size = 0;
+	  this->Resize(size);
+  }
+
+  // Changes the number of bits; new bits are unset
+  void Resize(unsigned int size);
+
+  unsigned int GetSize() const
+  {
+	  return this->Size;
+  }
+
+  void Set(unsigned int index)
+  {
+	  if(index >= this->Size)
+	  {
+		  this->Resize(index + 1);
+	  }
+	  this->Words[index / BitsPerWord] |= 1UL << (index % BitsPerWord);
+  }
+
+  void Reset(unsigned int index)
+  {
+	  if(index < this->Size)
+	  {
+		  this->Words[index / BitsPerWord] &= ~(1UL << (index % BitsPerWord));
+	  }
+  }
+
+  bool Test(unsigned int index) const
+  {
+	  return index < this->Size &&
+			  (this->Words[index / BitsPerWord] & (1UL << (index % BitsPerWord))) != 0;
+  }
+
+  // Unsets all bits, keeping the size
+  void Clear();
+
+  // this = this | other, this = this & other and this = this & ~other
+  void Union(const vtkFacetedVisualizerBitSet& other);
+  void Intersect(const vtkFacetedVisualizerBitSet& other);
+  void Subtract(const vtkFacetedVisualizerBitSet& other);
+
+  unsigned int Count() const;
+
+  bool Any() const;
+
+  // Index of the first set bit at or after from, or -1. Iterate with
+  // for (int i = set.NextSetBit(0); i >= 0; i = set.NextSetBit(i + 1))
+  int NextSetBit(unsigned int from) const;
+
+private:
+//BTX
+  enum { BitsPerWord = sizeof(unsigned long) * 8 };
+
+  std::vector< unsigned long > Words;
+//ETX
+  unsigned int                 Size;
+};
+
+#endif
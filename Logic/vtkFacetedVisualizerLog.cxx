@@ -0,0 +1,42 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#include "vtkFacetedVisualizerLog.h"
+
+// STD includes
+#include <iostream>
+
+static int FacetedVisualizerLogLevel = FACETEDVISUALIZER_LOG_LEVEL;
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerLog::SetLevel(int level)
+{
+	FacetedVisualizerLogLevel = level;
+}
+
+//----------------------------------------------------------------------------
+int vtkFacetedVisualizerLog::GetLevel()
+{
+	return FacetedVisualizerLogLevel;
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerLog::Write(int, const std::string& message)
+{
+	// one insertion per line keeps the lines of the query thread and the UI thread whole
+	std::cout << message + "\n" << std::flush;
+}
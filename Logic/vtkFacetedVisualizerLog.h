@@ -0,0 +1,99 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkFacetedVisualizerLog - leveled diagnostics of the faceted visualizer
+// .SECTION Description
+// The logic and the module widget report what they do through the macros below instead of
+// writing to std::cout directly. A message is only formatted if its level is compiled in and
+// not above the run time level, so the arguments of a disabled message are never evaluated.
+//
+// FACETEDVISUALIZER_LOG_LEVEL sets the most detailed level that is compiled in: INFO for
+// one-time events such as building an index, DEBUG for a line or a few per query, TRACE for
+// a line per result or per candidate. It defaults to INFO in release (NDEBUG) builds and to
+// TRACE otherwise; NONE compiles every message out.
+
+#ifndef __vtkFacetedVisualizerLog_h
+#define __vtkFacetedVisualizerLog_h
+
+#include "vtkSlicerFacetedVisualizerModuleLogicExport.h"
+
+// STD includes
+#include <sstream>
+#include <string>
+
+#define FACETEDVISUALIZER_LOG_NONE  0
+#define FACETEDVISUALIZER_LOG_INFO  1
+#define FACETEDVISUALIZER_LOG_DEBUG 2
+#define FACETEDVISUALIZER_LOG_TRACE 3
+
+#ifndef FACETEDVISUALIZER_LOG_LEVEL
+# ifdef NDEBUG
+#  define FACETEDVISUALIZER_LOG_LEVEL FACETEDVISUALIZER_LOG_INFO
+# else
+#  define FACETEDVISUALIZER_LOG_LEVEL FACETEDVISUALIZER_LOG_TRACE
+# endif
+#endif
+
+class VTK_SLICER_FACETEDVISUALIZER_MODULE_LOGIC_EXPORT vtkFacetedVisualizerLog
+{
+public:
+  // Most detailed level written at run time, FACETEDVISUALIZER_LOG_LEVEL by default.
+  // Levels that are not compiled in stay off whatever this is set to.
+  static void SetLevel(int level);
+  static int GetLevel();
+
+  // Writes one line to the standard output
+  static void Write(int level, const std::string& message);
+};
+
+// True if messages of the level are written. A constant false for the levels that are
+// compiled out, so blocks that only gather what they log disappear as well.
+#define vtkFacetedVisualizerLogEnabled(level) \
+  ((level) <= FACETEDVISUALIZER_LOG_LEVEL && (level) <= vtkFacetedVisualizerLog::GetLevel())
+
+#define vtkFacetedVisualizerLogMacro(level, x) \
+  do \
+  { \
+    if(vtkFacetedVisualizerLogEnabled(level)) \
+    { \
+      std::ostringstream fvLogMessage; \
+      fvLogMessage << x; \
+      vtkFacetedVisualizerLog::Write(level, fvLogMessage.str()); \
+    } \
+  } while(0)
+
+#define vtkFacetedVisualizerLogNoOp do {} while(0)
+
+#if FACETEDVISUALIZER_LOG_LEVEL >= FACETEDVISUALIZER_LOG_INFO
+# define vtkFacetedVisualizerInfoMacro(x) vtkFacetedVisualizerLogMacro(FACETEDVISUALIZER_LOG_INFO, x)
+#else
+# define vtkFacetedVisualizerInfoMacro(x) vtkFacetedVisualizerLogNoOp
+#endif
+
+#if FACETEDVISUALIZER_LOG_LEVEL >= FACETEDVISUALIZER_LOG_DEBUG
+# define vtkFacetedVisualizerDebugMacro(x) vtkFacetedVisualizerLogMacro(FACETEDVISUALIZER_LOG_DEBUG, x)
+#else
+# define vtkFacetedVisualizerDebugMacro(x) vtkFacetedVisualizerLogNoOp
+#endif
+
+#if FACETEDVISUALIZER_LOG_LEVEL >= FACETEDVISUALIZER_LOG_TRACE
+# define vtkFacetedVisualizerTraceMacro(x) vtkFacetedVisualizerLogMacro(FACETEDVISUALIZER_LOG_TRACE, x)
+#else
+# define vtkFacetedVisualizerTraceMacro(x) vtkFacetedVisualizerLogNoOp
+#endif
+
+#endif
@@ -0,0 +1,74 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#include "vtkFacetedVisualizerOrderedSet.h"
+
+//----------------------------------------------------------------------------
+unsigned int vtkFacetedVisualizerOrderedSet::Insert(const std::string& value)
+{
+	vtksys::hash_map< std::string, unsigned int >::iterator it = this->Positions.find(value);
+	if(it != this->Positions.end())
+	{
+		return it->second;
+	}
+	unsigned int position = static_cast< unsigned int >(this->Values.size());
+	this->Values.push_back(value);
+	this->Positions[value] = position;
+	return position;
+}
+
+//----------------------------------------------------------------------------
+int vtkFacetedVisualizerOrderedSet::Find(const std::string& value) const
+{
+	vtksys::hash_map< std::string, unsigned int >::const_iterator it = this->Positions.find(value);
+	return it != this->Positions.end() ? static_cast< int >(it->second) : -1;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFacetedVisualizerOrderedSet::Remove(const std::string& value)
+{
+	vtksys::hash_map< std::string, unsigned int >::iterator it = this->Positions.find(value);
+	if(it == this->Positions.end())
+	{
+		return false;
+	}
+	unsigned int position = it->second;
+	this->Positions.erase(it);
+	this->Values.erase(this->Values.begin() + position);
+	for (unsigned int n = position; n < this->Values.size(); ++n)
+	{
+		this->Positions[this->Values[n]] = n;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerOrderedSet::Assign(const std::vector< std::string >& values)
+{
+	this->Clear();
+	for (size_t n = 0; n < values.size(); ++n)
+	{
+		this->Insert(values[n]);
+	}
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerOrderedSet::Clear()
+{
+	this->Values.clear();
+	this->Positions.clear();
+}
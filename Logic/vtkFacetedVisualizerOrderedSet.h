@@ -0,0 +1,80 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkFacetedVisualizerOrderedSet - set of strings that keeps insertion order
+// .SECTION Description
+// Accumulates query results, relations and model names without duplicates. The values
+// are kept in the order they were first inserted, which is the order they are displayed
+// in, and a hash of value to position makes insertion and membership tests constant time.
+
+#ifndef __vtkFacetedVisualizerOrderedSet_h
+#define __vtkFacetedVisualizerOrderedSet_h
+
+#include "vtkSlicerFacetedVisualizerModuleLogicExport.h"
+
+// STD includes
+#include <string>
+#include <vector>
+
+#include <vtksys/hash_map.hxx>
+
+class VTK_SLICER_FACETEDVISUALIZER_MODULE_LOGIC_EXPORT vtkFacetedVisualizerOrderedSet
+{
+public:
+  // Adds the value if it is not in the set yet. Returns the position of the value.
+  unsigned int Insert(const std::string& value);
+
+  // Position of the value or -1
+  int Find(const std::string& value) const;
+
+  bool Contains(const std::string& value) const
+  {
+	  return this->Find(value) >= 0;
+  }
+
+  unsigned int GetNumberOfValues() const
+  {
+	  return static_cast< unsigned int >(this->Values.size());
+  }
+
+  const std::string& GetValue(unsigned int index) const
+  {
+	  return this->Values[index];
+  }
+
+  const std::vector< std::string >& GetValues() const
+  {
+	  return this->Values;
+  }
+
+  // Removes the value, the values after it move up one position. Returns false if the
+  // value was not in the set.
+  bool Remove(const std::string& value);
+
+  // Replaces the contents with the values, keeping the first of any duplicates
+  void Assign(const std::vector< std::string >& values);
+
+  void Clear();
+
+private:
+//BTX
+  std::vector< std::string >                    Values;
+  vtksys::hash_map< std::string, unsigned int > Positions;
+//ETX
+};
+
+#endif
@@ -0,0 +1,314 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// FacetedVisualizer includes
+#include "vtkFacetedVisualizerPersistentCache.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+#include <vtkType.h>
+
+// STD includes
+#include <fstream>
+#include <sstream>
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFacetedVisualizerPersistentCache);
+
+namespace
+{
+// version of the layout of the stored entries, part of the DB fingerprint of every entry
+// so that entries written by another version are never read and get cleaned up
+const char* EntryFormatVersion = "fv_results 2";
+
+// 64 bit FNV-1a
+const vtkTypeUInt64 FingerprintSeed = 14695981039346656037ULL;
+
+void HashBytes(vtkTypeUInt64& hash, const char* bytes, size_t length)
+{
+	for (size_t n = 0; n < length; ++n)
+	{
+		hash ^= static_cast< unsigned char >(bytes[n]);
+		hash *= 1099511628211ULL;
+	}
+}
+
+std::string HashToString(vtkTypeUInt64 hash)
+{
+	std::ostringstream str;
+	str << std::hex << hash;
+	return str.str();
+}
+
+// values are joined with newlines, which do not occur in result lines or model names
+std::string JoinLines(const std::vector< std::string >& values)
+{
+	std::string joined = "";
+	for (size_t n = 0; n < values.size(); ++n)
+	{
+		if(n > 0)
+		{
+			joined += "\n";
+		}
+		joined += values[n];
+	}
+	return joined;
+}
+
+void SplitLines(const char* text, std::vector< std::string >& values)
+{
+	values.clear();
+	if(text == NULL || *text == '\0')
+	{
+		return;
+	}
+	std::string joined = text;
+	size_t begin = 0;
+	size_t end = joined.find('\n');
+	while(end != std::string::npos)
+	{
+		values.push_back(joined.substr(begin, end - begin));
+		begin = end + 1;
+		end = joined.find('\n', begin);
+	}
+	values.push_back(joined.substr(begin));
+}
+}
+
+//----------------------------------------------------------------------------
+vtkFacetedVisualizerPersistentCache::vtkFacetedVisualizerPersistentCache()
+{
+	this->DB = NULL;
+	this->LookupStatement = NULL;
+	this->StoreStatement = NULL;
+	this->Writable = false;
+	this->NumberOfHits = 0;
+	this->NumberOfMisses = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkFacetedVisualizerPersistentCache::~vtkFacetedVisualizerPersistentCache()
+{
+	this->Close();
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerPersistentCache::PrintSelf(ostream& os, vtkIndent indent)
+{
+	this->Superclass::PrintSelf(os, indent);
+	os << indent << "Open: " << (this->DB != NULL) << "\n";
+	os << indent << "Writable: " << this->Writable << "\n";
+	os << indent << "DBFingerprint: " << this->DBFingerprint << "\n";
+	os << indent << "SceneFingerprint: " << this->SceneFingerprint << "\n";
+	os << indent << "NumberOfHits: " << this->NumberOfHits << "\n";
+	os << indent << "NumberOfMisses: " << this->NumberOfMisses << "\n";
+}
+
+//----------------------------------------------------------------------------
+bool vtkFacetedVisualizerPersistentCache::Open(const std::string& fileName,
+		const std::string& dbFingerprint)
+{
+	this->Close();
+	std::vector< std::string > salted;
+	salted.push_back(EntryFormatVersion);
+	salted.push_back(dbFingerprint);
+	this->DBFingerprint = ComputeFingerprint(salted);
+
+	this->Writable = vtk_sqlite3_open_v2(fileName.c_str(), &this->DB,
+			VTK_SQLITE_OPEN_READWRITE | VTK_SQLITE_OPEN_CREATE, NULL) == VTK_SQLITE_OK;
+	if(this->Writable)
+	{
+		// sqlite opens a file it cannot write read-only without an error, so writability is
+		// only known from a write: BEGIN IMMEDIATE takes the write lock and fails with
+		// VTK_SQLITE_READONLY. The entries of other DBs and versions are deleted in the
+		// same transaction.
+		// it is only a cache: losing the last entries on a crash is acceptable
+		char *setupSQL = vtk_sqlite3_mprintf(
+				"PRAGMA synchronous = OFF;"
+				"BEGIN IMMEDIATE;"
+				"CREATE TABLE IF NOT EXISTS fv_results(db TEXT, scene TEXT, key TEXT,"
+				" status INTEGER, results TEXT, display TEXT, PRIMARY KEY(db, scene, key));"
+				"DELETE FROM fv_results WHERE db != %Q;"
+				"COMMIT;",
+				this->DBFingerprint.c_str());
+		char *errMsg = NULL;
+		this->Writable = vtk_sqlite3_exec(this->DB, setupSQL, NULL, NULL, &errMsg) == VTK_SQLITE_OK;
+		vtk_sqlite3_free(setupSQL);
+		if(!this->Writable)
+		{
+			// e.g. the cache next to a DB on a read-only share, or locked by another session
+			vtkDebugMacro("Query result cache " << fileName << " is read only: "
+					<< (errMsg != NULL ? errMsg : ""));
+			vtk_sqlite3_free(errMsg);
+			vtk_sqlite3_exec(this->DB, "ROLLBACK", NULL, NULL, NULL);
+		}
+	}
+	if(!this->Writable)
+	{
+		if(this->DB != NULL)
+		{
+			vtk_sqlite3_close(this->DB);
+			this->DB = NULL;
+		}
+		if(vtk_sqlite3_open_v2(fileName.c_str(), &this->DB, VTK_SQLITE_OPEN_READONLY, NULL) != VTK_SQLITE_OK)
+		{
+			if(this->DB != NULL)
+			{
+				vtk_sqlite3_close(this->DB);
+				this->DB = NULL;
+			}
+			return false;
+		}
+	}
+
+	const char *unused;
+	if(vtk_sqlite3_prepare_v2(this->DB,
+			"SELECT status, results, display from fv_results where db = ?1 and scene = ?2 and key = ?3",
+			-1, &this->LookupStatement, &unused) != VTK_SQLITE_OK)
+	{
+		vtkWarningMacro("Query result cache " << fileName << " is not usable: "
+				<< vtk_sqlite3_errmsg(this->DB));
+		this->Close();
+		return false;
+	}
+	if(this->Writable &&
+	   vtk_sqlite3_prepare_v2(this->DB, "INSERT OR REPLACE INTO fv_results VALUES (?1, ?2, ?3, ?4, ?5, ?6)",
+			-1, &this->StoreStatement, &unused) != VTK_SQLITE_OK)
+	{
+		this->StoreStatement = NULL;
+		this->Writable = false;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerPersistentCache::Close()
+{
+	if(this->LookupStatement != NULL)
+	{
+		vtk_sqlite3_finalize(this->LookupStatement);
+		this->LookupStatement = NULL;
+	}
+	if(this->StoreStatement != NULL)
+	{
+		vtk_sqlite3_finalize(this->StoreStatement);
+		this->StoreStatement = NULL;
+	}
+	if(this->DB != NULL)
+	{
+		vtk_sqlite3_close(this->DB);
+		this->DB = NULL;
+	}
+	this->Writable = false;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFacetedVisualizerPersistentCache::Lookup(const std::string& key, int& status,
+		std::vector< std::string >& results, std::vector< std::string >& displayNames)
+{
+	if(this->DB == NULL || this->SceneFingerprint == "")
+	{
+		return false;
+	}
+	vtk_sqlite3_stmt *stmt = this->LookupStatement;
+	vtk_sqlite3_bind_text(stmt, 1, this->DBFingerprint.c_str(), -1, VTK_SQLITE_STATIC);
+	vtk_sqlite3_bind_text(stmt, 2, this->SceneFingerprint.c_str(), -1, VTK_SQLITE_STATIC);
+	vtk_sqlite3_bind_text(stmt, 3, key.c_str(), -1, VTK_SQLITE_STATIC);
+	bool found = vtk_sqlite3_step(stmt) == VTK_SQLITE_ROW;
+	if(found)
+	{
+		status = vtk_sqlite3_column_int(stmt, 0);
+		SplitLines(reinterpret_cast< const char* >(vtk_sqlite3_column_text(stmt, 1)), results);
+		SplitLines(reinterpret_cast< const char* >(vtk_sqlite3_column_text(stmt, 2)), displayNames);
+		++this->NumberOfHits;
+	}
+	else
+	{
+		++this->NumberOfMisses;
+	}
+	vtk_sqlite3_reset(stmt);
+	vtk_sqlite3_clear_bindings(stmt);
+	return found;
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerPersistentCache::Store(const std::string& key, int status,
+		const std::vector< std::string >& results, const std::vector< std::string >& displayNames)
+{
+	if(this->StoreStatement == NULL || this->SceneFingerprint == "")
+	{
+		return;
+	}
+	std::string joinedResults = JoinLines(results);
+	std::string joinedNames = JoinLines(displayNames);
+	vtk_sqlite3_stmt *stmt = this->StoreStatement;
+	vtk_sqlite3_bind_text(stmt, 1, this->DBFingerprint.c_str(), -1, VTK_SQLITE_STATIC);
+	vtk_sqlite3_bind_text(stmt, 2, this->SceneFingerprint.c_str(), -1, VTK_SQLITE_STATIC);
+	vtk_sqlite3_bind_text(stmt, 3, key.c_str(), -1, VTK_SQLITE_STATIC);
+	vtk_sqlite3_bind_int(stmt, 4, status);
+	vtk_sqlite3_bind_text(stmt, 5, joinedResults.c_str(), -1, VTK_SQLITE_STATIC);
+	vtk_sqlite3_bind_text(stmt, 6, joinedNames.c_str(), -1, VTK_SQLITE_STATIC);
+	if(vtk_sqlite3_step(stmt) != VTK_SQLITE_DONE)
+	{
+		vtkWarningMacro("Could not store a query result: " << vtk_sqlite3_errmsg(this->DB));
+	}
+	vtk_sqlite3_reset(stmt);
+	vtk_sqlite3_clear_bindings(stmt);
+}
+
+//----------------------------------------------------------------------------
+std::string vtkFacetedVisualizerPersistentCache::ComputeFileFingerprint(const std::string& fileName)
+{
+	std::ifstream file(fileName.c_str(), std::ios::in | std::ios::binary);
+	if(!file)
+	{
+		return "";
+	}
+	file.seekg(0, std::ios::end);
+	std::streamoff size = file.tellg();
+	file.seekg(0, std::ios::beg);
+
+	vtkTypeUInt64 hash = FingerprintSeed;
+	std::ostringstream sizeStr;
+	sizeStr << size;
+	HashBytes(hash, sizeStr.str().c_str(), sizeStr.str().size());
+
+	const std::streamoff blockSize = 64 * 1024;
+	std::vector< char > block(static_cast< size_t >(blockSize));
+	file.read(&block[0], blockSize);
+	HashBytes(hash, &block[0], static_cast< size_t >(file.gcount()));
+	if(size > blockSize)
+	{
+		file.clear();
+		file.seekg(size > 2 * blockSize ? size - blockSize : blockSize, std::ios::beg);
+		file.read(&block[0], blockSize);
+		HashBytes(hash, &block[0], static_cast< size_t >(file.gcount()));
+	}
+	return HashToString(hash);
+}
+
+//----------------------------------------------------------------------------
+std::string vtkFacetedVisualizerPersistentCache::ComputeFingerprint(const std::vector< std::string >& values)
+{
+	vtkTypeUInt64 hash = FingerprintSeed;
+	for (size_t n = 0; n < values.size(); ++n)
+	{
+		// the terminating zero separates the values
+		HashBytes(hash, values[n].c_str(), values[n].size() + 1);
+	}
+	return HashToString(hash);
+}
@@ -0,0 +1,118 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkFacetedVisualizerPersistentCache - query results kept across sessions
+// .SECTION Description
+// Stores evaluated query operands in an sqlite file next to the ontology DB
+// ("<file>.results.sqlite3") so that a new session starts warm. Entries are stored under
+// a fingerprint of the ontology DB contents and a fingerprint of the scene's models and
+// their DB terms; only entries of the current fingerprints are visible, and entries of
+// an older DB fingerprint are dropped when the file is opened. A file that cannot be
+// written (e.g. a cache shipped with a read-only ontology) is still read.
+
+#ifndef __vtkFacetedVisualizerPersistentCache_h
+#define __vtkFacetedVisualizerPersistentCache_h
+
+// VTK includes
+#include <vtkObject.h>
+
+#include "vtkSlicerFacetedVisualizerModuleLogicExport.h"
+
+// STD includes
+#include <string>
+#include <vector>
+
+#include <vtk_sqlite3.h>
+
+class VTK_SLICER_FACETEDVISUALIZER_MODULE_LOGIC_EXPORT vtkFacetedVisualizerPersistentCache :
+  public vtkObject
+{
+public:
+
+  static vtkFacetedVisualizerPersistentCache *New();
+  vtkTypeMacro(vtkFacetedVisualizerPersistentCache, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+//BTX
+  // Opens (or creates) the cache file for the DB with the given fingerprint, deleting the
+  // entries of other DBs if the file is writable. Returns false if the file can neither be
+  // opened for writing nor for reading.
+  bool Open(const std::string& fileName, const std::string& dbFingerprint);
+
+  void Close();
+
+  bool IsOpen()
+  {
+	  return this->DB != NULL;
+  }
+
+  // Fingerprint of the scene the entries refer to; lookups and stores are no-ops while empty
+  void SetSceneFingerprint(const std::string& fingerprint)
+  {
+	  this->SceneFingerprint = fingerprint;
+  }
+
+  // The display set is stored as model names, as the display indices are per session
+  bool Lookup(const std::string& key, int& status, std::vector< std::string >& results,
+		  std::vector< std::string >& displayNames);
+
+  void Store(const std::string& key, int status, const std::vector< std::string >& results,
+		  const std::vector< std::string >& displayNames);
+
+  // Hash of the file size, its sqlite header (which includes the change counter that every
+  // write transaction increments) and its first and last 64 KB, as a hex string. Empty if
+  // the file cannot be read.
+  static std::string ComputeFileFingerprint(const std::string& fileName);
+
+  // Hash of a list of strings, as a hex string
+  static std::string ComputeFingerprint(const std::vector< std::string >& values);
+
+//ETX
+
+  unsigned long GetNumberOfHits()
+  {
+	  return this->NumberOfHits;
+  }
+
+  unsigned long GetNumberOfMisses()
+  {
+	  return this->NumberOfMisses;
+  }
+
+protected:
+  vtkFacetedVisualizerPersistentCache();
+  virtual ~vtkFacetedVisualizerPersistentCache();
+
+private:
+
+//BTX
+  std::string                              DBFingerprint;
+  std::string                              SceneFingerprint;
+//ETX
+
+  vtk_sqlite3*                             DB;
+  vtk_sqlite3_stmt*                        LookupStatement;
+  vtk_sqlite3_stmt*                        StoreStatement;
+  bool                                     Writable;
+  unsigned long                            NumberOfHits;
+  unsigned long                            NumberOfMisses;
+
+  vtkFacetedVisualizerPersistentCache(const vtkFacetedVisualizerPersistentCache&); // Not implemented
+  void operator=(const vtkFacetedVisualizerPersistentCache&);               // Not implemented
+};
+
+#endif
@@ -0,0 +1,451 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// FacetedVisualizer includes
+#include "vtkFacetedVisualizerQueryPlan.h"
+
+// STD includes
+#include <cctype>
+#include <sstream>
+
+#include <vtksys/hash_map.hxx>
+
+namespace
+{
+enum TokenType
+{
+	WordToken = 0,
+	QuotedToken,
+	OrToken,
+	AndToken,
+	NotToken,
+	MinusToken,
+	OpenToken,
+	CloseToken,
+	EndToken
+};
+
+struct QueryToken
+{
+	int          Type;
+	std::string  Text;
+	// offset in the query, for error messages
+	size_t       Position;
+};
+
+struct QueryAstNode
+{
+	// a vtkFacetedVisualizerQueryPlan::StepType
+	int          Type;
+	// term text of a TermStep
+	std::string  Text;
+	// children, -1 if none; a complement only has Left
+	int          Left;
+	int          Right;
+};
+
+bool IsSpace(char c)
+{
+	return std::isspace(static_cast< unsigned char >(c)) != 0;
+}
+
+bool IsDelimiter(char c)
+{
+	return IsSpace(c) || c == '(' || c == ')' || c == '+' || c == ',' || c == '\'';
+}
+}
+
+//----------------------------------------------------------------------------
+// Recursive descent parser of the grammar in the header, building the expression tree
+// in Nodes, children before their parents
+class vtkFacetedVisualizerQueryParser
+{
+public:
+	bool Parse(const std::string& query, vtkFacetedVisualizerQueryPlan& plan);
+	bool FindTermAt(const std::string& query, size_t position, size_t& begin, size_t& end);
+
+private:
+	bool Tokenize(const std::string& query);
+	int ParseUnion();
+	int ParseIntersection();
+	int ParseUnary();
+	int AddNode(int type, const std::string& text, int left, int right);
+	int Emit(int node, bool listed, vtkFacetedVisualizerQueryPlan& plan,
+			vtksys::hash_map< std::string, int >& termIndices);
+	void SetError(const std::string& message);
+
+	std::vector< QueryToken >    Tokens;
+	size_t                       Next;
+	std::vector< QueryAstNode >  Nodes;
+	std::string                  Error;
+};
+
+//----------------------------------------------------------------------------
+bool vtkFacetedVisualizerQueryParser::Tokenize(const std::string& query)
+{
+	this->Tokens.clear();
+	size_t n = 0;
+	while(n < query.size())
+	{
+		char c = query[n];
+		if(IsSpace(c))
+		{
+			++n;
+			continue;
+		}
+		QueryToken token;
+		token.Position = n;
+		if(c == '(' || c == ')' || c == '+' || c == ',')
+		{
+			token.Type = c == '(' ? OpenToken : c == ')' ? CloseToken : OrToken;
+			token.Text = c;
+			++n;
+		}
+		else if(c == '\'')
+		{
+			size_t end = query.find('\'', n + 1);
+			if(end == std::string::npos)
+			{
+				std::ostringstream message;
+				message << "missing closing quote of the term at " << n;
+				this->SetError(message.str());
+				return false;
+			}
+			token.Type = QuotedToken;
+			token.Text = query.substr(n + 1, end - n - 1);
+			n = end + 1;
+		}
+		else if(c == '-' && (n == 0 || IsSpace(query[n - 1]) || query[n - 1] == ')') &&
+				(n + 1 == query.size() || IsSpace(query[n + 1]) || query[n + 1] == '('))
+		{
+			token.Type = MinusToken;
+			token.Text = c;
+			++n;
+		}
+		else
+		{
+			size_t end = n;
+			while(end < query.size() && !IsDelimiter(query[end]))
+			{
+				++end;
+			}
+			token.Text = query.substr(n, end - n);
+			token.Type = token.Text == "OR" ? OrToken :
+					token.Text == "AND" ? AndToken :
+					token.Text == "NOT" ? NotToken : WordToken;
+			n = end;
+		}
+		this->Tokens.push_back(token);
+	}
+	QueryToken end;
+	end.Type = EndToken;
+	end.Position = query.size();
+	this->Tokens.push_back(end);
+	return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerQueryParser::SetError(const std::string& message)
+{
+	// keep the first error, the ones after it follow from it
+	if(this->Error.empty())
+	{
+		this->Error = message;
+	}
+}
+
+//----------------------------------------------------------------------------
+int vtkFacetedVisualizerQueryParser::AddNode(int type, const std::string& text, int left, int right)
+{
+	QueryAstNode node;
+	node.Type = type;
+	node.Text = text;
+	node.Left = left;
+	node.Right = right;
+	this->Nodes.push_back(node);
+	return static_cast< int >(this->Nodes.size()) - 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkFacetedVisualizerQueryParser::ParseUnion()
+{
+	int left = this->ParseIntersection();
+	while(left >= 0 && (this->Tokens[this->Next].Type == OrToken ||
+			this->Tokens[this->Next].Type == MinusToken))
+	{
+		int type = this->Tokens[this->Next].Type == OrToken ?
+				vtkFacetedVisualizerQueryPlan::UnionStep : vtkFacetedVisualizerQueryPlan::SubtractStep;
+		++this->Next;
+		int right = this->ParseIntersection();
+		if(right < 0)
+		{
+			return -1;
+		}
+		left = this->AddNode(type, "", left, right);
+	}
+	return left;
+}
+
+//----------------------------------------------------------------------------
+int vtkFacetedVisualizerQueryParser::ParseIntersection()
+{
+	int left = this->ParseUnary();
+	while(left >= 0 && this->Tokens[this->Next].Type == AndToken)
+	{
+		++this->Next;
+		int right = this->ParseUnary();
+		if(right < 0)
+		{
+			return -1;
+		}
+		left = this->AddNode(vtkFacetedVisualizerQueryPlan::IntersectStep, "", left, right);
+	}
+	return left;
+}
+
+//----------------------------------------------------------------------------
+int vtkFacetedVisualizerQueryParser::ParseUnary()
+{
+	const QueryToken& token = this->Tokens[this->Next];
+	std::ostringstream message;
+	switch(token.Type)
+	{
+		case NotToken:
+		{
+			++this->Next;
+			int operand = this->ParseUnary();
+			return operand < 0 ? -1 :
+					this->AddNode(vtkFacetedVisualizerQueryPlan::ComplementStep, "", operand, -1);
+		}
+		case OpenToken:
+		{
+			++this->Next;
+			int inner = this->ParseUnion();
+			if(inner < 0)
+			{
+				return -1;
+			}
+			if(this->Tokens[this->Next].Type != CloseToken)
+			{
+				message << "missing ')' for the '(' at " << token.Position;
+				this->SetError(message.str());
+				return -1;
+			}
+			++this->Next;
+			return inner;
+		}
+		case QuotedToken:
+			++this->Next;
+			return this->AddNode(vtkFacetedVisualizerQueryPlan::TermStep, token.Text, -1, -1);
+		case WordToken:
+		{
+			// the words up to the next operator are one term
+			std::string text = token.Text;
+			while(this->Tokens[++this->Next].Type == WordToken)
+			{
+				text += " " + this->Tokens[this->Next].Text;
+			}
+			return this->AddNode(vtkFacetedVisualizerQueryPlan::TermStep, text, -1, -1);
+		}
+		case EndToken:
+			message << "a term is missing at the end of the query";
+			break;
+		default:
+			message << "a term is missing before '" << token.Text << "' at " << token.Position;
+			break;
+	}
+	this->SetError(message.str());
+	return -1;
+}
+
+//----------------------------------------------------------------------------
+// Appends the steps of a subtree, operands first, and returns the index of its step.
+// listed is false below a complement and on the right of a difference.
+int vtkFacetedVisualizerQueryParser::Emit(int node, bool listed, vtkFacetedVisualizerQueryPlan& plan,
+		vtksys::hash_map< std::string, int >& termIndices)
+{
+	const QueryAstNode& astNode = this->Nodes[node];
+	vtkFacetedVisualizerQueryPlan::Step step;
+	step.Type = astNode.Type;
+	step.Term = -1;
+	if(astNode.Type == vtkFacetedVisualizerQueryPlan::TermStep)
+	{
+		std::string term;
+		term.reserve(astNode.Text.size());
+		for (size_t n = 0; n < astNode.Text.size(); ++n)
+		{
+			term += static_cast< char >(std::tolower(static_cast< unsigned char >(astNode.Text[n])));
+		}
+		size_t begin = term.find_first_not_of(" \t");
+		size_t end = term.find_last_not_of(" \t");
+		term = begin == std::string::npos ? "" : term.substr(begin, end - begin + 1);
+
+		vtksys::hash_map< std::string, int >::iterator it = termIndices.find(term);
+		if(it == termIndices.end())
+		{
+			step.Term = static_cast< int >(plan.Terms.size());
+			termIndices[term] = step.Term;
+			plan.Terms.push_back(term);
+			plan.TermListed.push_back(listed);
+		}
+		else
+		{
+			step.Term = it->second;
+			plan.TermListed[step.Term] = plan.TermListed[step.Term] || listed;
+		}
+	}
+	else if(astNode.Type == vtkFacetedVisualizerQueryPlan::UnionStep ||
+			astNode.Type == vtkFacetedVisualizerQueryPlan::IntersectStep)
+	{
+		// operands of the chain of nodes of the same type, left to right
+		std::vector< int > pending(1, node);
+		while(!pending.empty())
+		{
+			int current = pending.back();
+			pending.pop_back();
+			if(this->Nodes[current].Type == astNode.Type)
+			{
+				pending.push_back(this->Nodes[current].Right);
+				pending.push_back(this->Nodes[current].Left);
+			}
+			else
+			{
+				step.Operands.push_back(this->Emit(current, listed, plan, termIndices));
+			}
+		}
+	}
+	else
+	{
+		step.Operands.push_back(this->Emit(astNode.Left,
+				astNode.Type == vtkFacetedVisualizerQueryPlan::ComplementStep ? false : listed,
+				plan, termIndices));
+		if(astNode.Right >= 0)
+		{
+			step.Operands.push_back(this->Emit(astNode.Right,
+					astNode.Type == vtkFacetedVisualizerQueryPlan::SubtractStep ? false : listed,
+					plan, termIndices));
+		}
+	}
+	plan.Steps.push_back(step);
+	return static_cast< int >(plan.Steps.size()) - 1;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFacetedVisualizerQueryParser::Parse(const std::string& query,
+		vtkFacetedVisualizerQueryPlan& plan)
+{
+	this->Next = 0;
+	this->Nodes.clear();
+	this->Error = "";
+	int root = -1;
+	if(this->Tokenize(query))
+	{
+		if(this->Tokens[0].Type == EndToken)
+		{
+			this->SetError("the query is empty");
+		}
+		else
+		{
+			root = this->ParseUnion();
+			if(root >= 0 && this->Tokens[this->Next].Type != EndToken)
+			{
+				std::ostringstream message;
+				message << "unexpected '" << this->Tokens[this->Next].Text << "' at "
+						<< this->Tokens[this->Next].Position;
+				this->SetError(message.str());
+				root = -1;
+			}
+		}
+	}
+	if(root < 0)
+	{
+		plan.Error = this->Error;
+		return false;
+	}
+	vtksys::hash_map< std::string, int > termIndices;
+	this->Emit(root, true, plan, termIndices);
+	return true;
+}
+
+//----------------------------------------------------------------------------
+// A term is a run of word tokens or a quoted token, see ParseUnary
+bool vtkFacetedVisualizerQueryParser::FindTermAt(const std::string& query, size_t position,
+		size_t& begin, size_t& end)
+{
+	if(!this->Tokenize(query))
+	{
+		// the quote without a closing one is the last one, the term is being typed after it
+		begin = query.rfind('\'') + 1;
+		end = query.size();
+		return position >= begin;
+	}
+	for (size_t n = 0; this->Tokens[n].Type != EndToken; ++n)
+	{
+		const QueryToken &token = this->Tokens[n];
+		if(token.Type == QuotedToken)
+		{
+			begin = token.Position + 1;
+			end = begin + token.Text.size();
+		}
+		else if(token.Type == WordToken)
+		{
+			begin = token.Position;
+			while(this->Tokens[n + 1].Type == WordToken)
+			{
+				++n;
+			}
+			end = this->Tokens[n].Position + this->Tokens[n].Text.size();
+		}
+		else
+		{
+			continue;
+		}
+		if(position >= begin && position <= end)
+		{
+			return true;
+		}
+	}
+	begin = end = position;
+	return false;
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerQueryPlan::Clear()
+{
+	this->Steps.clear();
+	this->Terms.clear();
+	this->TermListed.clear();
+	this->Error = "";
+	this->Valid = false;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFacetedVisualizerQueryPlan::Compile(const std::string& query)
+{
+	this->Clear();
+	vtkFacetedVisualizerQueryParser parser;
+	this->Valid = parser.Parse(query, *this);
+	return this->Valid;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFacetedVisualizerQueryPlan::FindTermAt(const std::string& query, size_t position,
+		size_t& begin, size_t& end)
+{
+	vtkFacetedVisualizerQueryParser parser;
+	return parser.FindTermAt(query, position, begin, end);
+}
@@ -0,0 +1,140 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkFacetedVisualizerQueryPlan - compiled form of a faceted visualizer query
+// .SECTION Description
+// Parses the text of a query into an expression tree and flattens it into a list of
+// steps, each after the steps of its operands, so the last step is the root of the
+// tree. Chains of unions or of intersections become one step with all their operands,
+// which the logic can evaluate in any order. The grammar, lowest precedence first:
+//
+//   union        := intersection ( ( '+' | ',' | 'OR' | ' - ' ) intersection )*
+//   intersection := unary ( 'AND' unary )*
+//   unary        := 'NOT' unary | '(' union ')' | term
+//
+// A term is a sequence of words, or any text between single quotes; it is looked up in
+// the DB and expanded along the part-of hierarchy. ' - ' is the difference of the sets
+// on either side and needs a space or a parenthesis on both sides, so hyphenated words
+// stay terms. Operators are case sensitive: "liver and kidney" is one term. A term that
+// occurs several times in a query is evaluated once.
+
+#ifndef __vtkFacetedVisualizerQueryPlan_h
+#define __vtkFacetedVisualizerQueryPlan_h
+
+#include "vtkSlicerFacetedVisualizerModuleLogicExport.h"
+
+// STD includes
+#include <string>
+#include <vector>
+
+class VTK_SLICER_FACETEDVISUALIZER_MODULE_LOGIC_EXPORT vtkFacetedVisualizerQueryPlan
+{
+public:
+  enum StepType
+  {
+	  // the set of a term
+	  TermStep = 0,
+	  // a | b | ..., a & b & ..., a & ~b
+	  UnionStep,
+	  IntersectStep,
+	  SubtractStep,
+	  // ~a
+	  ComplementStep
+  };
+
+  struct Step
+  {
+	  int Type;
+	  // index of the term of a TermStep, -1 for the set operations
+	  int Term;
+	  // indices of the steps of the operands, in the order they were typed
+	  std::vector< int > Operands;
+  };
+
+  vtkFacetedVisualizerQueryPlan()
+  {
+	  this->Valid = false;
+  }
+
+  // Parses the query. Returns false and sets the error message if it is not valid, in
+  // which case the plan has no steps.
+  bool Compile(const std::string& query);
+
+  bool IsValid() const
+  {
+	  return this->Valid;
+  }
+
+  const std::string& GetError() const
+  {
+	  return this->Error;
+  }
+
+  unsigned int GetNumberOfSteps() const
+  {
+	  return static_cast< unsigned int >(this->Steps.size());
+  }
+
+  const Step& GetStep(unsigned int index) const
+  {
+	  return this->Steps[index];
+  }
+
+  // index of the step the value of the query is the value of
+  int GetRootStep() const
+  {
+	  return static_cast< int >(this->Steps.size()) - 1;
+  }
+
+  // distinct terms, lower case and trimmed, in the order they first appear
+  unsigned int GetNumberOfTerms() const
+  {
+	  return static_cast< unsigned int >(this->Terms.size());
+  }
+
+  const std::string& GetTerm(unsigned int index) const
+  {
+	  return this->Terms[index];
+  }
+
+  // False for terms that are only subtracted or negated: their results are not shown
+  bool IsTermListed(unsigned int index) const
+  {
+	  return this->TermListed[index];
+  }
+
+  void Clear();
+
+  // Finds the term a cursor at position (0 to the length of the query) is in or right
+  // after, e.g. to complete it: [begin, end) is the span of its words, or of the text
+  // between its quotes, also of an unterminated quote. Returns false if there is none,
+  // e.g. after an operator.
+  static bool FindTermAt(const std::string& query, size_t position, size_t& begin, size_t& end);
+
+private:
+//BTX
+  std::vector< Step >                      Steps;
+  std::vector< std::string >               Terms;
+  std::vector< bool >                      TermListed;
+  std::string                              Error;
+//ETX
+  bool                                     Valid;
+
+  friend class vtkFacetedVisualizerQueryParser;
+};
+
+#endif
@@ -0,0 +1,148 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// FacetedVisualizer includes
+#include "vtkFacetedVisualizerResultCache.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFacetedVisualizerResultCache);
+
+//----------------------------------------------------------------------------
+vtkFacetedVisualizerResultCache::vtkFacetedVisualizerResultCache()
+{
+	this->MaximumSize = 4 * 1024 * 1024;
+	this->Size = 0;
+	this->NumberOfHits = 0;
+	this->NumberOfMisses = 0;
+	this->NumberOfEvictions = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkFacetedVisualizerResultCache::~vtkFacetedVisualizerResultCache()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerResultCache::PrintSelf(ostream& os, vtkIndent indent)
+{
+	this->Superclass::PrintSelf(os, indent);
+	os << indent << "MaximumSize: " << this->MaximumSize << "\n";
+	os << indent << "Size: " << this->Size << "\n";
+	os << indent << "NumberOfEntries: " << this->Entries.size() << "\n";
+	os << indent << "NumberOfHits: " << this->NumberOfHits << "\n";
+	os << indent << "NumberOfMisses: " << this->NumberOfMisses << "\n";
+	os << indent << "NumberOfEvictions: " << this->NumberOfEvictions << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerResultCache::SetMaximumSize(unsigned long bytes)
+{
+	this->MaximumSize = bytes;
+	this->EvictToFit(0);
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerResultCache::ResetStatistics()
+{
+	this->NumberOfHits = 0;
+	this->NumberOfMisses = 0;
+	this->NumberOfEvictions = 0;
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerResultCache::Clear()
+{
+	this->Entries.clear();
+	this->Index.clear();
+	this->Size = 0;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFacetedVisualizerResultCache::Lookup(const std::string& key, int& status,
+		std::vector< std::string >& results, vtkFacetedVisualizerBitSet& display)
+{
+	vtksys::hash_map< std::string, EntryList::iterator >::iterator it = this->Index.find(key);
+	if(it == this->Index.end())
+	{
+		++this->NumberOfMisses;
+		return false;
+	}
+	++this->NumberOfHits;
+	// move to the front, list iterators stay valid
+	this->Entries.splice(this->Entries.begin(), this->Entries, it->second);
+	status = it->second->Status;
+	results = it->second->Results;
+	display = it->second->Display;
+	return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerResultCache::Insert(const std::string& key, int status,
+		const std::vector< std::string >& results, const vtkFacetedVisualizerBitSet& display)
+{
+	vtksys::hash_map< std::string, EntryList::iterator >::iterator it = this->Index.find(key);
+	if(it != this->Index.end())
+	{
+		this->Erase(it->second);
+	}
+
+	// strings are counted with their characters plus the std::string object itself
+	unsigned long bytes = sizeof(Entry) + 2 * key.size() + sizeof(EntryList::iterator) +
+			(display.GetSize() + 7) / 8;
+	for (size_t n = 0; n < results.size(); ++n)
+	{
+		bytes += sizeof(std::string) + results[n].size();
+	}
+	if(bytes > this->MaximumSize)
+	{
+		return;
+	}
+	this->EvictToFit(bytes);
+
+	Entry entry;
+	entry.Key = key;
+	entry.Status = status;
+	entry.Results = results;
+	entry.Display = display;
+	entry.Bytes = bytes;
+	this->Entries.push_front(entry);
+	this->Index[key] = this->Entries.begin();
+	this->Size += bytes;
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerResultCache::Erase(EntryList::iterator entry)
+{
+	this->Size -= entry->Bytes;
+	this->Index.erase(entry->Key);
+	this->Entries.erase(entry);
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerResultCache::EvictToFit(unsigned long bytes)
+{
+	while(!this->Entries.empty() && this->Size + bytes > this->MaximumSize)
+	{
+		EntryList::iterator last = this->Entries.end();
+		--last;
+		this->Erase(last);
+		++this->NumberOfEvictions;
+	}
+}
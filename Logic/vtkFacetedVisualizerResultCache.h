@@ -0,0 +1,142 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkFacetedVisualizerResultCache - LRU cache of evaluated query operands
+// .SECTION Description
+// Keeps the outcome of ProcessSingleQuery (status, result lines and display set) under
+// a canonical key built by the faceted visualizer logic. The cache holds at most
+// MaximumSize bytes, as estimated from the stored strings and bit sets; entries are kept
+// in a list ordered by last use, so lookups, insertions and evictions of the least
+// recently used entry are constant time.
+
+#ifndef __vtkFacetedVisualizerResultCache_h
+#define __vtkFacetedVisualizerResultCache_h
+
+// VTK includes
+#include <vtkObject.h>
+
+#include "vtkSlicerFacetedVisualizerModuleLogicExport.h"
+#include "vtkFacetedVisualizerBitSet.h"
+
+// STD includes
+#include <list>
+#include <string>
+#include <vector>
+
+#include <vtksys/hash_map.hxx>
+
+class VTK_SLICER_FACETEDVISUALIZER_MODULE_LOGIC_EXPORT vtkFacetedVisualizerResultCache :
+  public vtkObject
+{
+public:
+
+  static vtkFacetedVisualizerResultCache *New();
+  vtkTypeMacro(vtkFacetedVisualizerResultCache, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  // Memory budget in bytes. Lowering it evicts entries right away; 0 disables the cache.
+  void SetMaximumSize(unsigned long bytes);
+  unsigned long GetMaximumSize()
+  {
+	  return this->MaximumSize;
+  }
+
+  // Estimated number of bytes used by the entries
+  unsigned long GetSize()
+  {
+	  return this->Size;
+  }
+
+  unsigned int GetNumberOfEntries()
+  {
+	  return static_cast< unsigned int >(this->Entries.size());
+  }
+
+  unsigned long GetNumberOfHits()
+  {
+	  return this->NumberOfHits;
+  }
+
+  unsigned long GetNumberOfMisses()
+  {
+	  return this->NumberOfMisses;
+  }
+
+  unsigned long GetNumberOfEvictions()
+  {
+	  return this->NumberOfEvictions;
+  }
+
+  void ResetStatistics();
+
+  // Removes all entries, e.g. when the DB or the scene the results refer to change
+  void Clear();
+
+//BTX
+  // Copies the entry of key and makes it the most recently used one. Counts a hit or a miss.
+  bool Lookup(const std::string& key, int& status, std::vector< std::string >& results,
+		  vtkFacetedVisualizerBitSet& display);
+
+  // Whether key has an entry, without counting a hit or a miss or changing the LRU order
+  bool Contains(const std::string& key)
+  {
+	  return this->Index.find(key) != this->Index.end();
+  }
+
+  // Stores an entry, replacing any previous one with the same key, and evicts the least
+  // recently used entries until the cache fits its budget. Entries larger than the whole
+  // budget are not stored.
+  void Insert(const std::string& key, int status, const std::vector< std::string >& results,
+		  const vtkFacetedVisualizerBitSet& display);
+//ETX
+
+protected:
+  vtkFacetedVisualizerResultCache();
+  virtual ~vtkFacetedVisualizerResultCache();
+
+private:
+
+//BTX
+  struct Entry
+  {
+	  std::string                Key;
+	  int                        Status;
+	  std::vector< std::string > Results;
+	  vtkFacetedVisualizerBitSet Display;
+	  unsigned long              Bytes;
+  };
+  typedef std::list< Entry > EntryList;
+
+  void Erase(EntryList::iterator entry);
+  void EvictToFit(unsigned long bytes);
+
+  // most recently used first
+  EntryList                                           Entries;
+  vtksys::hash_map< std::string, EntryList::iterator > Index;
+//ETX
+
+  unsigned long                            MaximumSize;
+  unsigned long                            Size;
+  unsigned long                            NumberOfHits;
+  unsigned long                            NumberOfMisses;
+  unsigned long                            NumberOfEvictions;
+
+  vtkFacetedVisualizerResultCache(const vtkFacetedVisualizerResultCache&); // Not implemented
+  void operator=(const vtkFacetedVisualizerResultCache&);               // Not implemented
+};
+
+#endif
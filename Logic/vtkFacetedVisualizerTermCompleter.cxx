@@ -0,0 +1,166 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// FacetedVisualizer includes
+#include "vtkFacetedVisualizerTermCompleter.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <algorithm>
+#include <cctype>
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFacetedVisualizerTermCompleter);
+
+namespace
+{
+struct CompletionEntry
+{
+	std::string Key;
+	std::string Term;
+	// order of the statement the term was read with, subjects first
+	int         Source;
+};
+
+struct CompletionEntryLess
+{
+	bool operator()(const CompletionEntry& a, const CompletionEntry& b) const
+	{
+		if(a.Key != b.Key)
+		{
+			return a.Key < b.Key;
+		}
+		return a.Source < b.Source;
+	}
+};
+}
+
+//----------------------------------------------------------------------------
+vtkFacetedVisualizerTermCompleter::vtkFacetedVisualizerTermCompleter()
+{
+	this->Built = false;
+}
+
+//----------------------------------------------------------------------------
+vtkFacetedVisualizerTermCompleter::~vtkFacetedVisualizerTermCompleter()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerTermCompleter::PrintSelf(ostream& os, vtkIndent indent)
+{
+	this->Superclass::PrintSelf(os, indent);
+	os << indent << "Built: " << this->Built << "\n";
+	os << indent << "NumberOfTerms: " << this->Terms.size() << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerTermCompleter::Clear()
+{
+	this->Keys.clear();
+	this->Terms.clear();
+	this->Built = false;
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerTermCompleter::ToKey(const std::string& term, std::string& key)
+{
+	key.resize(term.size());
+	for (size_t n = 0; n < term.size(); ++n)
+	{
+		key[n] = term[n] == '_' ? ' ' :
+				static_cast< char >(std::tolower(static_cast< unsigned char >(term[n])));
+	}
+}
+
+//----------------------------------------------------------------------------
+bool vtkFacetedVisualizerTermCompleter::Build(vtk_sqlite3* ptrDB)
+{
+	this->Clear();
+	if(ptrDB == NULL)
+	{
+		return false;
+	}
+	// the terms GetDBSubject resolves
+	const char *loadSQL[2] = {
+			"SELECT DISTINCT subject from resources",
+			"SELECT DISTINCT object from resources"
+			" where predicate = 'non_english_equivalent' or predicate = 'synonym'" };
+	std::vector< CompletionEntry > entries;
+	for (int n = 0; n < 2; ++n)
+	{
+		vtk_sqlite3_stmt *stmt;
+		const char *unused;
+		if(vtk_sqlite3_prepare_v2(ptrDB, loadSQL[n], -1, &stmt, &unused) != VTK_SQLITE_OK)
+		{
+			vtkErrorMacro("Could not read the query terms: " << vtk_sqlite3_errmsg(ptrDB));
+			return false;
+		}
+		while(vtk_sqlite3_step(stmt) == VTK_SQLITE_ROW)
+		{
+			const unsigned char *text = vtk_sqlite3_column_text(stmt, 0);
+			if(text == NULL || *text == '\0')
+			{
+				continue;
+			}
+			CompletionEntry entry;
+			entry.Term = reinterpret_cast< const char* >(text);
+			std::replace(entry.Term.begin(), entry.Term.end(), '_', ' ');
+			ToKey(entry.Term, entry.Key);
+			entry.Source = n;
+			entries.push_back(entry);
+		}
+		vtk_sqlite3_finalize(stmt);
+	}
+
+	// a key that is both a subject and a synonym is shown as the subject
+	std::sort(entries.begin(), entries.end(), CompletionEntryLess());
+	this->Keys.reserve(entries.size());
+	this->Terms.reserve(entries.size());
+	for (size_t n = 0; n < entries.size(); ++n)
+	{
+		if(!this->Keys.empty() && this->Keys.back() == entries[n].Key)
+		{
+			continue;
+		}
+		this->Keys.push_back(entries[n].Key);
+		this->Terms.push_back(entries[n].Term);
+	}
+	this->Built = true;
+	return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerTermCompleter::Complete(const std::string& prefix,
+		unsigned int maximumCompletions, std::vector< std::string >& completions)
+{
+	if(prefix.empty())
+	{
+		return;
+	}
+	std::string key;
+	ToKey(prefix, key);
+	std::vector< std::string >::const_iterator it =
+			std::lower_bound(this->Keys.begin(), this->Keys.end(), key);
+	for (unsigned int found = 0; found < maximumCompletions && it != this->Keys.end() &&
+			it->compare(0, key.size(), key) == 0; ++found, ++it)
+	{
+		completions.push_back(this->Terms[it - this->Keys.begin()]);
+	}
+}
@@ -0,0 +1,92 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkFacetedVisualizerTermCompleter - prefix lookup of the terms a query can use
+// .SECTION Description
+// Keeps the subjects of the resources table and the terms that are non-English
+// equivalents or synonyms of a subject in one array sorted by their case-folded form,
+// with '_' shown as a space the way queries are typed. The terms starting with a prefix
+// are a contiguous range of the array, found with a binary search.
+
+#ifndef __vtkFacetedVisualizerTermCompleter_h
+#define __vtkFacetedVisualizerTermCompleter_h
+
+// VTK includes
+#include <vtkObject.h>
+
+#include "vtkSlicerFacetedVisualizerModuleLogicExport.h"
+
+// STD includes
+#include <string>
+#include <vector>
+
+#include <vtk_sqlite3.h>
+
+class VTK_SLICER_FACETEDVISUALIZER_MODULE_LOGIC_EXPORT vtkFacetedVisualizerTermCompleter :
+  public vtkObject
+{
+public:
+
+  static vtkFacetedVisualizerTermCompleter *New();
+  vtkTypeMacro(vtkFacetedVisualizerTermCompleter, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  // Reads the terms of the resources table. Returns false if they could not be read,
+  // in which case the completer is left empty.
+  bool Build(vtk_sqlite3* ptrDB);
+
+  void Clear();
+
+  bool IsBuilt()
+  {
+	  return this->Built;
+  }
+
+  unsigned int GetNumberOfTerms()
+  {
+	  return static_cast< unsigned int >(this->Terms.size());
+  }
+
+//BTX
+  // Appends up to maximumCompletions terms starting with the prefix, ignoring case and
+  // treating '_' and spaces alike, in alphabetical order. Terms are returned with spaces.
+  void Complete(const std::string& prefix, unsigned int maximumCompletions,
+		  std::vector< std::string >& completions);
+
+  // lower case, '_' replaced with a space
+  static void ToKey(const std::string& term, std::string& key);
+//ETX
+
+protected:
+  vtkFacetedVisualizerTermCompleter();
+  virtual ~vtkFacetedVisualizerTermCompleter();
+
+private:
+
+//BTX
+  // sorted by key, each key once
+  std::vector< std::string >               Keys;
+  std::vector< std::string >               Terms;
+//ETX
+
+  bool                                     Built;
+
+  vtkFacetedVisualizerTermCompleter(const vtkFacetedVisualizerTermCompleter&); // Not implemented
+  void operator=(const vtkFacetedVisualizerTermCompleter&);                 // Not implemented
+};
+
+#endif
@@ -0,0 +1,269 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// FacetedVisualizer includes
+#include "vtkFacetedVisualizerTokenIndex.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFacetedVisualizerTokenIndex);
+
+namespace
+{
+struct RankedCandidate
+{
+	int          Subject;
+	unsigned int MatchedTokens;
+	unsigned int Tokens;
+};
+
+// more matched tokens first, then the more specific (shorter) subject
+struct RankedCandidateLess
+{
+	const std::vector< std::string >* Subjects;
+
+	bool operator()(const RankedCandidate& a, const RankedCandidate& b) const
+	{
+		if(a.MatchedTokens != b.MatchedTokens)
+		{
+			return a.MatchedTokens > b.MatchedTokens;
+		}
+		if(a.Tokens != b.Tokens)
+		{
+			return a.Tokens < b.Tokens;
+		}
+		return (*this->Subjects)[a.Subject] < (*this->Subjects)[b.Subject];
+	}
+};
+
+struct PostingSizeLess
+{
+	bool operator()(const std::vector< int >* a, const std::vector< int >* b) const
+	{
+		return a->size() < b->size();
+	}
+};
+}
+
+//----------------------------------------------------------------------------
+vtkFacetedVisualizerTokenIndex::vtkFacetedVisualizerTokenIndex()
+{
+	this->Built = false;
+}
+
+//----------------------------------------------------------------------------
+vtkFacetedVisualizerTokenIndex::~vtkFacetedVisualizerTokenIndex()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerTokenIndex::PrintSelf(ostream& os, vtkIndent indent)
+{
+	this->Superclass::PrintSelf(os, indent);
+	os << indent << "Built: " << this->Built << "\n";
+	os << indent << "NumberOfSubjects: " << this->Subjects.size() << "\n";
+	os << indent << "NumberOfTokens: " << this->Postings.size() << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerTokenIndex::Clear()
+{
+	this->Subjects.clear();
+	this->SubjectTokens.clear();
+	this->Postings.clear();
+	this->TokenIds.clear();
+	this->Built = false;
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerTokenIndex::Tokenize(const std::string& term,
+		std::vector< std::string >& tokens)
+{
+	tokens.clear();
+	std::string token = "";
+	for (size_t n = 0; n <= term.size(); ++n)
+	{
+		if(n == term.size() || term[n] == '_' || term[n] == ' ')
+		{
+			if(!token.empty())
+			{
+				tokens.push_back(token);
+				token = "";
+			}
+		}
+		else
+		{
+			token += static_cast< char >(std::tolower(static_cast< unsigned char >(term[n])));
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+bool vtkFacetedVisualizerTokenIndex::Build(vtk_sqlite3* ptrDB)
+{
+	this->Clear();
+	if(ptrDB == NULL)
+	{
+		return false;
+	}
+	vtk_sqlite3_stmt *stmt;
+	const char *unused;
+	if(vtk_sqlite3_prepare_v2(ptrDB, "SELECT DISTINCT subject from resources", -1,
+			&stmt, &unused) != VTK_SQLITE_OK)
+	{
+		vtkErrorMacro("Could not read the subjects: " << vtk_sqlite3_errmsg(ptrDB));
+		return false;
+	}
+	std::vector< std::string > tokens;
+	while(vtk_sqlite3_step(stmt) == VTK_SQLITE_ROW)
+	{
+		const unsigned char *text = vtk_sqlite3_column_text(stmt, 0);
+		if(text == NULL)
+		{
+			continue;
+		}
+		int subject = static_cast< int >(this->Subjects.size());
+		this->Subjects.push_back(reinterpret_cast< const char* >(text));
+		this->SubjectTokens.push_back(std::vector< int >());
+		Tokenize(this->Subjects.back(), tokens);
+		for (size_t t = 0; t < tokens.size(); ++t)
+		{
+			vtksys::hash_map< std::string, int >::iterator it = this->TokenIds.find(tokens[t]);
+			int token;
+			if(it == this->TokenIds.end())
+			{
+				token = static_cast< int >(this->Postings.size());
+				this->TokenIds[tokens[t]] = token;
+				this->Postings.push_back(std::vector< int >());
+			}
+			else
+			{
+				token = it->second;
+			}
+			// subjects are added in increasing order, a repeated token only needs one entry
+			if(this->Postings[token].empty() || this->Postings[token].back() != subject)
+			{
+				this->Postings[token].push_back(subject);
+				this->SubjectTokens[subject].push_back(token);
+			}
+		}
+	}
+	vtk_sqlite3_finalize(stmt);
+	for (size_t s = 0; s < this->SubjectTokens.size(); ++s)
+	{
+		std::sort(this->SubjectTokens[s].begin(), this->SubjectTokens[s].end());
+	}
+	this->Built = true;
+	return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerTokenIndex::FindSubjectsWithTokens(const std::vector< std::string >& tokens,
+		std::vector< int >& subjects)
+{
+	std::vector< const std::vector< int >* > lists;
+	for (size_t t = 0; t < tokens.size(); ++t)
+	{
+		vtksys::hash_map< std::string, int >::iterator it = this->TokenIds.find(tokens[t]);
+		if(it == this->TokenIds.end())
+		{
+			// no subject has this token
+			return;
+		}
+		lists.push_back(&this->Postings[it->second]);
+	}
+	if(lists.empty())
+	{
+		return;
+	}
+	std::sort(lists.begin(), lists.end(), PostingSizeLess());
+
+	std::vector< int > result = *lists[0];
+	std::vector< int > intersection;
+	for (size_t l = 1; l < lists.size() && !result.empty(); ++l)
+	{
+		intersection.clear();
+		std::set_intersection(result.begin(), result.end(), lists[l]->begin(), lists[l]->end(),
+				std::back_inserter(intersection));
+		result.swap(intersection);
+	}
+	subjects.insert(subjects.end(), result.begin(), result.end());
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerTokenIndex::Match(const std::vector< std::string >& tokens,
+		std::vector< std::string >& candidates)
+{
+	candidates.clear();
+	std::vector< std::string > nameTokens;
+	std::vector< std::string > split;
+	for (size_t t = 0; t < tokens.size(); ++t)
+	{
+		Tokenize(tokens[t], split);
+		nameTokens.insert(nameTokens.end(), split.begin(), split.end());
+	}
+
+	std::vector< int > subjects;
+	for (size_t drop = 1; subjects.empty() && drop + 1 < nameTokens.size(); ++drop)
+	{
+		std::vector< std::string > first(nameTokens.begin(), nameTokens.end() - drop);
+		std::vector< std::string > last(nameTokens.begin() + drop, nameTokens.end());
+		this->FindSubjectsWithTokens(first, subjects);
+		this->FindSubjectsWithTokens(last, subjects);
+	}
+	std::sort(subjects.begin(), subjects.end());
+	subjects.erase(std::unique(subjects.begin(), subjects.end()), subjects.end());
+
+	// rank by the tokens of the name each candidate contains
+	std::vector< int > nameTokenIds;
+	for (size_t t = 0; t < nameTokens.size(); ++t)
+	{
+		vtksys::hash_map< std::string, int >::iterator it = this->TokenIds.find(nameTokens[t]);
+		if(it != this->TokenIds.end())
+		{
+			nameTokenIds.push_back(it->second);
+		}
+	}
+	std::sort(nameTokenIds.begin(), nameTokenIds.end());
+	nameTokenIds.erase(std::unique(nameTokenIds.begin(), nameTokenIds.end()), nameTokenIds.end());
+
+	std::vector< RankedCandidate > ranked(subjects.size());
+	for (size_t s = 0; s < subjects.size(); ++s)
+	{
+		const std::vector< int > &subjectTokens = this->SubjectTokens[subjects[s]];
+		std::vector< int > common;
+		std::set_intersection(subjectTokens.begin(), subjectTokens.end(),
+				nameTokenIds.begin(), nameTokenIds.end(), std::back_inserter(common));
+		ranked[s].Subject = subjects[s];
+		ranked[s].MatchedTokens = static_cast< unsigned int >(common.size());
+		ranked[s].Tokens = static_cast< unsigned int >(subjectTokens.size());
+	}
+	RankedCandidateLess less;
+	less.Subjects = &this->Subjects;
+	std::sort(ranked.begin(), ranked.end(), less);
+	for (size_t s = 0; s < ranked.size(); ++s)
+	{
+		candidates.push_back(this->Subjects[ranked[s].Subject]);
+	}
+}
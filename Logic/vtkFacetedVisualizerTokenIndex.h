@@ -0,0 +1,108 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkFacetedVisualizerTokenIndex - inverted index of the words of the DB subjects
+// .SECTION Description
+// Splits every subject of the resources table into case-folded tokens at '_' and spaces
+// ("White_matter_of_cerebellum" -> white, matter, of, cerebellum) and keeps, for every
+// token, the sorted list of subjects that contain it. Subjects containing a set of tokens
+// are found by intersecting posting lists, starting with the shortest one.
+
+#ifndef __vtkFacetedVisualizerTokenIndex_h
+#define __vtkFacetedVisualizerTokenIndex_h
+
+// VTK includes
+#include <vtkObject.h>
+
+#include "vtkSlicerFacetedVisualizerModuleLogicExport.h"
+
+// STD includes
+#include <string>
+#include <vector>
+
+#include <vtk_sqlite3.h>
+#include <vtksys/hash_map.hxx>
+
+class VTK_SLICER_FACETEDVISUALIZER_MODULE_LOGIC_EXPORT vtkFacetedVisualizerTokenIndex :
+  public vtkObject
+{
+public:
+
+  static vtkFacetedVisualizerTokenIndex *New();
+  vtkTypeMacro(vtkFacetedVisualizerTokenIndex, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  // Reads the distinct subjects of the resources table. Returns false if they could not be
+  // read, in which case the index is left empty.
+  bool Build(vtk_sqlite3* ptrDB);
+
+  void Clear();
+
+  bool IsBuilt()
+  {
+	  return this->Built;
+  }
+
+  unsigned int GetNumberOfSubjects()
+  {
+	  return static_cast< unsigned int >(this->Subjects.size());
+  }
+
+  unsigned int GetNumberOfTokens()
+  {
+	  return static_cast< unsigned int >(this->Postings.size());
+  }
+
+//BTX
+  // Splits a term into lower case tokens at '_' and spaces
+  static void Tokenize(const std::string& term, std::vector< std::string >& tokens);
+
+  // Appends the IDs of the subjects that contain all tokens, in increasing order
+  void FindSubjectsWithTokens(const std::vector< std::string >& tokens, std::vector< int >& subjects);
+
+  // Candidate subjects for a name that is not in the DB. With n tokens, the subjects
+  // containing the first n-1 or the last n-1 tokens are tried, then n-2, down to two
+  // tokens, until some are found. Candidates are ranked by the number of the name's
+  // tokens they contain, then by fewest tokens of their own, then by name.
+  void Match(const std::vector< std::string >& tokens, std::vector< std::string >& candidates);
+
+  const std::string& GetSubject(int id)
+  {
+	  return this->Subjects[id];
+  }
+//ETX
+
+protected:
+  vtkFacetedVisualizerTokenIndex();
+  virtual ~vtkFacetedVisualizerTokenIndex();
+
+private:
+
+//BTX
+  std::vector< std::string >               Subjects;
+  std::vector< std::vector< int > >        SubjectTokens;
+  std::vector< std::vector< int > >        Postings;
+  vtksys::hash_map< std::string, int >     TokenIds;
+//ETX
+
+  bool                                     Built;
+
+  vtkFacetedVisualizerTokenIndex(const vtkFacetedVisualizerTokenIndex&); // Not implemented
+  void operator=(const vtkFacetedVisualizerTokenIndex&);               // Not implemented
+};
+
+#endif
@@ -0,0 +1,391 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// FacetedVisualizer includes
+#include "vtkFacetedVisualizerTripleStore.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <algorithm>
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFacetedVisualizerTripleStore);
+
+namespace
+{
+// orders the edges of one term by predicate, keeping the table order within a predicate
+struct EdgePredicateLess
+{
+	template< class EdgeType >
+	bool operator()(const EdgeType& a, const EdgeType& b) const
+	{
+		return a.Predicate < b.Predicate;
+	}
+};
+}
+
+//----------------------------------------------------------------------------
+vtkFacetedVisualizerTripleStore::vtkFacetedVisualizerTripleStore()
+{
+	this->Loaded = false;
+	this->ClosureGeneration = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkFacetedVisualizerTripleStore::~vtkFacetedVisualizerTripleStore()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerTripleStore::PrintSelf(ostream& os, vtkIndent indent)
+{
+	this->Superclass::PrintSelf(os, indent);
+	os << indent << "Loaded: " << this->Loaded << "\n";
+	os << indent << "NumberOfTerms: " << this->Terms.size() << "\n";
+	os << indent << "NumberOfTriples: " << this->ForwardEdges.size() << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerTripleStore::Clear()
+{
+	this->Terms.clear();
+	this->TermIds.clear();
+	this->ForwardOffsets.clear();
+	this->ForwardEdges.clear();
+	this->ReverseOffsets.clear();
+	this->ReverseEdges.clear();
+	this->VisitedMark.clear();
+	this->SubjectMark.clear();
+	this->ClosureGeneration = 0;
+	this->Loaded = false;
+}
+
+//----------------------------------------------------------------------------
+int vtkFacetedVisualizerTripleStore::InternTerm(const char* term)
+{
+	std::string text = term != NULL ? term : "";
+	vtksys::hash_map< std::string, int >::iterator it = this->TermIds.find(text);
+	if(it != this->TermIds.end())
+	{
+		return it->second;
+	}
+	int id = static_cast< int >(this->Terms.size());
+	this->Terms.push_back(text);
+	this->TermIds.insert(std::pair< const std::string, int >(text, id));
+	return id;
+}
+
+//----------------------------------------------------------------------------
+int vtkFacetedVisualizerTripleStore::GetTermId(const std::string& term)
+{
+	vtksys::hash_map< std::string, int >::iterator it = this->TermIds.find(term);
+	return it != this->TermIds.end() ? it->second : -1;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFacetedVisualizerTripleStore::Load(vtk_sqlite3* ptrDB)
+{
+	this->Clear();
+	if(ptrDB == NULL)
+	{
+		return false;
+	}
+
+	vtk_sqlite3_stmt *stmt;
+	const char *unused;
+	int status = vtk_sqlite3_prepare_v2(ptrDB, "SELECT subject, predicate, object from resources",
+			-1, &stmt, &unused);
+	if(status != VTK_SQLITE_OK)
+	{
+		vtkErrorMacro("Could not read resources table: " << vtk_sqlite3_errmsg(ptrDB));
+		return false;
+	}
+
+	std::vector< int > subjects;
+	std::vector< int > predicates;
+	std::vector< int > objects;
+	status = vtk_sqlite3_step(stmt);
+	while(status == VTK_SQLITE_ROW)
+	{
+		subjects.push_back(this->InternTerm(reinterpret_cast< const char* >(vtk_sqlite3_column_text(stmt, 0))));
+		predicates.push_back(this->InternTerm(reinterpret_cast< const char* >(vtk_sqlite3_column_text(stmt, 1))));
+		objects.push_back(this->InternTerm(reinterpret_cast< const char* >(vtk_sqlite3_column_text(stmt, 2))));
+		status = vtk_sqlite3_step(stmt);
+	}
+	vtk_sqlite3_finalize(stmt);
+	if(status != VTK_SQLITE_DONE)
+	{
+		vtkErrorMacro("Could not read resources table: " << vtk_sqlite3_errmsg(ptrDB));
+		this->Clear();
+		return false;
+	}
+
+	unsigned int numberOfTerms = static_cast< unsigned int >(this->Terms.size());
+	BuildAdjacency(subjects, predicates, objects, numberOfTerms, this->ForwardOffsets, this->ForwardEdges);
+	BuildAdjacency(objects, predicates, subjects, numberOfTerms, this->ReverseOffsets, this->ReverseEdges);
+	this->Loaded = true;
+	return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerTripleStore::BuildAdjacency(const std::vector< int >& from,
+		const std::vector< int >& predicates, const std::vector< int >& to,
+		unsigned int numberOfTerms, std::vector< unsigned int >& offsets, std::vector< Edge >& edges)
+{
+	// counting sort of the triples by their source term
+	offsets.assign(numberOfTerms+1, 0);
+	for (size_t n = 0; n < from.size(); ++n)
+	{
+		offsets[from[n]+1]++;
+	}
+	for (unsigned int t = 0; t < numberOfTerms; ++t)
+	{
+		offsets[t+1] += offsets[t];
+	}
+
+	edges.resize(from.size());
+	std::vector< unsigned int > next(offsets.begin(), offsets.end()-1);
+	for (size_t n = 0; n < from.size(); ++n)
+	{
+		Edge& edge = edges[next[from[n]]++];
+		edge.Predicate = predicates[n];
+		edge.Other = to[n];
+	}
+
+	// group the edges of every term by predicate
+	for (unsigned int t = 0; t < numberOfTerms; ++t)
+	{
+		if(offsets[t+1] - offsets[t] > 1)
+		{
+			std::stable_sort(edges.begin()+offsets[t], edges.begin()+offsets[t+1], EdgePredicateLess());
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerTripleStore::GetEdgeRange(const std::vector< unsigned int >& offsets,
+		const std::vector< Edge >& edges, int term, int predicate,
+		unsigned int& begin, unsigned int& end)
+{
+	begin = offsets[term];
+	end = offsets[term+1];
+	if(predicate < 0 || begin == end)
+	{
+		return;
+	}
+	Edge key;
+	key.Predicate = predicate;
+	key.Other = 0;
+	std::pair< std::vector< Edge >::const_iterator, std::vector< Edge >::const_iterator > range =
+			std::equal_range(edges.begin()+begin, edges.begin()+end, key, EdgePredicateLess());
+	begin = static_cast< unsigned int >(range.first - edges.begin());
+	end = static_cast< unsigned int >(range.second - edges.begin());
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerTripleStore::GetObjects(int subject, int predicate, std::vector< int >& objects)
+{
+	if(!this->Loaded || subject < 0 || subject >= static_cast< int >(this->Terms.size()))
+	{
+		return;
+	}
+	unsigned int begin, end;
+	GetEdgeRange(this->ForwardOffsets, this->ForwardEdges, subject, predicate, begin, end);
+	for (unsigned int e = begin; e < end; ++e)
+	{
+		objects.push_back(this->ForwardEdges[e].Other);
+	}
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerTripleStore::GetSubjects(int object, int predicate, std::vector< int >& subjects)
+{
+	if(!this->Loaded || object < 0 || object >= static_cast< int >(this->Terms.size()))
+	{
+		return;
+	}
+	unsigned int begin, end;
+	GetEdgeRange(this->ReverseOffsets, this->ReverseEdges, object, predicate, begin, end);
+	for (unsigned int e = begin; e < end; ++e)
+	{
+		subjects.push_back(this->ReverseEdges[e].Other);
+	}
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerTripleStore::AppendRows(const std::vector< unsigned int >& offsets,
+		const std::vector< Edge >& edges, int term, int predicate, bool termIsSubject,
+		int skipOther, std::vector< std::vector< std::string > >& rows)
+{
+	unsigned int begin, end;
+	GetEdgeRange(offsets, edges, term, predicate, begin, end);
+	for (unsigned int e = begin; e < end; ++e)
+	{
+		if(edges[e].Other == skipOther)
+		{
+			continue;
+		}
+		std::vector< std::string > row(3);
+		row[0] = this->Terms[termIsSubject ? term : edges[e].Other];
+		row[1] = this->Terms[edges[e].Predicate];
+		row[2] = this->Terms[termIsSubject ? edges[e].Other : term];
+		rows.push_back(row);
+	}
+}
+
+//----------------------------------------------------------------------------
+int vtkFacetedVisualizerTripleStore::Lookup(const std::string& term, bool asObject, bool asSubject,
+		const std::string& predicate, std::vector< std::vector< std::string > >& rows)
+{
+	rows.clear();
+	int termId = this->GetTermId(term);
+	int predicateId = -1;
+	if(predicate != "")
+	{
+		predicateId = this->GetTermId(predicate);
+		if(predicateId < 0)
+		{
+			return 0;
+		}
+	}
+	if(!this->Loaded || termId < 0)
+	{
+		return 0;
+	}
+
+	bool both = !asObject && !asSubject;
+	if(both || asSubject)
+	{
+		this->AppendRows(this->ForwardOffsets, this->ForwardEdges, termId, predicateId, true, -1, rows);
+	}
+	if(both || asObject)
+	{
+		// a triple that has the term as both subject and object was already added above
+		this->AppendRows(this->ReverseOffsets, this->ReverseEdges, termId, predicateId, false,
+				both ? termId : -1, rows);
+	}
+	return static_cast< int >(rows.size());
+}
+
+//----------------------------------------------------------------------------
+void vtkFacetedVisualizerTripleStore::ComputeClosure(int term, int predicate, bool termIsSubject,
+		const std::vector< int >& recursionPredicates,
+		const std::vector< int >& inverseRecursionPredicates,
+		std::vector< int >& subjects, std::vector< int >& depths)
+{
+	subjects.clear();
+	depths.clear();
+	if(!this->Loaded || term < 0 || predicate < 0)
+	{
+		return;
+	}
+	if(this->VisitedMark.size() != this->Terms.size() || this->ClosureGeneration == 0xffffffff)
+	{
+		this->VisitedMark.assign(this->Terms.size(), 0);
+		this->SubjectMark.assign(this->Terms.size(), 0);
+		this->ClosureGeneration = 0;
+	}
+	unsigned int mark = ++this->ClosureGeneration;
+
+	// depth 0: the seed rows
+	std::vector< int > frontier;
+	std::vector< int > reached;
+	this->VisitedMark[term] = mark;
+	if(termIsSubject)
+	{
+		this->GetObjects(term, predicate, reached);
+		if(!reached.empty())
+		{
+			this->SubjectMark[term] = mark;
+			subjects.push_back(term);
+			depths.push_back(0);
+		}
+	}
+	else
+	{
+		this->GetSubjects(term, predicate, reached);
+		for (size_t n = 0; n < reached.size(); ++n)
+		{
+			if(this->SubjectMark[reached[n]] != mark)
+			{
+				this->SubjectMark[reached[n]] = mark;
+				subjects.push_back(reached[n]);
+				depths.push_back(0);
+			}
+		}
+	}
+	for (size_t n = 0; n < reached.size(); ++n)
+	{
+		if(this->VisitedMark[reached[n]] != mark)
+		{
+			this->VisitedMark[reached[n]] = mark;
+			frontier.push_back(reached[n]);
+		}
+	}
+
+	int depth = 1;
+	while(!frontier.empty())
+	{
+		std::vector< int > nextFrontier;
+		for (size_t f = 0; f < frontier.size(); ++f)
+		{
+			int current = frontier[f];
+			for (size_t p = 0; p < recursionPredicates.size(); ++p)
+			{
+				reached.clear();
+				this->GetObjects(current, recursionPredicates[p], reached);
+				if(!reached.empty() && this->SubjectMark[current] != mark)
+				{
+					this->SubjectMark[current] = mark;
+					subjects.push_back(current);
+					depths.push_back(depth);
+				}
+				for (size_t n = 0; n < reached.size(); ++n)
+				{
+					if(this->VisitedMark[reached[n]] != mark)
+					{
+						this->VisitedMark[reached[n]] = mark;
+						nextFrontier.push_back(reached[n]);
+					}
+				}
+			}
+			for (size_t p = 0; p < inverseRecursionPredicates.size(); ++p)
+			{
+				reached.clear();
+				this->GetSubjects(current, inverseRecursionPredicates[p], reached);
+				for (size_t n = 0; n < reached.size(); ++n)
+				{
+					if(this->SubjectMark[reached[n]] != mark)
+					{
+						this->SubjectMark[reached[n]] = mark;
+						subjects.push_back(reached[n]);
+						depths.push_back(depth);
+					}
+					if(this->VisitedMark[reached[n]] != mark)
+					{
+						this->VisitedMark[reached[n]] = mark;
+						nextFrontier.push_back(reached[n]);
+					}
+				}
+			}
+		}
+		frontier.swap(nextFrontier);
+		++depth;
+	}
+}
@@ -0,0 +1,153 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkFacetedVisualizerTripleStore - in-memory copy of the ontology resources table
+// .SECTION Description
+// Loads the (subject, predicate, object) triples of the resources table once, interns
+// every term to an integer ID and keeps compressed (CSR) adjacency lists for both
+// directions. Within the list of a term the edges are grouped by predicate, so the
+// lookups done by the faceted visualizer logic are a binary search plus a scan of the
+// matching edges instead of a SQL round trip.
+
+#ifndef __vtkFacetedVisualizerTripleStore_h
+#define __vtkFacetedVisualizerTripleStore_h
+
+// VTK includes
+#include <vtkObject.h>
+
+#include "vtkSlicerFacetedVisualizerModuleLogicExport.h"
+
+// STD includes
+#include <string>
+#include <vector>
+
+#include <vtk_sqlite3.h>
+#include <vtksys/hash_map.hxx>
+
+class VTK_SLICER_FACETEDVISUALIZER_MODULE_LOGIC_EXPORT vtkFacetedVisualizerTripleStore :
+  public vtkObject
+{
+public:
+
+  static vtkFacetedVisualizerTripleStore *New();
+  vtkTypeMacro(vtkFacetedVisualizerTripleStore, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  // Reads the whole resources table of the DB. Returns false if the table could not be read,
+  // in which case the store is left empty.
+  bool Load(vtk_sqlite3* ptrDB);
+
+  void Clear();
+
+  bool IsLoaded()
+  {
+	  return this->Loaded;
+  }
+
+  unsigned int GetNumberOfTriples()
+  {
+	  return static_cast< unsigned int >(this->ForwardEdges.size());
+  }
+
+  unsigned int GetNumberOfTerms()
+  {
+	  return static_cast< unsigned int >(this->Terms.size());
+  }
+
+//BTX
+  // Returns the ID of a term (subjects, objects and predicates share one ID space) or -1.
+  int GetTermId(const std::string& term);
+
+  const std::string& GetTerm(int id)
+  {
+	  return this->Terms[id];
+  }
+
+  // Appends the IDs of the objects of (subject, predicate, *) triples
+  void GetObjects(int subject, int predicate, std::vector< int >& objects);
+
+  // Appends the IDs of the subjects of (*, predicate, object) triples
+  void GetSubjects(int object, int predicate, std::vector< int >& subjects);
+
+  // Same contract as vtkSlicerFacetedVisualizerLogic::ExecuteLookup: fills rows with the
+  // (subject, predicate, object) triples that have the term as subject, object or either,
+  // optionally restricted to a predicate, and returns the number of rows.
+  int Lookup(const std::string& term, bool asObject, bool asSubject,
+		  const std::string& predicate, std::vector< std::vector< std::string > >& rows);
+
+  // Walks the part-of hierarchy the way the logic's traversal does, starting from the
+  // (term, predicate, *) triples if termIsSubject or the (*, predicate, term) triples otherwise,
+  // and following the recursion predicates from subject to object and the inverse recursion
+  // predicates from object to subject. Fills subjects with the subjects of every row the walk
+  // visits, each once, and depths with the level at which it was first found.
+  void ComputeClosure(int term, int predicate, bool termIsSubject,
+		  const std::vector< int >& recursionPredicates,
+		  const std::vector< int >& inverseRecursionPredicates,
+		  std::vector< int >& subjects, std::vector< int >& depths);
+//ETX
+
+protected:
+  vtkFacetedVisualizerTripleStore();
+  virtual ~vtkFacetedVisualizerTripleStore();
+
+private:
+
+//BTX
+  struct Edge
+  {
+	  int Predicate;
+	  int Other;
+  };
+
+  int InternTerm(const char* term);
+
+  // builds the offsets/edges arrays of one direction from the flat triple arrays
+  static void BuildAdjacency(const std::vector< int >& from, const std::vector< int >& predicates,
+		  const std::vector< int >& to, unsigned int numberOfTerms,
+		  std::vector< unsigned int >& offsets, std::vector< Edge >& edges);
+
+  // range of the edges of a term with the given predicate (all edges if predicate is -1)
+  static void GetEdgeRange(const std::vector< unsigned int >& offsets, const std::vector< Edge >& edges,
+		  int term, int predicate, unsigned int& begin, unsigned int& end);
+
+  void AppendRows(const std::vector< unsigned int >& offsets, const std::vector< Edge >& edges,
+		  int term, int predicate, bool termIsSubject, int skipOther,
+		  std::vector< std::vector< std::string > >& rows);
+
+  std::vector< std::string >               Terms;
+  vtksys::hash_map< std::string, int >     TermIds;
+
+  // edges by subject (Other is the object) and by object (Other is the subject)
+  std::vector< unsigned int >              ForwardOffsets;
+  std::vector< Edge >                      ForwardEdges;
+  std::vector< unsigned int >              ReverseOffsets;
+  std::vector< Edge >                      ReverseEdges;
+
+  // per-term marks of the last ComputeClosure call, compared against ClosureGeneration so
+  // they never need to be cleared
+  std::vector< unsigned int >              VisitedMark;
+  std::vector< unsigned int >              SubjectMark;
+  unsigned int                             ClosureGeneration;
+//ETX
+
+  bool                                     Loaded;
+
+  vtkFacetedVisualizerTripleStore(const vtkFacetedVisualizerTripleStore&); // Not implemented
+  void operator=(const vtkFacetedVisualizerTripleStore&);               // Not implemented
+};
+
+#endif
@@ -1,1414 +1,3780 @@
-/*==============================================================================
-
-  Program: 3D Slicer
-
-  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
-
-  See COPYRIGHT.txt
-  or http://www.slicer.org/copyright/copyright.txt for details.
-
-  Unless required by applicable law or agreed to in writing, software
-  distributed under the License is distributed on an "AS IS" BASIS,
-  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
-  See the License for the specific language governing permissions and
-  limitations under the License.
-
-==============================================================================*/
-
-// FacetedVisualizer includes
-#include "vtkSlicerFacetedVisualizerLogic.h"
-
-// MRML includes
-#include "vtkMRMLScene.h"
-#include "vtkMRMLScalarVolumeNode.h"
-#include "vtkMRMLModelHierarchyNode.h"
-#include "vtkMRMLModelDisplayNode.h"
-#include "vtkMRMLModelNode.h"
-#include "vtkCollection.h"
-
-// VTK includes
-#include <vtkNew.h>
-
-// STD includes
-#include <cassert>
-#include <cstring>
-#include <string>
-#include <algorithm>
-#include <utility>
-#include <string>
-#include <cctype>
-
-
-#include "vtk_sqlite3.h"
-
-//----------------------------------------------------------------------------
-vtkStandardNewMacro(vtkSlicerFacetedVisualizerLogic);
-
-//----------------------------------------------------------------------------
-vtkSlicerFacetedVisualizerLogic::vtkSlicerFacetedVisualizerLogic()
-{
-
-  setValidDBFileName = false;
-	// filter predicates for continuing recursive queries to DB
-	recursionPredicates.push_back("regional_part");
-	recursionPredicates.push_back("consitutional_part");
-	recursionPredicates.push_back("systemic_part");
-	recursionPredicates.push_back("member");
-	recursionPredicates.push_back("subClass");
-
-	addRecursionPredicates.push_back("regional_part_of");
-	addRecursionPredicates.push_back("constitutional_part_of");
-	addRecursionPredicates.push_back("systemic_part_of");
-	addRecursionPredicates.push_back("memberOf");
-	addRecursionPredicates.push_back("subClassOf");
-
-	// filter predicates to ignore from adding to results
-	ignorePredicates.push_back("label");
-	ignorePredicates.push_back("fmaid");
-	// these are required only for a specific DB that Harini had to modify to work with the
-	// earlier implementation of Faceted Search Atlas
-	ignorePredicates.push_back("assocmrmlnode");
-	ignorePredicates.push_back("assocematlaslabel");
-	ignorePredicates.push_back("hasematlasname");
-
-	commentPredicates.push_back("comment");
-	commentPredicates.push_back("definition");
-
-
-	maxQueryHistory = 10; // lets use only 3 queries in the cache right now
-
-	cacheSize = 3000;
-
-}
-
-//----------------------------------------------------------------------------
-vtkSlicerFacetedVisualizerLogic::~vtkSlicerFacetedVisualizerLogic()
-{
-}
-
-//----------------------------------------------------------------------------
-void vtkSlicerFacetedVisualizerLogic::PrintSelf(ostream& os, vtkIndent indent)
-{
-  this->Superclass::PrintSelf(os, indent);
-}
-
-//---------------------------------------------------------------------------
-void vtkSlicerFacetedVisualizerLogic::SetMRMLSceneInternal(vtkMRMLScene * newScene)
-{
-  vtkNew<vtkIntArray> events;
-  events->InsertNextValue(vtkMRMLScene::NodeAddedEvent);
-  events->InsertNextValue(vtkMRMLScene::NodeRemovedEvent);
-  events->InsertNextValue(vtkMRMLScene::EndBatchProcessEvent);
-  this->SetAndObserveMRMLSceneEventsInternal(newScene, events.GetPointer());
-}
-
-//-----------------------------------------------------------------------------
-void vtkSlicerFacetedVisualizerLogic::RegisterNodes()
-{
-  assert(this->GetMRMLScene() != 0);
-}
-
-//---------------------------------------------------------------------------
-void vtkSlicerFacetedVisualizerLogic::UpdateFromMRMLScene()
-{
-  assert(this->GetMRMLScene() != 0);
-}
-
-//---------------------------------------------------------------------------
-void vtkSlicerFacetedVisualizerLogic
-::OnMRMLSceneNodeAdded(vtkMRMLNode* vtkNotUsed(node))
-{
-}
-
-//---------------------------------------------------------------------------
-void vtkSlicerFacetedVisualizerLogic
-::OnMRMLSceneNodeRemoved(vtkMRMLNode* vtkNotUsed(node))
-{
-}
-
-///////////////////////////////////////////////////////////////////////////////////////
-// Helper methods
-///////////////////////////////////////////////////////////////////////////////////////
-
-//---------------------------------------------------------------------------
-void vtkSlicerFacetedVisualizerLogic::toLower(std::string origstr, std::string& newstr)
-{
-   std::locale loc;
-   newstr = "";
-   for (unsigned int i = 0; i < origstr.length(); i++)
-   {
-#ifdef WIN32
-      newstr += std::tolower(origstr[i]);
-#else
-	  newstr += std::tolower(origstr[i],loc);
-#endif
-	   
-   }
-}
-
-//---------------------------------------------------------------------------
-void vtkSlicerFacetedVisualizerLogic::toUpper(std::string origstr, std::string& newstr)
-{
-   std::locale loc;
-   newstr = "";
-   for (unsigned int i = 0; i < origstr.length(); i++)
-   {
-#ifdef WIN32
-      newstr += std::toupper(origstr[i]);
-#else
-	  newstr += std::toupper(origstr[i],loc);
-#endif
-   }
-}
-
-//---------------------------------------------------------------------------
-void vtkSlicerFacetedVisualizerLogic::removeLeadingFollowingSpace(std::string &origstr)
-{
-
-	  size_t pos = origstr.find_first_of(" ");
-	  while(pos != std::string::npos && pos < 1)
-	  {
-	    origstr = origstr.substr(pos+1);
-	    pos = origstr.find_first_of(" ");
-	  }
-	  unsigned len = origstr.length();
-	  pos = origstr.find_last_of(" ");
-	  while(pos != std::string::npos && pos > len - 2)
-	  {
-	    origstr = origstr.substr(0, pos);
-	    pos = origstr.find_last_of(" ");
-	    len = origstr.length();
-	  }
-
-}
-
-//---------------------------------------------------------------------------
-int vtkSlicerFacetedVisualizerLogic::
-AddQueryResult(std::string &text, std::vector< std::string >& store)
-{
-
-	bool found = false;
-	int index = -1;
-	for (unsigned n = 0; !found && n < store.size(); ++n)
-	{
-		found = store[n] == text; //std::strcmp(store[n],text) == 0;
-		index = n;
-	}
-	if(!found)
-	{
-		store.push_back(text);
-		index = store.size()-1;
-	}
-	return index;
-}
-
-
-//---------------------------------------------------------------------------
-std::string vtkSlicerFacetedVisualizerLogic::GetDBSubject(std::string &query,
-		vtk_sqlite3* ptrDB)
-{
-
-	char *errmsg;
-	char **currResult;
-	int nrows, ncols;
-	std::string Subject = query;
-
-	char *sqlQuery = ProduceQuery(Subject, false, true,"");
-
-
-	vtk_sqlite3_get_table(ptrDB, sqlQuery, &currResult, &nrows, &ncols, &errmsg);
-	if(nrows <= 0)
-	{
-		// check if we have an equivalent query term
-		std::map<std::string, std::string>::iterator rEq = eqQueryMap.find(query);
-		if(rEq != eqQueryMap.end())
-		{
-			Subject = (*rEq).second;
-
-		}
-		else
-		{
-			sqlQuery = ProduceQuery(query, true, false, "non_english_equivalent");
-			int status = vtk_sqlite3_get_table(ptrDB, sqlQuery, &currResult, &nrows, &ncols, &errmsg);
-			if(nrows <= 0)
-			{
-				sqlQuery = ProduceQuery(query, true, false, "synonym");
-				status = vtk_sqlite3_get_table(ptrDB, sqlQuery, &currResult, &nrows, &ncols, &errmsg);
-				if(nrows <=0)
-				{
-					return "null";
-				}
-				else
-				{
-					Subject = *(currResult+(ncols+0));
-				}
-			}
-			else
-			{
-				Subject = *(currResult+(ncols+0));
-			}
-			eqQueryMap.insert(std::pair< std::string, std::string > (query, Subject));
-		}
-	}
-
-	return Subject;
-}
-
-
-
-//---------------------------------------------------------------------------
-void vtkSlicerFacetedVisualizerLogic
-::GetQueryResults(std::vector< std::vector < std::string > > &results, std::vector< std::string > &queries)
-{
-
-	for (unsigned n = 0; n < resultsForDisplay.size(); ++n)
-	{
-		size_t pos = resultsForDisplay[n].find(";");
-		std::string q = resultsForDisplay[n].substr(0, pos);
-		unsigned int index = this->AddQueryResult(q, queries);
-		if(index == results.size())
-		{
-			std::vector< std::string > newresults;
-			newresults.push_back(resultsForDisplay[n].substr(pos+1));
-			results.push_back(newresults);
-		}
-		else
-		{
-			results[index].push_back(resultsForDisplay[n].substr(pos+1));
-		}
-	}
-}
-
-
-//---------------------------------------------------------------------------
-char* vtkSlicerFacetedVisualizerLogic::ProduceQuery(std::string& string,
-		                               bool asObject,
-		                               bool asSubject,
-		                               std::string Predicate)
-{
-
-	// convert string to DB form
-    size_t pos = string.find_first_of("'");
-	if(pos != std::string::npos)
-	{
-	  string = string.substr(pos+1);
-	}
-	pos = string.find_last_of("'");
-	if(pos != std::string::npos)
-	{
-       string = string.substr(0, pos);
-	}
-	// remove any paranthesis
-	pos = string.find_first_of("(");
-	if(pos != std::string::npos)
-	{
-	   string = string.substr(pos+1);
-	}
-	pos = string.find_last_of(")");
-	if(pos != std::string::npos)
-	{
-	  string = string.substr(0, pos);
-	}
-	string[0] = std::toupper(string[0]);
-	pos = string.find_first_of(" ");
-	while(pos != std::string::npos)
-	{
-	   std::string leadstr = string.substr(0, pos);
-	   std::string trailstr = string.substr(pos+1);
-	   string = leadstr + "_" + trailstr;
-	   pos = string.find_first_of(" ");
-	}
-
-	 //if(std::strcmp(Predicate.c_str(),"")==0)
-	if(Predicate == "")
-	{
-	   if(!asObject && !asSubject)
-	   {
-	      return (vtk_sqlite3_mprintf("SELECT * from resources where subject = '%q' or object = '%q'",
-	        		string.c_str(), string.c_str()));
-	   }
-	   else if(asObject)
-	   {
-		   return (vtk_sqlite3_mprintf("SELECT * from resources where object = '%q'", string.c_str()));
-	   }
-	   else
-	   {
-  		  return (vtk_sqlite3_mprintf("SELECT * from resources where subject = '%q'", string.c_str()));
-	   }
-	 }
-	 else
-	 {
-		 if(!asObject && !asSubject)
-		   {
-			  return (vtk_sqlite3_mprintf("SELECT * from resources where (subject = '%q' or object = '%q') and predicate = '%q'",
-					  string.c_str(), string.c_str(), Predicate.c_str()));
-		   }
-		   else if(asObject)
-		   {
-			   return (vtk_sqlite3_mprintf("SELECT * from resources where object = '%q' and predicate = '%q'",
-					   string.c_str(), Predicate.c_str()));
-		   }
-		   else
-		   {
-			  return (vtk_sqlite3_mprintf("SELECT * from resources where subject = '%q' and predicate = '%q'",
-					  string.c_str(), Predicate.c_str()));
-		   }
-	 }
-
-}
-
-
-//----------------------------------------------------------------------------------
-// syncs a given model with the Database. Checks if the model can be found in the DB
-
-void vtkSlicerFacetedVisualizerLogic::SyncModelWithDB(vtkMRMLModelHierarchyNode *modelNode,
-		vtk_sqlite3* ptrDB, std::vector< std::string > &possibleMatchingDBEntries)
-{
-
-	// Following is to fix working with the Abdominal atlas
-	std::string modelName = modelNode->GetName();
-	std::string lomodelName;
-	this->toLower(modelName, lomodelName);
-	size_t posCheck = lomodelName.find("vtkmrmlmodelhierarchynode");
-	if(posCheck != std::string::npos)
-	{
-		modelName = vtkMRMLModelNode::SafeDownCast(modelNode->GetAssociatedNode())->GetName();
-		std::cout<<" using mrmlmodelNode instead of hierarchy node "<<modelName<<std::endl;
-		this->toLower(modelName, lomodelName);
-		posCheck = lomodelName.find("_");
-		if(posCheck != std::string::npos)
-		{
-			lomodelName = lomodelName.substr(posCheck+1);
-			posCheck = lomodelName.find_first_of("_");
-			lomodelName = lomodelName.substr(posCheck+1);
-		}
-	}
-
-	// convert the model name string in to the correct form for use in the DB.
-	// Currently we assume that in the DB, the atoms are represented as "White_matter_of_cerebellum"
-	// following the way the atoms are represented in the FMA ontology
-	std::string string = lomodelName;
-	// convert string to DB form
-	size_t pos = string.find_first_of("'");
-	if(pos != std::string::npos)
-	{
-	  string = string.substr(pos+1);
-	}
-	pos = string.find_last_of("'");
-	if(pos != std::string::npos)
-	{
-	   string = string.substr(0, pos);
-	}
-	// remove any paranthesis
-	pos = string.find_first_of("(");
-	if(pos != std::string::npos)
-	{
-	   string = string.substr(pos+1);
-	}
-	pos = string.find_last_of(")");
-	if(pos != std::string::npos)
-	{
-	  string = string.substr(0, pos);
-	}
-	string[0] = std::toupper(string[0]);
-
-	std::vector< std::string > individualStrings;
-	int countNonWildCardStrings = 0;
-	pos = string.find_first_of(" ");
-
-	// the following gets rid of non-useful search strings to break down a complex string into
-	// individual strings so we can match the model to the DB using individual string combinations
-	// Ex: "White_matter_of_cerebellum" as "White_matter%", "%matter%cerebellum", etc.
-
-	while(pos != std::string::npos)
-	{
-	   std::string leadstr = string.substr(0, pos);
-	   std::string trailstr = string.substr(pos+1);
-	   size_t p = leadstr.find_last_of("_");
-	   std::string tmpstr = leadstr;
-	   if( p != std::string::npos)
-	   {
-		   tmpstr = leadstr.substr(p+1);
-	   }
-
-	   std::cout<<" leadstr "<<tmpstr<<std::endl;
-
-	   bool foundIgnore = strcmp(tmpstr.c_str(), "of") == 0;
-	   if(!foundIgnore)
-	   {
-		 individualStrings.push_back(tmpstr);
-	   }
-
-	   string = leadstr + "_" + trailstr;
-	   pos = string.find_first_of(" ");
-
-	   if(pos == std::string::npos)
-	   {
-		   foundIgnore = strcmp(trailstr.c_str(), "of") == 0;
-		   if(!foundIgnore)
-		   {
-			   individualStrings.push_back(trailstr);
-		   }
-	   }
-	   countNonWildCardStrings = individualStrings.size();
-	}
-
-	modelName = string;
-
-   // convert text to DB form
-   char *query = this->ProduceQuery(modelName, false, false,"");
-   std::cout<<" Synching model "<<modelName<<" with DB and \n query "<<query<<std::endl;
-   // confirm that the query occurs in the DB
-   char *errmsg;
-   char **currResult;
-   int nrows, ncols;
-
-   // querying DB to test if the current node is present
-   int status = vtk_sqlite3_get_table(ptrDB, query, &currResult, &nrows, &ncols, &errmsg);
-
-   if(nrows > 0)
-   {
-	   // parse the query string into individual parts
-	   std::cout<<" inserting into modelDB pair "<<modelName<<" : "<<modelNode->GetName()<<std::endl;
-	   mrmlDBTerms.insert(std::pair< std::string, std::string > (this->GetDBSubject(modelName, ptrDB), modelNode->GetName()));
-       possibleMatchingDBEntries.push_back(this->GetDBSubject(modelName, ptrDB));
-   }
-   else if(individualStrings.size() > 0)
-   {
-
-	   bool foundInDB = false;
-	   unsigned int count = 1;
-	   while(!foundInDB && count < individualStrings.size()-1)
-	   {
-		   std::string str2 = "";
-		   for(int s = individualStrings.size()-count-1; s >=0; s--)
-		   {
-			   str2 = individualStrings[s] + "%" + str2;
-		   }
-		   std::string str1 = "";
-		   for (unsigned int s = count; s < individualStrings.size(); s++)
-		   {
-			   str1 += "%" + individualStrings[s];
-
-		   }
-		   ++count;
-		   if(individualStrings.size() == 2)
-		   {
-		     std::cout<<" trying to match "<<modelName<<" with new strings "<<str1<<"  & "<<str2<<std::endl;
-		   }
-		   char *newquery = vtk_sqlite3_mprintf("select * from resources where subject like '%q' or subject like '%q'",
-				   str1.c_str(), str2.c_str());
-
-		   status = vtk_sqlite3_get_table(ptrDB, newquery, &currResult, &nrows, &ncols, &errmsg);
-		   if(individualStrings.size() == 2)
-		   {
-		     std::cout<<"number of results from SQL query "<<nrows<<std::endl;
-		   }
-		   if(nrows > 0)
-		   {
-			   foundInDB = true;
-
-			   for (int nr = 1; nr < nrows; ++nr)
-			   {
-				   std::string tmpstr = *(currResult+(nr*ncols));
-				   this->AddQueryResult(tmpstr, possibleMatchingDBEntries);
-			   }
-		   }
-	   }
-	   if(!foundInDB)
-	   {
-		   // Add the node as a local non-DB node
-		   std::string modelName = modelNode->GetName();
-		   this->AddQueryResult(modelName, this->nonDBElements);
-	   }
-   }
-
-}
-
-//------------------------------------------------------------------------------------
-void vtkSlicerFacetedVisualizerLogic
-::SynchronizeAtlasWithDB(std::vector< std::vector< std::string > > &matchingDBAtoms,
-		std::vector< std::string > &MRMLAtoms)
-{
-   
-
-	matchingDBAtoms.clear();
-	MRMLAtoms.clear();
-	this->nonDBElements.clear();
-	this->mrmlDBTerms.clear();
-
-   std::vector< std::string > DBModelNodes;
-   // get the models in the atlas
-   vtk_sqlite3 *ptrDB;
-   int status = vtk_sqlite3_open(dbFileName.c_str(), &ptrDB);
-   if(status != 0)
-   {
-	   this->setValidDBFileName = false;
-     unsigned int nmodelNodes = this->GetMRMLScene()->GetNumberOfNodesByClass("vtkMRMLModelNode");
-     std::cout<<" Number Model Nodes "<<nmodelNodes<<std::endl;
-     // the first three are red, yellow and green slices
-     for (unsigned int n = 0; n < nmodelNodes; ++n)
-     {
-       vtkMRMLModelNode *modelNode = vtkMRMLModelNode::SafeDownCast(
-           this->GetMRMLScene()->GetNthNodeByClass(n, "vtkMRMLModelNode"));
-
-       std::string modelName = modelNode->GetName();
-       this->AddQueryResult(modelName, this->nonDBElements);
-     }
-
-     return;
-   }
-   else
-   {
-      this->setValidDBFileName = true;
-   }
- 
-   unsigned int nmodels = this->GetMRMLScene()->GetNumberOfNodesByClass("vtkMRMLModelHierarchyNode");
-
-   for (unsigned int n = 0; n < nmodels; n++)
-   {
-	  // get model name and check if the corresponding text exists in the database
-       vtkMRMLModelHierarchyNode *modelNode = vtkMRMLModelHierarchyNode::SafeDownCast(
-    		   this->GetMRMLScene()->GetNthNodeByClass(n, "vtkMRMLModelHierarchyNode"));
-
-       if(modelNode->GetNumberOfChildrenNodes() == 0)
-       {
-    	   std::string nodeID = modelNode->GetAssociatedNodeID();
-    	   this->AddQueryResult(nodeID, DBModelNodes);
-
-       }
-       else
-       {
-		   vtkSmartPointer<vtkCollection> c = vtkSmartPointer<vtkCollection>::New();
-
-		   modelNode->GetChildrenModelNodes(c);
-
-		   for (int t = 0; t < c->GetNumberOfItems(); ++t)
-		   {
-			  vtkMRMLModelNode *node = vtkMRMLModelNode::SafeDownCast(c->GetItemAsObject(t));
-			  std::string nodeID = node->GetID();
-			  this->AddQueryResult(nodeID, DBModelNodes);
-		   }
-       }
-       std::vector< std::string > possibleMatchingEntries;
-       this->SyncModelWithDB(modelNode, ptrDB, possibleMatchingEntries);
-       std::string modelName = modelNode->GetName();
-       //if(possibleMatchingEntries.size() > 0)
-       //{
-         matchingDBAtoms.push_back(possibleMatchingEntries);
-         MRMLAtoms.push_back(modelName);
-       //}
-
-   }
-
-   // close the database
-    vtk_sqlite3_close(ptrDB);
-
-   // get all the model nodes and check if they are already used by the hierarchy nodes.
-   // otherwise we just add it as a non-DB node and use it directly for displaying when the appropriate
-   // user query is encountered. Useful for displaying user added models to the scene
-
-   unsigned int nmodelNodes = this->GetMRMLScene()->GetNumberOfNodesByClass("vtkMRMLModelNode");
-   std::cout<<" Number Model Nodes "<<nmodelNodes<<std::endl;
-   // the first three are red, yellow and green slices
-   for (unsigned int n = 0; n < nmodelNodes; ++n)
-   {
-	   vtkMRMLModelNode *modelNode = vtkMRMLModelNode::SafeDownCast(
-			   this->GetMRMLScene()->GetNthNodeByClass(n, "vtkMRMLModelNode"));
-
-	   std::string modelName = modelNode->GetName();
-	   std::string modelID = modelNode->GetID();
-
-	   bool foundNode = false;
-	   for (unsigned m = 0; !foundNode && m < DBModelNodes.size(); ++m)
-	   {
-		   foundNode = DBModelNodes[m] == modelID;
-	   }
-	   if(!foundNode)
-	   {
-	      this->AddQueryResult(modelName, this->nonDBElements);
-	   }
-   }
-
-   // print out the Non DB nodes for debugging
-   std::cout<<" num non DB elements "<<this->nonDBElements.size()<<std::endl;
-   for (unsigned k = 0; k < this->nonDBElements.size(); ++k)
-   {
-	   std::cout<<" "<<this->nonDBElements[k]<<std::endl;
-   }
-
-}
-
-//------------------------------------------------------------------------------------
-int vtkSlicerFacetedVisualizerLogic::RecursiveProcessQuery(char* sqlquery,
-		                              vtk_sqlite3* ptrDB,
-		                              bool queryAsSubject,
-		                              std::vector< std::string > &displayTerms)
-{
-
-	char *errmsg;
-	char **currResult;
-	int nrows, ncols;
-
-	vtk_sqlite3_get_table(ptrDB, sqlquery, &currResult, &nrows, &ncols, &errmsg);
-	std::vector< std::string > recursionSubjects;
-
-	if(nrows > 0)
-	{
-		std::cout<<" number of row results "<<nrows<<" for query "<<sqlquery<<std::endl;
-	}
-	if(nrows <= 0)
-	{
-		return -1;
-	}
-
-	std::string query = sqlquery;
-
-	size_t p1 = query.find(" SUBJECT = ");
-
-	std::string querySubject = "";
-	if(p1 != std::string::npos)
-	{
-		querySubject = query.substr(p1+12);
-		size_t p2 = querySubject.find(" and OBJECT = ");
-		if(p2 != std::string::npos)
-		{
-			querySubject = querySubject.substr(0, p2-1);
-		}
-	}
-
-	if(nrows > 0)
-	{
-
-		for (int nr = 1; nr <= nrows; nr++)
-		{
-
-			std::string rowResult;
-			bool displayResult = false;
-			bool DontAddToResults = false;
-			std::vector< std::string> term;
-			term.resize(3);
-			for (int nc = 0; nc < ncols; ++nc)
-			{
-				term[nc] = *(currResult+(nr*ncols+nc));
-			}
-
-			std::pair< std::multimap< std::string, std::string >::iterator,
-			          std::multimap< std::string, std::string > ::iterator > mrmlIt;
-			if(!queryAsSubject)
-			{
-			  mrmlIt = mrmlDBTerms.equal_range(this->GetDBSubject(term[0], ptrDB)); //mrmlDBTerms.find(this->GetDBSubject(term[0], ptrDB));
-			}
-			else
-			{
-				mrmlIt = mrmlDBTerms.equal_range(this->GetDBSubject(term[0], ptrDB));//mrmlDBTerms.find(this->GetDBSubject(term[2], ptrDB));
-			}
-			std::multimap< std::string, std::string >::iterator itr1 = mrmlIt.first;
-			std::multimap< std::string, std::string >::iterator itr2 = mrmlIt.second;
-
-			if(itr1 != mrmlDBTerms.end())
-			{
-				std::multimap< std::string, std::string >::iterator itMRML;
-				for(itMRML = itr1; itMRML != itr2; ++itMRML)
-				{
-					this->AddQueryResult(itMRML->second, displayTerms);
-				}
-				//std::cout<<" row result: "<<term[0]<<", "<<term[1]<<", "<<term[2]<<std::endl;
-				//this->AddQueryResult(mrmlIt->second, displayTerms);
-				//displayResult = true;
-			}
-
-
-			if(!displayResult && !DontAddToResults)
-			{
-				// check if the object term needs to be recursed. We need recursion only when we don't have
-				// display nodes attached to it
-				bool foundDisplayNode = false;
-				std::pair< std::multimap< std::string, int>::iterator,
-					          std::multimap< std::string, int > ::iterator> ret;
-				if(queryAsSubject)
-				{
-					ret =queryCacheMap.equal_range(term[2]);
-				}
-				else
-				{
-					ret = queryCacheMap.equal_range(term[1]);
-				}
-
-				std::multimap< std::string, int >::iterator itrF = ret.first;
-				std::multimap< std::string, int >::iterator itrS = ret.second;
-
-
-				if(itrF != queryCacheMap.end())
-				{
-					std::multimap<std::string, int > ::iterator itr;
-					for(itr = ret.first; itr != ret.second; ++itr)
-					{
-						std::string t = queryResultCache[(*itr).second];
-						size_t p1 = t.find(";");
-						size_t p2 = t.find_last_of(";");
-						std::string predicate = t.substr(p1+1, p2);
-						if(!foundDisplayNode)
-						{
-							foundDisplayNode = predicate == "mrmlName"; //std::strcmp(predicate.c_str(),"mrmlName") == 0;
-						}
-					}
-				}
-				if(!foundDisplayNode)
-				{
-					if(queryAsSubject)
-					{
-						recursionSubjects.push_back(term[2]);
-					}
-					else
-					{
-						recursionSubjects.push_back(term[1]);
-					}
-				}
-
-			}
-		} // end for
-	}
-
-	std::cout<<" number of recursion subjects :"<<recursionSubjects.size()<<std::endl;
-	// recursive query on the subject terms
-	for (unsigned ns = 0; ns < recursionSubjects.size(); ns++)
-	{
-		for (unsigned nrec = 0; nrec < recursionPredicates.size(); ++nrec)
-		{
-			char *sqlQuery = this->ProduceQuery(recursionSubjects[ns], false, true, recursionPredicates[nrec]);
-			RecursiveProcessQuery(sqlQuery, ptrDB, true, displayTerms);
-		}
-
-		for (unsigned nrec = 0; nrec < addRecursionPredicates.size(); ++nrec)
-		{
-			char *sqlQuery = this->ProduceQuery(recursionSubjects[ns], true, false, addRecursionPredicates[nrec]);
-			RecursiveProcessQuery(sqlQuery, ptrDB, false, displayTerms);
-		}
-
-	}
-	return 0;
-}
-
-
-//----------------------------------------------------------------------------------------------
-int vtkSlicerFacetedVisualizerLogic::ProcessSingleQuery(std::string& query, vtk_sqlite3* ptrDB,
-		std::vector< std::string > &queryResults, std::vector< std::string > &displayTerms)
-{
-
-	// first check if its a two-part query
-	size_t pos = query.find(";");
-	bool twoPartQuery = pos != std::string::npos;
-	std::string firstPart = query;
-	std::string secondPart = "";
-	std::cout<<" query is "<<query<<std::endl;
-	if(twoPartQuery)
-	{
-	  firstPart = query.substr(0, pos);
-	  secondPart = query.substr(pos+1);
-
-	}
-	else
-	{
-		//std::map< std::string, std::string > ::iterator mrmlIt = mrmlDBTerms.find(this->GetDBSubject(firstPart, ptrDB));
-		std::pair< std::multimap< std::string, std::string >::iterator,
-					          std::multimap< std::string, std::string > ::iterator > mrmlIt;
-		mrmlIt = mrmlDBTerms.equal_range(this->GetDBSubject(firstPart, ptrDB));
-		std::multimap< std::string, std::string >::iterator itr1 = mrmlIt.first;
-		std::multimap<std::string, std::string>::iterator itr2 = mrmlIt.second;
-
-		if(itr1 != mrmlDBTerms.end())
-		{
-			std::multimap<std::string, std::string>::iterator itr3;
-			for(itr3 = itr1; itr3 != itr2; ++itr3)
-			{
-				this->AddQueryResult(itr3->second, displayTerms);
-			}
-		}
-	}
-
-	if(!twoPartQuery)
-	{
-		// search the local db for non-DataBase queries (Examples: "mass", "tumor" models added to the scene by the user
-		bool found = false;
-		int indx = 0;
-		for (unsigned int l = 0; !found && l < nonDBElements.size(); l++)
-		{
-			std::string lqdb;
-			std::string lqQ;
-			this->toLower(nonDBElements[l], lqdb);
-			this->toLower(query, lqQ);
-			found = lqdb == lqQ;
-			indx = l;
-		}
-		if(found)
-		{
-			displayTerms.push_back(nonDBElements[indx]);
-			return 0;
-		}
-	}
-  if(!this->setValidDBFileName)
-  {
-    return -1;
-  }
-	// check if the query is in the cache
-	// Cache logic commented out as it is not functionality is not fully tested. HV
-//	std::pair< std::multimap< std::string, int>::iterator,
-//	          std::multimap< std::string, int > ::iterator> ret =
-//	                        queryCacheMap.equal_range(firstPart);
-//	std::multimap< std::string, int >::iterator itr = ret.first;
-//	if(itr == queryCacheMap.end())
-//	{
-//		// check if the equivalent query is present
-//		std::map< std::string, std::string > ::iterator iteq = eqQueryMap.find(firstPart);
-//		if(iteq != eqQueryMap.end())
-//		{
-//			ret = queryCacheMap.equal_range((*iteq).second);
-//		}
-//
-//	}
-
-
-	// if there is a second part to the query we need a more refined search
-	if(secondPart != "")
-	{
-		char *sqlQuery;
-//		itr = ret.first;
-//		if(itr != queryCacheMap.end())
-//		{
-//			std::cout<<" found query in cache "<<std::endl;
-//			//std::multimap<std::string, int > ::iterator itr;
-//			bool foundSecondInCache = false;
-//
-//			for(itr = ret.first; itr != ret.second; ++itr)
-//			{
-//				std::string term = queryResultCache[(*itr).second];
-//				size_t p1 = term.find(";");
-//				size_t p2 = term.find_last_of(";");
-//				std::string predicate = term.substr(p1+1, p2-1);
-//
-//				foundSecondInCache = predicate == secondPart; //(std::strcmp(predicate,secondPart) == 0);
-//				if(foundSecondInCache)
-//			    {
-//					std::cout<<" adding term to results : "<<term<<std::endl;
-//				   //this->AddQueryResult(term, queryResults);
-//				   std::string tmpstr = term.substr(p2+1);
-//				   this->AddQueryResult(tmpstr, displayTerms);
-//				}
-//			}
-//			if(!foundSecondInCache)
-//			{
-//				// we need to search for the query in the DB
-//				std::string subject = this->GetDBSubject(firstPart, ptrDB);
-//				if(subject == "null")
-//				{
-//					return -1;
-//				}
-//				sqlQuery = ProduceQuery(subject, false, true, secondPart);
-//				//std::cout<<" producing sql query with subject "<<subject<<" predicate "<<secondPart<<std::endl;
-//				//std::cout<<" sql Query is "<<sqlQuery<<std::endl;
-//				RecursiveProcessQuery(sqlQuery, ptrDB, true, displayTerms);
-//			}
-//		}
-//		else
-//		{
-			std::string subject = this->GetDBSubject(firstPart, ptrDB);
-			if(subject == "null")
-			{
-				return -1;
-			}
-			sqlQuery = ProduceQuery(subject, false, true, secondPart);
-			//std::cout<<" SQL query is "<<sqlQuery<<" with SUBJECT :"<<subject<<" and PREDICATE : "<<secondPart<<std::endl;
-			RecursiveProcessQuery(sqlQuery, ptrDB, true, displayTerms);
-//		}
-		char *errmsg;
-		char **currResult;
-		int nrows, ncols;
-		vtk_sqlite3_get_table(ptrDB, sqlQuery, &currResult, &nrows, &ncols, &errmsg);
-		if(nrows <= 0)
-		{
-			return -1;
-		}
-		std::vector< std::string > relations;
-		for (int nr = 1; nr <= nrows; ++nr)
-		{
-			std::vector< std::string> term;
-			term.resize(3);
-			for (int nc = 0; nc < ncols; ++nc)
-			{
-				term[nc] = *(currResult+(nr*ncols+nc));
-			}
-			// test if this is a ignore predicate
-			bool addToResults = true;
-
-			for (unsigned np= 0; addToResults && np < ignorePredicates.size(); ++np)
-			{
-				std::string lstr;
-				this->toLower(term[1], lstr);
-				addToResults = ignorePredicates[np] == lstr ? false : true; //std::strcmp(ignorePredicates,lstr) == 0;
-			}
-			if(addToResults)
-			{
-				// check if this is a recursion Predicate. In this case we keep the whole term for display
-				bool isRecursionPredicate = false;
-				for (unsigned c = 0; !isRecursionPredicate && c < recursionPredicates.size(); ++c)
-				{
-					isRecursionPredicate = recursionPredicates[c] == term[1] && term[1] != secondPart;
-				}
-				for (unsigned c = 0; !isRecursionPredicate && c < addRecursionPredicates.size(); ++c)
-				{
-					isRecursionPredicate = addRecursionPredicates[c] == term[1];
-				}
-				if(!isRecursionPredicate)
-				{
-					if(term[1] == secondPart)
-					{
-						std::string tmpstr = term[0]+";"+term[2];
-						this->AddQueryResult(tmpstr, queryResults);
-					}
-						// check if its a comment predicate
-					bool isCommentPredicate = false;
-					for (unsigned c = 0; !isCommentPredicate && c < commentPredicates.size(); ++c)
-					{
-						isCommentPredicate = commentPredicates[c] == term[1];
-					}
-					if(isCommentPredicate)
-					{
-						std::string tmpstr = term[0] +";comment;"+term[2];
-						this->AddQueryResult(tmpstr, queryResults);
-					}
-
-				}
-			}
-		}
-
-	}
-	else
-	{
-	   // there is no second part to the query
-	   // for display, we only need to check the recursion predicates
-	   std::string subject = this->GetDBSubject(firstPart, ptrDB);
-	   for (unsigned n = 0; n < recursionPredicates.size(); ++n)
-	   {
-		    std::string tmpstr = subject+";"+recursionPredicates[n];
-		    std::cout<<" re-process as two-part query "<<tmpstr<<std::endl;
-			ProcessSingleQuery(tmpstr, ptrDB, queryResults, displayTerms);
-	   }
-	   for (unsigned n = 0; n < addRecursionPredicates.size(); ++n)
-	   {
-		   char *sqlQuery = ProduceQuery(subject, true, false, addRecursionPredicates[n]);
-		   RecursiveProcessQuery(sqlQuery, ptrDB, false, displayTerms);
-	   }
-		// get all the predicates related to this query from the DB without recursion
-		char *sqlQuery = ProduceQuery(subject, false, true,"");
-		char *errmsg;
-		char **currResult;
-		int nrows, ncols;
-		vtk_sqlite3_get_table(ptrDB, sqlQuery, &currResult, &nrows, &ncols, &errmsg);
-		if(nrows <= 0)
-		{
-			return -1;
-		}
-		std::vector< std::string > relations;
-		for (int nr = 1; nr <= nrows; ++nr)
-		{
-			std::vector< std::string> term;
-			term.resize(3);
-			for (int nc = 0; nc < ncols; ++nc)
-			{
-				term[nc] = *(currResult+(nr*ncols+nc));
-			}
-			// test if this is a ignore predicate
-			bool addToResults = true;
-
-			for (unsigned np= 0; addToResults && np < ignorePredicates.size(); ++np)
-			{
-				std::string lstr;
-				this->toLower(term[1], lstr);
-				addToResults = ignorePredicates[np] == lstr ? false : true; //std::strcmp(ignorePredicates,lstr) == 0;
-			}
-			if(addToResults)
-			{
-				// check if this is a recursion Predicate. In this case we keep the whole term for display
-				bool isRecursionPredicate = false;
-				for (unsigned c = 0; !isRecursionPredicate && c < recursionPredicates.size(); ++c)
-				{
-					isRecursionPredicate = recursionPredicates[c] == term[1];
-				}
-				for (unsigned c = 0; !isRecursionPredicate && c < addRecursionPredicates.size(); ++c)
-				{
-					isRecursionPredicate = addRecursionPredicates[c] == term[1];
-				}
-				if(!isRecursionPredicate)
-				{
-						// check if its a comment predicate
-					bool isCommentPredicate = false;
-					for (unsigned c = 0; !isCommentPredicate && c < commentPredicates.size(); ++c)
-					{
-						isCommentPredicate = commentPredicates[c] == term[1];
-					}
-					if(isCommentPredicate)
-					{
-						std::string tmpstr = term[0] +";comment;"+term[2];
-						this->AddQueryResult(tmpstr, queryResults);
-					}
-					else
-					{
-						std::string tmpstr = term[0] + ";" + term[1];
-						this->AddQueryResult(tmpstr, relations);
-					}
-				}
-			}
-		}
-		// now construct terms using the relations and add to queryResult
-		for (unsigned r = 0; r < relations.size(); r++)
-		{
-			this->AddQueryResult(relations[r], queryResults);
-		}
-	}
-
-	std::cout<<" query "<<firstPart<<"; secondPart "<<queryResults.size()<<std::endl;
-
-	return 0;
-}
-
-//-----------------------------------------------------------------------------------------
-// Currently not used due to lack of full testing. -- HV
-int vtkSlicerFacetedVisualizerLogic::
-ManageQueryCache(std::vector< std::string > &queries, std::string query , std::vector< std::string > & queryResults)
-{
-	int spaceNeeded = queryResults.size();
-	int spaceRemaining = cacheSize - queryResultCache.size();
-	if(spaceRemaining >= spaceNeeded)
-	{
-		queryResultAge.insert(std::pair< std::string, int > (query, 0));
-		for(int n = 0; n < spaceNeeded; ++n)
-		{
-			queryResultCache.push_back(queryResults[n]);
-
-			queryCacheMap.insert(std::pair< std::string, int >(query, queryResultCache.size()-1));
-		}
-	}
-	else
-	{
-		int newSpace = 0;
-		bool queryFoundForCleanup = true;
-		std::vector< unsigned int > queryResultIndices;
-		while(newSpace < spaceNeeded && queryFoundForCleanup)
-		{
-			// need to clean up cache for the new query
-			queryFoundForCleanup = false;
-			int oldestQueryAge = 0;
-			std::string oldestQuery ="";
-			for (std::map<std::string, int > ::iterator it = queryResultAge.begin();
-					it != queryResultAge.end(); ++it)
-			{
-				if(it->second < 2)
-				{
-					continue;
-				}
-				bool found = false;
-				for (unsigned n = 0; !found && n < queries.size(); ++n)
-				{
-					if(queries[n] == it->first) // std::strcmp(queries[n],(*it).first) == 0)
-					{
-						it->second = it->second - 1;
-					}
-					else
-					{
-						if(oldestQueryAge < it->second)
-						{
-							oldestQueryAge = it->second;
-							oldestQuery = it->first;
-							queryFoundForCleanup = true;
-						}
-					}
-				}
-			}
-			if(queryFoundForCleanup)
-			{
-				// find the corresponding results for this query and create space in those indices
-				std::pair< std::multimap< std::string, int >::iterator,
-					      std::multimap< std::string, int >::iterator > r =
-					    		  queryCacheMap.equal_range(oldestQuery);
-
-				std::multimap<std::string, int > ::iterator itr = r.first;
-				if(itr != queryCacheMap.end())
-				{
-
-					//std::multimap<std::string, int > ::iterator itr;
-					for (itr = r.first; itr != r.second; ++itr)
-					{
-						queryResultIndices.push_back((*itr).second);
-					}
-					queryCacheMap.erase(r.first, r.second);
-				}
-				// cleanup
-				queryResultAge.erase(oldestQuery);
-				queryCacheMap.erase(oldestQuery);
-				newSpace = queryResultIndices.size();
-			}
-		}
-		std::vector< std::string > tempQueryResults;
-		for (unsigned int r = 0; r < queryResultCache.size(); ++r)
-		{
-			bool found = false;
-			for (unsigned j = 0; j < queryResultIndices.size(); ++j)
-			{
-				found = queryResultIndices[j] == r;
-			}
-			if(!found)
-			{
-				tempQueryResults.push_back(queryResultCache[r]);
-			}
-		}
-		queryResultCache.swap(tempQueryResults);
-		if(newSpace >= spaceNeeded)
-		{
-			queryResultAge.insert(std::pair< std::string, int > (query, 0));
-			for(int n = 0; n < spaceNeeded; ++n)
-			{
-				queryResultCache.push_back(queryResults[n]);
-
-				queryCacheMap.insert(std::pair< std::string, int >(query, queryResultCache.size()-1));
-			}
-		}
-	}
-
-	return (cacheSize - queryResultCache.size());
-
-}
-
-
-// to do: need to deal with non-DB queries such as "tumor", "mass" coming from user segmented
-// models added to the scene.
-//-----------------------------------------------------------------------------------------
-bool vtkSlicerFacetedVisualizerLogic
-::ProcessQuery()
-{
-
-	for(std::map<std::string,int>::iterator it = queryResultAge.begin();
-				it != queryResultAge.end(); ++it)
-	{
-		it->second = it->second + 1;
-	}
-
-    // construct a query for the database
-	vtk_sqlite3 *ptrDB;
-	vtk_sqlite3_open(dbFileName.c_str(), &ptrDB);
-
-	resultsForDisplay.clear();
-
-	std::vector< std::string > queries;
-
-	bool isSimpleQuery = false;
-    // first split the query if this is a complex query
-    size_t foundPos = this->query.find("+");
-    if(foundPos == std::string::npos)
-    {
-    	foundPos = this->query.find(",");
-    	isSimpleQuery = (foundPos == std::string::npos);
-    }
-    std::string qstring = query;
-    if(!isSimpleQuery)
-    {
-    	while(foundPos != std::string::npos)
-    	{
-    		std::string q = qstring.substr(0, foundPos);
-    		std::string lq;
-    		this->toLower(q, lq);
-    		this->removeLeadingFollowingSpace(lq);
-    		queries.push_back(lq);
-    		qstring = qstring.substr(foundPos+1);
-    		foundPos = qstring.find("+");
-    		if(foundPos == std::string::npos)
-    		{
-    			foundPos = qstring.find(",");
-    		}
-    		if(foundPos == std::string::npos)
-    		{
-    			this->toLower(qstring, lq);
-    			this->removeLeadingFollowingSpace(lq);
-    			queries.push_back(lq);
-    		}
-        }
-    }
-    else
-    {
-    	std::string lowerQ;
-    	this->toLower(query, lowerQ);
-    	queries.push_back(lowerQ);
-    }
-
-    // first check if we already know how to display the query
-    // If yes, lets just add a "more info" branch to the query and continue
-    // add "click more info to get more information about query" in the comment box
-
-    //std::vector< std::vector< std::string > > allqueryResults;
-    //int cacheStatus = 0;
-    std::vector< std::string > queryDisplayResults;
-
-
-	for (unsigned n = 0; n < queries.size(); n++)
-    {
-		std::vector< std::string > queryResults;
-		std::vector< std::string > cacheResults;
-		std::string q = queries[n];
-
-		size_t pos = q.find(";");
-		if(pos != std::string::npos && this->setValidDBFileName)
-		{
-			std::string firstPart = q.substr(0, pos);
-			std::string secondPart = q.substr(pos+1);
-			char *errmsg;
-			char **qResult;
-			int numrows, numcols;
-			char *squery = this->ProduceQuery(secondPart, false, true, "");
-			vtk_sqlite3_get_table(ptrDB, squery, &qResult, &numrows, &numcols, &errmsg);
-			if(numrows > 0)
-			{
-				q = secondPart;
-				queries[n] = secondPart;
-			}
-		}
-		std::vector< std::string > displayTerms;
-		int status = ProcessSingleQuery(q, ptrDB, queryResults, displayTerms);
-
-		for (unsigned i = 0; i < queryResults.size(); ++i)
-		{
-			size_t pos = queryResults[i].find(";");
-			size_t p1 = q.find(";");
-			if(p1 != std::string::npos)
-			{
-			   std::string tmpstr = q.substr(0,p1)+"-"+q.substr(p1+1)+queryResults[i].substr(pos);
-			   resultsForDisplay.push_back(tmpstr);
-			}
-			else
-			{
-			  std::string tmpstr = q+queryResults[i].substr(pos);
-			  resultsForDisplay.push_back(tmpstr);
-			}
-		}
-
-		std::cout<<" number of display terms "<<displayTerms.size()<<std::endl;
-		if(status == 0)
-		{
-			//allqueryResults.push_back(queryResults);
-
-			for (unsigned d = 0; d < displayTerms.size(); d++)
-			{
-
-			   this->AddQueryResult(displayTerms[d], queryDisplayResults);
-			   // test if query is a simple or two-part query
-			   size_t p = q.find(";");
-			   if(p == std::string::npos)
-			   {
-				   std::string tmpstr = q+";"+recursionPredicates[0]+";"+displayTerms[d];
-				   this->AddQueryResult(tmpstr, cacheResults);
-			   }
-			   else
-			   {
-				   std::string tmpstr = q+";"+displayTerms[d];
-				   this->AddQueryResult(tmpstr, cacheResults);
-			   }
-			}
-//			if(cacheStatus >= 0)
-//			{
-//			  cacheStatus = this->ManageQueryCache(queries, q, cacheResults);
-//			}
-		}
-    }
-
-	std::cout<<" query results "<<std::endl;
-	std::vector< std::vector< std::string > > qResults;
-	std::vector< std::string > allQueries;
-	this->GetQueryResults(qResults, allQueries);
-	for (unsigned n = 0; n < allQueries.size(); n++)
-	{
-		std::cout<<"-"<<allQueries[n]<<std::endl;
-
-		for (unsigned j = 0; j < qResults[n].size(); ++j)
-		{
-			std::cout<<"---"<<qResults[n][j]<<std::endl;
-		}
-
-	}
-
-	vtk_sqlite3_close(ptrDB);
-
-
-	// display the results on the scene
-	// remove old displays from the scene and add the new display
-	unsigned nmodels = this->GetMRMLScene()->GetNumberOfNodesByClass("vtkMRMLModelHierarchyNode");
-	for (unsigned n = 0; n < nmodels; n++)
-	{
-	  // get model name and check if the corresponding text exists in the database
-	  vtkMRMLModelHierarchyNode *modelNode = vtkMRMLModelHierarchyNode::SafeDownCast(
-			                                  this->GetMRMLScene()->GetNthNodeByClass(
-			                                  n, "vtkMRMLModelHierarchyNode"));
-	  vtkSmartPointer<vtkCollection> c = vtkSmartPointer<vtkCollection>::New();
-
-	  modelNode->GetChildrenModelNodes(c);
-	  for (int t = 0; t < c->GetNumberOfItems(); ++t)
-	  {
-		vtkMRMLModelNode *node = vtkMRMLModelNode::SafeDownCast(c->GetItemAsObject(t));
-		node->SetDisplayVisibility(0);
-	  }
-	}
-	// disable display of all user nodes
-	for (unsigned n = 0; n < this->nonDBElements.size(); ++n)
-	{
-		std::string name = nonDBElements[n];
-		vtkSmartPointer<vtkCollection> mnodes = vtkSmartPointer<vtkCollection>::New();
-				mnodes = this->GetMRMLScene()->GetNodesByClassByName("vtkMRMLModelNode",
-						name.c_str());
-		for(int j = 0; j < mnodes->GetNumberOfItems(); ++j)
-		{
-			vtkMRMLModelNode *node = vtkMRMLModelNode::SafeDownCast(mnodes->GetItemAsObject(j));
-			std::string nodeName = node->GetName();
-			if(name == nodeName)
-			{
-				node->SetDisplayVisibility(0);
-			}
-		}
-	}
-
-
-	for (unsigned j = 0; j < queryDisplayResults.size(); j++)
-	{
-		bool foundNode = false;
-		//std::cout<<" display result "<<resultsForDisplay[j]<<std::endl;
-		vtkSmartPointer<vtkCollection> mnodes = vtkSmartPointer<vtkCollection>::New();
-		mnodes = this->GetMRMLScene()->GetNodesByClassByName("vtkMRMLModelHierarchyNode",
-				queryDisplayResults[j].c_str());
-		foundNode = mnodes->GetNumberOfItems() > 0;
-		for(int j1 = 0; j1 < mnodes->GetNumberOfItems(); ++j1)
-		{
-			vtkMRMLModelHierarchyNode *mHNode = vtkMRMLModelHierarchyNode::SafeDownCast(mnodes->GetItemAsObject(j1));
-			vtkSmartPointer< vtkCollection > cnodes = vtkSmartPointer< vtkCollection>::New();
-			mHNode->GetChildrenModelNodes(cnodes);
-			for (int t = 0; t < cnodes->GetNumberOfItems(); ++t)
-			{
-				vtkMRMLModelNode *node = vtkMRMLModelNode::SafeDownCast(cnodes->GetItemAsObject(t));
-				node->SetDisplayVisibility(1);
-			}
-		}
-		if(!foundNode)
-		{
-			vtkSmartPointer< vtkCollection> nodes = vtkSmartPointer<vtkCollection>::New();
-			nodes = this->GetMRMLScene()->GetNodesByClassByName("vtkMRMLModelNode",
-					queryDisplayResults[j].c_str());
-			for (int j1 = 0; j1 < nodes->GetNumberOfItems(); ++j1)
-			{
-				vtkMRMLModelNode *node = vtkMRMLModelNode::SafeDownCast(nodes->GetItemAsObject(j1));
-				node->SetDisplayVisibility(1);
-			}
-		}
-	}
-
-	return queryDisplayResults.size() > 0 ? true : false;
-
-
-}
-
-
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// FacetedVisualizer includes
+#include "vtkSlicerFacetedVisualizerLogic.h"
+#include "vtkFacetedVisualizerLog.h"
+#include "vtkFacetedVisualizerPersistentCache.h"
+#include "vtkFacetedVisualizerQueryPlan.h"
+#include "vtkFacetedVisualizerResultCache.h"
+#include "vtkFacetedVisualizerTermCompleter.h"
+#include "vtkFacetedVisualizerTokenIndex.h"
+#include "vtkFacetedVisualizerTripleStore.h"
+
+// MRML includes
+#include "vtkMRMLScene.h"
+#include "vtkMRMLScalarVolumeNode.h"
+#include "vtkMRMLModelHierarchyNode.h"
+#include "vtkMRMLModelDisplayNode.h"
+#include "vtkMRMLModelNode.h"
+#include "vtkCollection.h"
+
+// VTK includes
+#include <vtkCommand.h>
+#include <vtkIntArray.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
+#include <vtkNew.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <cassert>
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <utility>
+#include <string>
+#include <cctype>
+
+
+#include "vtk_sqlite3.h"
+
+#include <vtksys/SystemTools.hxx>
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerFacetedVisualizerLogic);
+
+// fewer models are not worth a thread of their own when synchronizing the atlas
+static const size_t MinimumModelsPerSyncThread = 16;
+
+// levels of the hierarchy below a query term the cost estimate of the term counts
+static const int MaximumEstimatedDepth = 8;
+
+// SQL of the lookup statements, indexed by shape (see GetLookupStatement)
+static const char* LookupSQL[6] = {
+	"SELECT subject, predicate, object from resources where subject = ?1 or object = ?1",
+	"SELECT subject, predicate, object from resources where (subject = ?1 or object = ?1) and predicate = ?2",
+	"SELECT subject, predicate, object from resources where object = ?1",
+	"SELECT subject, predicate, object from resources where object = ?1 and predicate = ?2",
+	"SELECT subject, predicate, object from resources where subject = ?1",
+	"SELECT subject, predicate, object from resources where subject = ?1 and predicate = ?2"
+};
+
+//------------------------------------------------------------------------------------
+// Charges the time since the last change of category to the current one, so that every
+// second of a profiled query lands in exactly one category. Does nothing when profiling
+// is off.
+class vtkSlicerFacetedVisualizerLogic::QueryProfileTimer
+{
+public:
+	QueryProfileTimer(vtkSlicerFacetedVisualizerLogic *logic, double *category)
+	{
+		this->Logic = logic->queryProfiling ? logic : NULL;
+		if(this->Logic != NULL)
+		{
+			this->Previous = logic->profileCategory;
+			this->Switch(category);
+		}
+	}
+
+	~QueryProfileTimer()
+	{
+		if(this->Logic != NULL)
+		{
+			this->Switch(this->Previous);
+		}
+	}
+
+private:
+	void Switch(double *category)
+	{
+		double now = vtkTimerLog::GetUniversalTime();
+		if(this->Logic->profileCategory != NULL)
+		{
+			*this->Logic->profileCategory += now - this->Logic->profileMark;
+		}
+		this->Logic->profileCategory = category;
+		this->Logic->profileMark = now;
+	}
+
+	vtkSlicerFacetedVisualizerLogic *Logic;
+	double *Previous;
+};
+
+//----------------------------------------------------------------------------
+vtkSlicerFacetedVisualizerLogic::vtkSlicerFacetedVisualizerLogic()
+{
+
+  setValidDBFileName = false;
+	// filter predicates for continuing recursive queries to DB
+	recursionPredicates.push_back("regional_part");
+	recursionPredicates.push_back("consitutional_part");
+	recursionPredicates.push_back("systemic_part");
+	recursionPredicates.push_back("member");
+	recursionPredicates.push_back("subClass");
+
+	addRecursionPredicates.push_back("regional_part_of");
+	addRecursionPredicates.push_back("constitutional_part_of");
+	addRecursionPredicates.push_back("systemic_part_of");
+	addRecursionPredicates.push_back("memberOf");
+	addRecursionPredicates.push_back("subClassOf");
+
+	// filter predicates to ignore from adding to results
+	ignorePredicates.push_back("label");
+	ignorePredicates.push_back("fmaid");
+	// these are required only for a specific DB that Harini had to modify to work with the
+	// earlier implementation of Faceted Search Atlas
+	ignorePredicates.push_back("assocmrmlnode");
+	ignorePredicates.push_back("assocematlaslabel");
+	ignorePredicates.push_back("hasematlasname");
+
+	commentPredicates.push_back("comment");
+	commentPredicates.push_back("definition");
+
+
+	resultCache = vtkFacetedVisualizerResultCache::New();
+	persistentCache = vtkFacetedVisualizerPersistentCache::New();
+	usePersistentCache = true;
+	persistentCacheOpened = false;
+
+	termDictionaryComplete = false;
+	termDictionaryMaximumSize = 1000000;
+	unknownTermsMaximumSize = 10000;
+	queryPlansMaximumSize = 1000;
+	numberOfDBRows = 0;
+	numberOfDBSubjects = 0;
+
+	for (unsigned int n = 0; n < 6; ++n)
+	{
+		lookupStatements[n] = NULL;
+	}
+	lookupStatementsDB = NULL;
+	frontierInsertStatement = NULL;
+	frontierExpandStatement = NULL;
+	closureStatements[0] = NULL;
+	closureStatements[1] = NULL;
+	closureStatementsFailed[0] = false;
+	closureStatementsFailed[1] = false;
+	closureTableStatement = NULL;
+	closureTableAvailable = false;
+
+	dbSession = NULL;
+	dbSessionModifiedTime = 0;
+	dbCacheSize = -1;
+	dbMMapSize = -1;
+
+	indexProvisioningMode = IndexSidecar;
+	traversalMode = TraversalPerTerm;
+
+	tripleStore = vtkFacetedVisualizerTripleStore::New();
+	useInMemoryStore = false;
+	inMemoryStoreFailed = false;
+
+	tokenIndex = vtkFacetedVisualizerTokenIndex::New();
+	termCompleter = vtkFacetedVisualizerTermCompleter::New();
+
+	numberOfSyncThreads = 0;
+
+	applyingQueryDisplay = false;
+
+	atlasSynchronized = false;
+	sceneFingerprintModified = false;
+
+	queryThreader = vtkMultiThreader::New();
+	queryLock = vtkMutexLock::New();
+	queryThreadId = -1;
+	queryCancelled = false;
+	queryDone = false;
+	queryProgress = 0.0;
+	queryDB = NULL;
+
+	queryProfiling = false;
+	profileCategory = NULL;
+	profileMark = 0.0;
+
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerFacetedVisualizerLogic::~vtkSlicerFacetedVisualizerLogic()
+{
+	this->CancelQuery();
+	this->queryThreader->Delete();
+	this->queryLock->Delete();
+	this->CloseDBSession();
+	this->tripleStore->Delete();
+	this->tokenIndex->Delete();
+	this->termCompleter->Delete();
+	this->resultCache->Delete();
+	this->persistentCache->Delete();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "DBFileName: " << this->dbFileName << "\n";
+  os << indent << "DBSessionFileName: " << this->dbSessionFileName << "\n";
+  os << indent << "DBCacheSize: " << this->dbCacheSize << "\n";
+  os << indent << "DBMMapSize: " << this->dbMMapSize << "\n";
+  os << indent << "IndexProvisioningMode: " << this->indexProvisioningMode << "\n";
+  os << indent << "TraversalMode: " << this->traversalMode << "\n";
+  os << indent << "UseInMemoryStore: " << this->useInMemoryStore << "\n";
+  os << indent << "InMemoryStoreInUse: " << this->GetInMemoryStoreInUse() << "\n";
+  os << indent << "ClosureTableAvailable: " << this->closureTableAvailable << "\n";
+  os << indent << "UsePersistentCache: " << this->usePersistentCache << "\n";
+  os << indent << "TermDictionaryMaximumSize: " << this->termDictionaryMaximumSize << "\n";
+  os << indent << "TermDictionaryComplete: " << this->termDictionaryComplete << "\n";
+  os << indent << "UnknownTermsMaximumSize: " << this->unknownTermsMaximumSize << "\n";
+  os << indent << "QueryPlansMaximumSize: " << this->queryPlansMaximumSize << "\n";
+  os << indent << "NumberOfSyncThreads: " << this->numberOfSyncThreads << "\n";
+  os << indent << "QueryProfiling: " << this->queryProfiling << "\n";
+  os << indent << "Query: " << this->query << "\n";
+  os << indent << "ResultCache:\n";
+  this->resultCache->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "PersistentCache:\n";
+  this->persistentCache->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "TripleStore:\n";
+  this->tripleStore->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "TokenIndex:\n";
+  this->tokenIndex->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "TermCompleter:\n";
+  this->termCompleter->PrintSelf(os, indent.GetNextIndent());
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::SetMRMLSceneInternal(vtkMRMLScene * newScene)
+{
+  vtkNew<vtkIntArray> events;
+  events->InsertNextValue(vtkMRMLScene::NodeAddedEvent);
+  events->InsertNextValue(vtkMRMLScene::NodeRemovedEvent);
+  events->InsertNextValue(vtkMRMLScene::EndBatchProcessEvent);
+  this->SetAndObserveMRMLSceneEventsInternal(newScene, events.GetPointer());
+  this->RebuildSceneNodeIndex();
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::RegisterNodes()
+{
+  assert(this->GetMRMLScene() != 0);
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::UpdateFromMRMLScene()
+{
+  assert(this->GetMRMLScene() != 0);
+  this->RebuildSceneNodeIndex();
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic
+::OnMRMLSceneNodeAdded(vtkMRMLNode* node)
+{
+  this->AddToSceneNodeIndex(node);
+  if(this->atlasSynchronized &&
+     (vtkMRMLModelHierarchyNode::SafeDownCast(node) != NULL || vtkMRMLModelNode::SafeDownCast(node) != NULL))
+  {
+    // the model and the children of a hierarchy node are set after it is added
+    this->pendingSyncNodeIDs.push_back(node->GetID());
+  }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic
+::OnMRMLSceneNodeRemoved(vtkMRMLNode* node)
+{
+  this->RemoveFromSceneNodeIndex(node);
+  if(this->atlasSynchronized &&
+     (vtkMRMLModelHierarchyNode::SafeDownCast(node) != NULL || vtkMRMLModelNode::SafeDownCast(node) != NULL))
+  {
+    this->CancelQuery();
+    this->SyncRemovedNode(node);
+    this->FinishIncrementalSync();
+  }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::OnMRMLSceneEndBatchProcess()
+{
+  // the batch of ApplyQueryDisplay only changes the visibility of nodes
+  if(this->applyingQueryDisplay)
+  {
+    return;
+  }
+  this->hierarchyChildModelNodes.clear();
+  this->SyncPendingNodes();
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic
+::ProcessMRMLNodesEvents(vtkObject* caller, unsigned long event, void* callData)
+{
+	vtkMRMLNode *node = vtkMRMLNode::SafeDownCast(caller);
+	std::map< vtkMRMLNode*, std::string >::iterator it = this->sceneNodeNames.find(node);
+	if(event != vtkCommand::ModifiedEvent || it == this->sceneNodeNames.end())
+	{
+		this->Superclass::ProcessMRMLNodesEvents(caller, event, callData);
+		return;
+	}
+	vtkMRMLModelHierarchyNode *hierarchyNode = vtkMRMLModelHierarchyNode::SafeDownCast(node);
+	std::string name = node->GetName() != NULL ? node->GetName() : "";
+	if(hierarchyNode != NULL)
+	{
+		// most modifications (expanded state, attributes, ...) do not affect the matching
+		vtksys::hash_map< std::string, SyncedHierarchyNode >::iterator synced =
+				this->syncedHierarchyNodes.find(node->GetID());
+		SyncedHierarchyNode current;
+		this->GetSyncedState(hierarchyNode, current);
+		bool changed = synced == this->syncedHierarchyNodes.end() ||
+				current.Name != synced->second.Name ||
+				current.ParentNodeID != synced->second.ParentNodeID ||
+				current.AssociatedNodeID != synced->second.AssociatedNodeID;
+		if(changed)
+		{
+			// the parent or the associated model node may have changed
+			this->hierarchyChildModelNodes.clear();
+		}
+		if(changed && !this->applyingQueryDisplay && synced != this->syncedHierarchyNodes.end())
+		{
+			// matched under its old name and models, match it again before the next query
+			this->CancelQuery();
+			this->SyncRemovedNode(node);
+			this->pendingSyncNodeIDs.push_back(node->GetID());
+			this->FinishIncrementalSync();
+		}
+	}
+	if(name == it->second)
+	{
+		return;
+	}
+	if(hierarchyNode != NULL)
+	{
+		std::vector< vtkMRMLModelHierarchyNode* > &named = this->hierarchyNodesByName[it->second];
+		named.erase(std::find(named.begin(), named.end(), hierarchyNode));
+		this->hierarchyNodesByName[name].push_back(hierarchyNode);
+	}
+	else
+	{
+		vtkMRMLModelNode *modelNode = vtkMRMLModelNode::SafeDownCast(node);
+		std::vector< vtkMRMLModelNode* > &named = this->modelNodesByName[it->second];
+		named.erase(std::find(named.begin(), named.end(), modelNode));
+		this->modelNodesByName[name].push_back(modelNode);
+	}
+	std::string previousName = it->second;
+	it->second = name;
+	if(hierarchyNode == NULL && this->atlasSynchronized && !this->applyingQueryDisplay)
+	{
+		// non-DB elements are model names
+		this->CancelQuery();
+		this->UpdateNonDBElement(previousName);
+		this->UpdateNonDBElement(name);
+		this->FinishIncrementalSync();
+	}
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::RebuildSceneNodeIndex()
+{
+	for (std::map< vtkMRMLNode*, std::string >::iterator it = this->sceneNodeNames.begin();
+			it != this->sceneNodeNames.end(); ++it)
+	{
+		this->GetMRMLNodesObserverManager()->RemoveObjectEvents(it->first);
+	}
+	this->sceneNodeNames.clear();
+	this->sceneHierarchyNodes.clear();
+	this->sceneModelNodes.clear();
+	this->hierarchyNodesByName.clear();
+	this->modelNodesByName.clear();
+	this->hierarchyChildModelNodes.clear();
+	vtkMRMLScene *scene = this->GetMRMLScene();
+	if(scene == NULL)
+	{
+		return;
+	}
+	unsigned int nhierarchyNodes = scene->GetNumberOfNodesByClass("vtkMRMLModelHierarchyNode");
+	for (unsigned int n = 0; n < nhierarchyNodes; ++n)
+	{
+		this->AddToSceneNodeIndex(scene->GetNthNodeByClass(n, "vtkMRMLModelHierarchyNode"));
+	}
+	unsigned int nmodelNodes = scene->GetNumberOfNodesByClass("vtkMRMLModelNode");
+	for (unsigned int n = 0; n < nmodelNodes; ++n)
+	{
+		this->AddToSceneNodeIndex(scene->GetNthNodeByClass(n, "vtkMRMLModelNode"));
+	}
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::AddToSceneNodeIndex(vtkMRMLNode* node)
+{
+	vtkMRMLModelHierarchyNode *hierarchyNode = vtkMRMLModelHierarchyNode::SafeDownCast(node);
+	vtkMRMLModelNode *modelNode = vtkMRMLModelNode::SafeDownCast(node);
+	if(hierarchyNode == NULL && modelNode == NULL)
+	{
+		return;
+	}
+	// any new node can be a child of a hierarchy node
+	this->hierarchyChildModelNodes.clear();
+	std::string name = node->GetName() != NULL ? node->GetName() : "";
+	if(!this->sceneNodeNames.insert(std::make_pair(node, name)).second)
+	{
+		return;
+	}
+	vtkNew<vtkIntArray> events;
+	events->InsertNextValue(vtkCommand::ModifiedEvent);
+	this->GetMRMLNodesObserverManager()->AddObjectEvents(node, events.GetPointer());
+	if(hierarchyNode != NULL)
+	{
+		this->sceneHierarchyNodes.push_back(hierarchyNode);
+		this->hierarchyNodesByName[name].push_back(hierarchyNode);
+	}
+	else
+	{
+		this->sceneModelNodes.push_back(modelNode);
+		this->modelNodesByName[name].push_back(modelNode);
+	}
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::RemoveFromSceneNodeIndex(vtkMRMLNode* node)
+{
+	vtkMRMLModelHierarchyNode *hierarchyNode = vtkMRMLModelHierarchyNode::SafeDownCast(node);
+	vtkMRMLModelNode *modelNode = vtkMRMLModelNode::SafeDownCast(node);
+	if(hierarchyNode == NULL && modelNode == NULL)
+	{
+		return;
+	}
+	this->hierarchyChildModelNodes.clear();
+	std::map< vtkMRMLNode*, std::string >::iterator indexed = this->sceneNodeNames.find(node);
+	if(indexed == this->sceneNodeNames.end())
+	{
+		return;
+	}
+	// the name it was indexed under, renames are followed from its modified events
+	const std::string &name = indexed->second;
+	if(hierarchyNode != NULL)
+	{
+		std::vector< vtkMRMLModelHierarchyNode* > &named = this->hierarchyNodesByName[name];
+		named.erase(std::find(named.begin(), named.end(), hierarchyNode));
+		this->sceneHierarchyNodes.erase(std::find(this->sceneHierarchyNodes.begin(),
+				this->sceneHierarchyNodes.end(), hierarchyNode));
+	}
+	else
+	{
+		std::vector< vtkMRMLModelNode* > &named = this->modelNodesByName[name];
+		named.erase(std::find(named.begin(), named.end(), modelNode));
+		this->sceneModelNodes.erase(std::find(this->sceneModelNodes.begin(),
+				this->sceneModelNodes.end(), modelNode));
+	}
+	this->sceneNodeNames.erase(indexed);
+	this->GetMRMLNodesObserverManager()->RemoveObjectEvents(node);
+}
+
+//---------------------------------------------------------------------------
+const std::vector< vtkMRMLModelHierarchyNode* >& vtkSlicerFacetedVisualizerLogic
+::GetHierarchyNodesByName(const std::string& name)
+{
+	static const std::vector< vtkMRMLModelHierarchyNode* > none;
+	vtksys::hash_map< std::string, std::vector< vtkMRMLModelHierarchyNode* > >::iterator it =
+			this->hierarchyNodesByName.find(name);
+	return it != this->hierarchyNodesByName.end() ? it->second : none;
+}
+
+//---------------------------------------------------------------------------
+const std::vector< vtkMRMLModelNode* >& vtkSlicerFacetedVisualizerLogic
+::GetModelNodesByName(const std::string& name)
+{
+	static const std::vector< vtkMRMLModelNode* > none;
+	vtksys::hash_map< std::string, std::vector< vtkMRMLModelNode* > >::iterator it =
+			this->modelNodesByName.find(name);
+	return it != this->modelNodesByName.end() ? it->second : none;
+}
+
+//---------------------------------------------------------------------------
+const std::vector< vtkMRMLModelNode* >& vtkSlicerFacetedVisualizerLogic
+::GetChildModelNodes(vtkMRMLModelHierarchyNode* node)
+{
+	std::string nodeID = node->GetID() != NULL ? node->GetID() : "";
+	vtksys::hash_map< std::string, std::vector< vtkMRMLModelNode* > >::iterator it =
+			this->hierarchyChildModelNodes.find(nodeID);
+	if(it != this->hierarchyChildModelNodes.end())
+	{
+		return it->second;
+	}
+	std::vector< vtkMRMLModelNode* > &children = this->hierarchyChildModelNodes[nodeID];
+	vtkSmartPointer<vtkCollection> c = vtkSmartPointer<vtkCollection>::New();
+	node->GetChildrenModelNodes(c);
+	for (int t = 0; t < c->GetNumberOfItems(); ++t)
+	{
+		vtkMRMLModelNode *child = vtkMRMLModelNode::SafeDownCast(c->GetItemAsObject(t));
+		if(child != NULL)
+		{
+			children.push_back(child);
+		}
+	}
+	return children;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::SetDBFileName(std::string fname)
+{
+	this->CancelQuery();
+	if(fname == this->dbFileName && this->dbSession != NULL)
+	{
+		// same file: keep the session unless the file changed on disk
+		this->setValidDBFileName = this->GetDBSession() != NULL;
+		return;
+	}
+	this->CloseDBSession();
+	this->dbFileName = fname;
+	this->setValidDBFileName = this->OpenDBSession();
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::SetCorrespondingDBTermforMRMLNode(std::string DBAtom,
+		std::string mrmlNode)
+{
+	this->CancelQuery();
+	mrmlDBTerms.insert(std::pair< std::string, std::string> (DBAtom, mrmlNode));
+	this->resultCache->Clear();
+	this->sceneFingerprintModified = true;
+}
+
+//---------------------------------------------------------------------------
+// Called on every keystroke. The terms are read on the open session as is, GetDBSession
+// may reopen it, and not while a query thread uses it.
+void vtkSlicerFacetedVisualizerLogic::GetQueryTermCompletions(const std::string &prefix,
+		unsigned int maximumCompletions, std::vector< std::string > &completions)
+{
+	if(!this->termCompleter->IsBuilt())
+	{
+		if(this->dbSession == NULL || this->queryThreadId >= 0 ||
+		   !this->termCompleter->Build(this->dbSession))
+		{
+			return;
+		}
+		vtkFacetedVisualizerInfoMacro(" term completer: "<<this->termCompleter->GetNumberOfTerms()<<" terms");
+	}
+	this->termCompleter->Complete(prefix, maximumCompletions, completions);
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::SetUsePersistentCache(bool use)
+{
+	this->CancelQuery();
+	this->usePersistentCache = use;
+	if(!use)
+	{
+		this->persistentCache->Close();
+		this->persistentCacheOpened = false;
+	}
+}
+
+//---------------------------------------------------------------------------
+// The results file is opened on the first query of a session, fingerprinting the DB is
+// not worth delaying SetDBFileName for
+vtkFacetedVisualizerPersistentCache* vtkSlicerFacetedVisualizerLogic::GetPersistentCache()
+{
+	if(!this->usePersistentCache || this->dbSession == NULL)
+	{
+		return NULL;
+	}
+	if(this->sceneFingerprintModified)
+	{
+		this->UpdateSceneFingerprint();
+	}
+	if(!this->persistentCacheOpened)
+	{
+		this->persistentCacheOpened = true;
+		std::string fingerprint =
+				vtkFacetedVisualizerPersistentCache::ComputeFileFingerprint(this->dbFileName);
+		if(fingerprint != "")
+		{
+			this->persistentCache->Open(this->dbFileName + ".results.sqlite3", fingerprint);
+			this->persistentCache->SetSceneFingerprint(this->sceneFingerprint);
+		}
+	}
+	return this->persistentCache->IsOpen() ? this->persistentCache : NULL;
+}
+
+//---------------------------------------------------------------------------
+// Fingerprint of what query results depend on besides the DB: which models are
+// displayed for which DB terms and which models are not in the DB
+void vtkSlicerFacetedVisualizerLogic::UpdateSceneFingerprint()
+{
+	std::vector< std::string > entries;
+	std::multimap< std::string, std::string >::iterator it;
+	for (it = this->mrmlDBTerms.begin(); it != this->mrmlDBTerms.end(); ++it)
+	{
+		entries.push_back(it->first + "\t" + it->second);
+	}
+	for (unsigned int n = 0; n < this->nonDBElements.GetNumberOfValues(); ++n)
+	{
+		entries.push_back("\t" + this->nonDBElements.GetValue(n));
+	}
+	std::sort(entries.begin(), entries.end());
+	this->sceneFingerprint = vtkFacetedVisualizerPersistentCache::ComputeFingerprint(entries);
+	this->persistentCache->SetSceneFingerprint(this->sceneFingerprint);
+	this->sceneFingerprintModified = false;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::SetDBCacheSize(int pages)
+{
+	this->CancelQuery();
+	this->dbCacheSize = pages;
+	this->ApplyDBSessionSettings();
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::SetDBMMapSize(int megabytes)
+{
+	this->CancelQuery();
+	this->dbMMapSize = megabytes;
+	this->ApplyDBSessionSettings();
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::SetUseInMemoryStore(bool use)
+{
+	this->CancelQuery();
+	this->useInMemoryStore = use;
+	this->inMemoryStoreFailed = false;
+	if(!use)
+	{
+		this->tripleStore->Clear();
+	}
+}
+
+//---------------------------------------------------------------------------
+bool vtkSlicerFacetedVisualizerLogic::OpenDBSession()
+{
+	this->CloseDBSession();
+	if(this->dbFileName == "" || !vtksys::SystemTools::FileExists(this->dbFileName.c_str()))
+	{
+		return false;
+	}
+
+	int status = vtk_sqlite3_open_v2(this->dbFileName.c_str(), &this->dbSession,
+			VTK_SQLITE_OPEN_READWRITE, NULL);
+	if(status != VTK_SQLITE_OK)
+	{
+		vtkErrorMacro("Could not open ontology DB " << this->dbFileName << ": "
+				<< (this->dbSession ? vtk_sqlite3_errmsg(this->dbSession) : ""));
+		if(this->dbSession != NULL)
+		{
+			vtk_sqlite3_close(this->dbSession);
+			this->dbSession = NULL;
+		}
+		return false;
+	}
+	this->dbSessionModifiedTime = vtksys::SystemTools::ModifiedTime(this->dbFileName.c_str());
+	this->dbSessionFileName = this->dbFileName;
+	this->resultCache->Clear();
+	this->persistentCache->Close();
+	this->persistentCacheOpened = false;
+	this->ProvisionIndexes();
+	this->ApplyDBSessionSettings();
+	this->ValidateAccessPaths();
+	bool closureTableStale = false;
+	this->closureTableAvailable = this->HasClosureTable(this->dbSession, closureTableStale);
+	if(closureTableStale)
+	{
+		vtkWarningMacro("The closure table of " << this->dbSessionFileName << " is out of date and"
+				<< " not used, call BuildClosureTable to build it again.");
+	}
+	this->LoadTermDictionary(this->dbSession);
+	this->LoadPredicateStatistics(this->dbSession);
+	return true;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::CloseDBSession()
+{
+	if(this->dbSession == NULL)
+	{
+		return;
+	}
+	// all statements have to be finalized before the connection can be closed
+	this->FinalizeLookupStatements();
+	this->tripleStore->Clear();
+	this->inMemoryStoreFailed = false;
+	this->tokenIndex->Clear();
+	this->termCompleter->Clear();
+	this->resultCache->Clear();
+	this->persistentCache->Close();
+	this->persistentCacheOpened = false;
+	this->ClearTermDictionary();
+	this->predicateRows.clear();
+	this->numberOfDBRows = 0;
+	this->numberOfDBSubjects = 0;
+	vtk_sqlite3_close(this->dbSession);
+	this->dbSession = NULL;
+	this->dbSessionModifiedTime = 0;
+	this->dbSessionFileName = "";
+	this->unindexedAccessPaths.clear();
+	this->closureTableAvailable = false;
+}
+
+//---------------------------------------------------------------------------
+vtk_sqlite3* vtkSlicerFacetedVisualizerLogic::GetDBSession()
+{
+	if(this->dbSession != NULL &&
+	   vtksys::SystemTools::ModifiedTime(this->dbFileName.c_str()) != this->dbSessionModifiedTime)
+	{
+		// the file was replaced or modified by another process
+		this->OpenDBSession();
+	}
+	else if(this->dbSession == NULL && this->setValidDBFileName)
+	{
+		this->OpenDBSession();
+	}
+	return this->dbSession;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::ApplyDBSessionSettings()
+{
+	if(this->dbSession == NULL)
+	{
+		return;
+	}
+	if(this->dbCacheSize >= 0)
+	{
+		char *pragma = vtk_sqlite3_mprintf("PRAGMA cache_size = %d", this->dbCacheSize);
+		vtk_sqlite3_exec(this->dbSession, pragma, NULL, NULL, NULL);
+		vtk_sqlite3_free(pragma);
+	}
+	if(this->dbMMapSize >= 0)
+	{
+		// unknown pragmas are a no-op in sqlite, so this is safe on versions without mmap
+		char *pragma = vtk_sqlite3_mprintf("PRAGMA mmap_size = %lld",
+				static_cast< vtk_sqlite3_int64 >(this->dbMMapSize) * 1024 * 1024);
+		vtk_sqlite3_exec(this->dbSession, pragma, NULL, NULL, NULL);
+		vtk_sqlite3_free(pragma);
+	}
+}
+
+//---------------------------------------------------------------------------
+bool vtkSlicerFacetedVisualizerLogic::HasCoveringIndexes(vtk_sqlite3* ptrDB)
+{
+	char *errmsg;
+	char **indexes;
+	int nindexes, ncols;
+	if(vtk_sqlite3_get_table(ptrDB, "PRAGMA index_list(resources)", &indexes, &nindexes, &ncols, &errmsg)
+			!= VTK_SQLITE_OK)
+	{
+		vtk_sqlite3_free(errmsg);
+		return false;
+	}
+
+	// the index name is the second column of index_list and the column name the third of index_info
+	bool foundSubjectIndex = false;
+	bool foundObjectIndex = false;
+	for (int n = 1; n <= nindexes; ++n)
+	{
+		char *sql = vtk_sqlite3_mprintf("PRAGMA index_info('%q')", indexes[n*ncols+1]);
+		char **columns;
+		int ncolumns, ninfo;
+		if(vtk_sqlite3_get_table(ptrDB, sql, &columns, &ncolumns, &ninfo, &errmsg) == VTK_SQLITE_OK)
+		{
+			std::string key;
+			for (int c = 1; c <= ncolumns; ++c)
+			{
+				key += std::string(columns[c*ninfo+2]) + ",";
+			}
+			foundSubjectIndex = foundSubjectIndex || key == "subject,predicate,object,";
+			foundObjectIndex = foundObjectIndex || key == "object,predicate,subject,";
+			vtk_sqlite3_free_table(columns);
+		}
+		else
+		{
+			vtk_sqlite3_free(errmsg);
+		}
+		vtk_sqlite3_free(sql);
+	}
+	vtk_sqlite3_free_table(indexes);
+	return foundSubjectIndex && foundObjectIndex;
+}
+
+//---------------------------------------------------------------------------
+bool vtkSlicerFacetedVisualizerLogic::CreateCoveringIndexes(vtk_sqlite3* ptrDB)
+{
+	char *errmsg;
+	int status = vtk_sqlite3_exec(ptrDB,
+			"CREATE INDEX IF NOT EXISTS fv_resources_spo ON resources(subject, predicate, object);"
+			"CREATE INDEX IF NOT EXISTS fv_resources_ops ON resources(object, predicate, subject);"
+			"ANALYZE resources;",
+			NULL, NULL, &errmsg);
+	if(status != VTK_SQLITE_OK)
+	{
+		vtkWarningMacro("Could not create indexes on the resources table: " << errmsg);
+		vtk_sqlite3_free(errmsg);
+		return false;
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::ProvisionIndexes()
+{
+	if(this->indexProvisioningMode == IndexReportOnly || this->HasCoveringIndexes(this->dbSession))
+	{
+		return;
+	}
+
+	if(this->indexProvisioningMode == IndexInPlace)
+	{
+		vtkFacetedVisualizerInfoMacro(" Creating indexes in "<<this->dbFileName<<" (one time only).. ");
+		if(this->CreateCoveringIndexes(this->dbSession))
+		{
+			// our own change must not trigger a reopen of the session
+			this->dbSessionModifiedTime = vtksys::SystemTools::ModifiedTime(this->dbFileName.c_str());
+		}
+		return;
+	}
+
+	std::string sidecarFileName = this->dbFileName + ".indexed.sqlite3";
+	vtk_sqlite3 *indexedDB = this->OpenIndexSidecar(sidecarFileName);
+	if(indexedDB != NULL)
+	{
+		this->FinalizeLookupStatements();
+		vtk_sqlite3_close(this->dbSession);
+		this->dbSession = indexedDB;
+		this->dbSessionFileName = sidecarFileName;
+	}
+}
+
+//---------------------------------------------------------------------------
+// Opens the indexed copy of the resources table next to the DB file, (re)building it if it
+// is missing or was made from a different version of the file
+vtk_sqlite3* vtkSlicerFacetedVisualizerLogic::OpenIndexSidecar(const std::string& sidecarFileName)
+{
+	long int sourceTime = vtksys::SystemTools::ModifiedTime(this->dbFileName.c_str());
+	unsigned long sourceSize = vtksys::SystemTools::FileLength(this->dbFileName.c_str());
+
+	vtk_sqlite3 *sidecar = NULL;
+	char *errmsg;
+	if(vtksys::SystemTools::FileExists(sidecarFileName.c_str()))
+	{
+		bool upToDate = false;
+		bool hasClosureTable = false;
+		if(vtk_sqlite3_open_v2(sidecarFileName.c_str(), &sidecar, VTK_SQLITE_OPEN_READWRITE, NULL)
+				== VTK_SQLITE_OK)
+		{
+			hasClosureTable = vtk_sqlite3_exec(sidecar, "SELECT 1 from fv_closure_info",
+					NULL, NULL, NULL) == VTK_SQLITE_OK;
+			char **info;
+			int nrows, ncols;
+			if(vtk_sqlite3_get_table(sidecar, "SELECT source_mtime, source_size from fv_sidecar_info",
+					&info, &nrows, &ncols, &errmsg) == VTK_SQLITE_OK)
+			{
+				upToDate = nrows == 1 &&
+						atol(info[ncols+0]) == sourceTime &&
+						strtoul(info[ncols+1], NULL, 10) == sourceSize &&
+						this->HasCoveringIndexes(sidecar);
+				vtk_sqlite3_free_table(info);
+			}
+			else
+			{
+				vtk_sqlite3_free(errmsg);
+			}
+		}
+		if(upToDate)
+		{
+			return sidecar;
+		}
+		if(hasClosureTable)
+		{
+			vtkWarningMacro("The closure table of " << sidecarFileName << " is out of date and"
+					<< " dropped with the indexed copy, call BuildClosureTable to build it again.");
+		}
+		vtk_sqlite3_close(sidecar);
+		sidecar = NULL;
+		vtksys::SystemTools::RemoveFile(sidecarFileName.c_str());
+	}
+
+	vtkFacetedVisualizerInfoMacro(" Building indexed copy of the ontology in "<<sidecarFileName<<" (one time only).. ");
+	if(vtk_sqlite3_open_v2(sidecarFileName.c_str(), &sidecar,
+			VTK_SQLITE_OPEN_READWRITE | VTK_SQLITE_OPEN_CREATE, NULL) != VTK_SQLITE_OK)
+	{
+		vtkWarningMacro("Could not create index sidecar " << sidecarFileName
+				<< ", queries on this DB will scan the resources table");
+		vtk_sqlite3_close(sidecar);
+		return NULL;
+	}
+
+	// ATTACH cannot run inside a transaction, the copy itself is done in one
+	char *attach = vtk_sqlite3_mprintf("ATTACH DATABASE '%q' AS source", this->dbFileName.c_str());
+	char *info = vtk_sqlite3_mprintf("INSERT INTO fv_sidecar_info VALUES(%ld, %lu)", sourceTime, sourceSize);
+	int status = vtk_sqlite3_exec(sidecar, attach, NULL, NULL, &errmsg);
+	if(status == VTK_SQLITE_OK)
+	{
+		status = vtk_sqlite3_exec(sidecar,
+				"BEGIN;"
+				"CREATE TABLE resources AS SELECT subject, predicate, object from source.resources;"
+				"CREATE TABLE fv_sidecar_info(source_mtime INTEGER, source_size INTEGER);",
+				NULL, NULL, &errmsg);
+	}
+	if(status == VTK_SQLITE_OK)
+	{
+		status = vtk_sqlite3_exec(sidecar, info, NULL, NULL, &errmsg);
+	}
+	if(status == VTK_SQLITE_OK)
+	{
+		status = vtk_sqlite3_exec(sidecar, "COMMIT; DETACH DATABASE source;", NULL, NULL, &errmsg);
+	}
+	vtk_sqlite3_free(attach);
+	vtk_sqlite3_free(info);
+	if(status != VTK_SQLITE_OK || !this->CreateCoveringIndexes(sidecar))
+	{
+		if(status != VTK_SQLITE_OK)
+		{
+			vtkWarningMacro("Could not build index sidecar " << sidecarFileName << ": " << errmsg);
+			vtk_sqlite3_free(errmsg);
+		}
+		vtk_sqlite3_close(sidecar);
+		vtksys::SystemTools::RemoveFile(sidecarFileName.c_str());
+		return NULL;
+	}
+	return sidecar;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::ValidateAccessPaths()
+{
+	this->unindexedAccessPaths.clear();
+	if(this->dbSession == NULL)
+	{
+		return;
+	}
+
+	for (unsigned int n = 0; n < 6; ++n)
+	{
+		std::string explain = std::string("EXPLAIN QUERY PLAN ") + LookupSQL[n];
+		vtk_sqlite3_stmt *stmt;
+		const char *unused;
+		if(vtk_sqlite3_prepare_v2(this->dbSession, explain.c_str(), -1, &stmt, &unused) != VTK_SQLITE_OK)
+		{
+			continue;
+		}
+		// the plan detail is the last column in every sqlite version. Only a SEARCH of resources
+		// through one of its indexes is an indexed lookup: a SCAN reads every row even when it
+		// walks an index ("SCAN resources USING COVERING INDEX ..."), and an automatic index is
+		// built from a full scan for each statement.
+		std::string plan;
+		bool scans = false;
+		while(vtk_sqlite3_step(stmt) == VTK_SQLITE_ROW)
+		{
+			const char *text = reinterpret_cast< const char* >(
+					vtk_sqlite3_column_text(stmt, vtk_sqlite3_column_count(stmt)-1));
+			std::string detail = text != NULL ? text : "";
+			if((detail + " ").find(" resources ") != std::string::npos &&
+					(detail.compare(0, 7, "SEARCH ") != 0 ||
+					(detail.find(" USING INDEX ") == std::string::npos &&
+					detail.find(" USING COVERING INDEX ") == std::string::npos)))
+			{
+				scans = true;
+			}
+			plan += (plan == "" ? "" : "; ") + detail;
+		}
+		vtk_sqlite3_finalize(stmt);
+		if(scans)
+		{
+			this->unindexedAccessPaths.push_back(std::string(LookupSQL[n]) + ": " + plan);
+		}
+	}
+
+	if(this->unindexedAccessPaths.size() > 0)
+	{
+		vtkWarningMacro("The ontology DB " << this->dbFileName << " has no index for "
+				<< this->unindexedAccessPaths.size() << " of the lookups, queries will scan the resources table."
+				<< " Set the index provisioning mode to create them.");
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Helper methods
+///////////////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::toLower(std::string origstr, std::string& newstr)
+{
+   std::locale loc;
+   newstr = "";
+   for (unsigned int i = 0; i < origstr.length(); i++)
+   {
+#ifdef WIN32
+      newstr += std::tolower(origstr[i]);
+#else
+	  newstr += std::tolower(origstr[i],loc);
+#endif
+	   
+   }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::toUpper(std::string origstr, std::string& newstr)
+{
+   std::locale loc;
+   newstr = "";
+   for (unsigned int i = 0; i < origstr.length(); i++)
+   {
+#ifdef WIN32
+      newstr += std::toupper(origstr[i]);
+#else
+	  newstr += std::toupper(origstr[i],loc);
+#endif
+   }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::removeLeadingFollowingSpace(std::string &origstr)
+{
+
+	  size_t pos = origstr.find_first_of(" ");
+	  while(pos != std::string::npos && pos < 1)
+	  {
+	    origstr = origstr.substr(pos+1);
+	    pos = origstr.find_first_of(" ");
+	  }
+	  unsigned len = origstr.length();
+	  pos = origstr.find_last_of(" ");
+	  while(pos != std::string::npos && pos > len - 2)
+	  {
+	    origstr = origstr.substr(0, pos);
+	    pos = origstr.find_last_of(" ");
+	    len = origstr.length();
+	  }
+
+}
+
+
+//---------------------------------------------------------------------------
+// Resolves a term to the DB subject it stands for: the term itself if it is a subject,
+// otherwise the subject it is a non-English equivalent or a synonym of, or "null".
+std::string vtkSlicerFacetedVisualizerLogic::GetDBSubject(std::string &query,
+		vtk_sqlite3* ptrDB)
+{
+	QueryProfileTimer timer(this, &this->lastQueryProfile.ResolutionTime);
+	std::string term = query;
+	this->ToDBForm(term);
+
+	vtksys::hash_map< std::string, std::string >::iterator it = this->termDictionary.find(term);
+	if(it != this->termDictionary.end())
+	{
+		return it->second;
+	}
+	if(this->termDictionaryComplete || ptrDB == NULL ||
+	   this->unknownTerms.find(term) != this->unknownTerms.end())
+	{
+		return "null";
+	}
+
+	// the dictionary did not fit its size limit, resolve with SQL and remember the outcome
+	std::vector< std::vector< std::string > > rows;
+	std::string Subject = term;
+	int nrows = this->ExecuteLookup(Subject, false, true, "", ptrDB, rows);
+	if(nrows <= 0)
+	{
+		Subject = "null";
+	}
+	if(nrows == 0)
+	{
+		nrows = this->ExecuteLookup(term, true, false, "non_english_equivalent", ptrDB, rows);
+	}
+	if(nrows == 0)
+	{
+		nrows = this->ExecuteLookup(term, true, false, "synonym", ptrDB, rows);
+	}
+	if(Subject == "null" && nrows > 0)
+	{
+		Subject = rows[0][0];
+	}
+	if(nrows < 0)
+	{
+		// an SQL error or a cancelled query (vtk_sqlite3_interrupt) tells nothing about the term
+		return "null";
+	}
+	if(Subject == "null")
+	{
+		if(this->unknownTerms.size() >= this->unknownTermsMaximumSize)
+		{
+			this->unknownTerms.clear();
+		}
+		this->unknownTerms.insert(term);
+	}
+	else if(this->termDictionary.size() < this->termDictionaryMaximumSize)
+	{
+		this->termDictionary[term] = Subject;
+	}
+	return Subject;
+}
+
+//---------------------------------------------------------------------------
+// Loads every subject of the DB and the terms that are non-English equivalents or
+// synonyms of a subject, in the order GetDBSubject prefers them. Stops when the
+// dictionary reaches its maximum size, GetDBSubject then falls back to SQL for misses.
+void vtkSlicerFacetedVisualizerLogic::LoadTermDictionary(vtk_sqlite3* ptrDB)
+{
+	this->ClearTermDictionary();
+	if(ptrDB == NULL)
+	{
+		return;
+	}
+	const char *loadSQL[3] = {
+			"SELECT DISTINCT subject, subject from resources",
+			"SELECT object, subject from resources where predicate = 'non_english_equivalent'"
+			" order by object, subject",
+			"SELECT object, subject from resources where predicate = 'synonym'"
+			" order by object, subject" };
+	bool complete = true;
+	for (int n = 0; complete && n < 3; ++n)
+	{
+		vtk_sqlite3_stmt *stmt;
+		const char *unused;
+		if(vtk_sqlite3_prepare_v2(ptrDB, loadSQL[n], -1, &stmt, &unused) != VTK_SQLITE_OK)
+		{
+			vtkWarningMacro("Could not load the term dictionary: " << vtk_sqlite3_errmsg(ptrDB));
+			complete = false;
+			break;
+		}
+		while(vtk_sqlite3_step(stmt) == VTK_SQLITE_ROW)
+		{
+			const unsigned char *term = vtk_sqlite3_column_text(stmt, 0);
+			const unsigned char *subject = vtk_sqlite3_column_text(stmt, 1);
+			if(term == NULL || subject == NULL)
+			{
+				continue;
+			}
+			std::string key = reinterpret_cast< const char* >(term);
+			if(this->termDictionary.find(key) != this->termDictionary.end())
+			{
+				// a subject or an earlier equivalent wins
+				continue;
+			}
+			if(this->termDictionary.size() >= this->termDictionaryMaximumSize)
+			{
+				complete = false;
+				break;
+			}
+			this->termDictionary[key] = reinterpret_cast< const char* >(subject);
+		}
+		vtk_sqlite3_finalize(stmt);
+	}
+	this->termDictionaryComplete = complete;
+	vtkFacetedVisualizerInfoMacro(" term dictionary: "<<this->termDictionary.size()<<" terms"
+			<<(complete ? "" : " (incomplete, misses are resolved with SQL)"));
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::ClearTermDictionary()
+{
+	this->termDictionary.clear();
+	this->unknownTerms.clear();
+	this->termDictionaryComplete = false;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic
+::GetQueryResults(std::vector< std::vector < std::string > > &results, std::vector< std::string > &queries)
+{
+
+	vtkFacetedVisualizerOrderedSet querySet;
+	querySet.Assign(queries);
+	for (unsigned n = 0; n < resultsForDisplay.size(); ++n)
+	{
+		size_t pos = resultsForDisplay[n].find(";");
+		std::string q = resultsForDisplay[n].substr(0, pos);
+		unsigned int index = querySet.Insert(q);
+		if(index == results.size())
+		{
+			std::vector< std::string > newresults;
+			newresults.push_back(resultsForDisplay[n].substr(pos+1));
+			results.push_back(newresults);
+		}
+		else
+		{
+			results[index].push_back(resultsForDisplay[n].substr(pos+1));
+		}
+	}
+	queries = querySet.GetValues();
+}
+
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::ToDBForm(std::string& string)
+{
+
+	// convert string to DB form
+    size_t pos = string.find_first_of("'");
+	if(pos != std::string::npos)
+	{
+	  string = string.substr(pos+1);
+	}
+	pos = string.find_last_of("'");
+	if(pos != std::string::npos)
+	{
+       string = string.substr(0, pos);
+	}
+	// remove any paranthesis
+	pos = string.find_first_of("(");
+	if(pos != std::string::npos)
+	{
+	   string = string.substr(pos+1);
+	}
+	pos = string.find_last_of(")");
+	if(pos != std::string::npos)
+	{
+	  string = string.substr(0, pos);
+	}
+	if(string.empty())
+	{
+		return;
+	}
+	string[0] = std::toupper(string[0]);
+	pos = string.find_first_of(" ");
+	while(pos != std::string::npos)
+	{
+	   std::string leadstr = string.substr(0, pos);
+	   std::string trailstr = string.substr(pos+1);
+	   string = leadstr + "_" + trailstr;
+	   pos = string.find_first_of(" ");
+	}
+}
+
+//---------------------------------------------------------------------------
+vtk_sqlite3_stmt* vtkSlicerFacetedVisualizerLogic::GetLookupStatement(vtk_sqlite3* ptrDB,
+		bool asObject, bool asSubject, bool withPredicate)
+{
+	// statements are only valid for the connection they were prepared on
+	if(ptrDB != this->lookupStatementsDB)
+	{
+		this->FinalizeLookupStatements();
+		this->lookupStatementsDB = ptrDB;
+	}
+
+	int shape = (!asObject && !asSubject) ? 0 : (asObject ? 1 : 2);
+	int index = 2*shape + (withPredicate ? 1 : 0);
+	if(this->lookupStatements[index] != NULL)
+	{
+		return this->lookupStatements[index];
+	}
+
+	const char *unused;
+	int status = vtk_sqlite3_prepare_v2(ptrDB, LookupSQL[index], -1,
+			&this->lookupStatements[index], &unused);
+	if(status != VTK_SQLITE_OK)
+	{
+		vtkErrorMacro("Could not prepare lookup statement: " << vtk_sqlite3_errmsg(ptrDB));
+		this->lookupStatements[index] = NULL;
+	}
+	return this->lookupStatements[index];
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::FinalizeLookupStatements()
+{
+	for (unsigned int n = 0; n < 6; ++n)
+	{
+		if(this->lookupStatements[n] != NULL)
+		{
+			vtk_sqlite3_finalize(this->lookupStatements[n]);
+			this->lookupStatements[n] = NULL;
+		}
+	}
+	if(this->frontierInsertStatement != NULL)
+	{
+		vtk_sqlite3_finalize(this->frontierInsertStatement);
+		this->frontierInsertStatement = NULL;
+	}
+	if(this->frontierExpandStatement != NULL)
+	{
+		vtk_sqlite3_finalize(this->frontierExpandStatement);
+		this->frontierExpandStatement = NULL;
+	}
+	for (unsigned int n = 0; n < 2; ++n)
+	{
+		if(this->closureStatements[n] != NULL)
+		{
+			vtk_sqlite3_finalize(this->closureStatements[n]);
+			this->closureStatements[n] = NULL;
+		}
+		this->closureStatementsFailed[n] = false;
+	}
+	if(this->closureTableStatement != NULL)
+	{
+		vtk_sqlite3_finalize(this->closureTableStatement);
+		this->closureTableStatement = NULL;
+	}
+	this->lookupStatementsDB = NULL;
+}
+
+//---------------------------------------------------------------------------
+int vtkSlicerFacetedVisualizerLogic::ExecuteLookup(std::string& term, bool asObject,
+		bool asSubject, const std::string& Predicate, vtk_sqlite3* ptrDB,
+		std::vector< std::vector< std::string > > &rows)
+{
+	rows.clear();
+	this->ToDBForm(term);
+	if(ptrDB == NULL)
+	{
+		return -1;
+	}
+
+	if(this->GetInMemoryStoreInUse())
+	{
+		if(!this->tripleStore->IsLoaded() && !this->tripleStore->Load(ptrDB))
+		{
+			vtkWarningMacro("Could not load the in-memory triple store of " << this->dbSessionFileName
+					<< ", falling back to SQL lookups for this session");
+			this->inMemoryStoreFailed = true;
+		}
+		else
+		{
+			int nrows = this->tripleStore->Lookup(term, asObject, asSubject, Predicate, rows);
+			if(this->queryProfiling)
+			{
+				++this->lastQueryProfile.StoreLookups;
+				this->lastQueryProfile.RowsFetched += rows.size();
+			}
+			return nrows;
+		}
+	}
+
+	vtk_sqlite3_stmt *stmt = this->GetLookupStatement(ptrDB, asObject, asSubject, Predicate != "");
+	if(stmt == NULL)
+	{
+		return -1;
+	}
+
+	vtk_sqlite3_bind_text(stmt, 1, term.c_str(), -1, VTK_SQLITE_STATIC);
+	if(Predicate != "")
+	{
+		vtk_sqlite3_bind_text(stmt, 2, Predicate.c_str(), -1, VTK_SQLITE_STATIC);
+	}
+
+	int status = vtk_sqlite3_step(stmt);
+	while(status == VTK_SQLITE_ROW)
+	{
+		std::vector< std::string > row(3);
+		for (int nc = 0; nc < 3; ++nc)
+		{
+			const unsigned char *text = vtk_sqlite3_column_text(stmt, nc);
+			if(text != NULL)
+			{
+				row[nc] = reinterpret_cast< const char* >(text);
+			}
+		}
+		rows.push_back(row);
+		status = vtk_sqlite3_step(stmt);
+	}
+	vtk_sqlite3_reset(stmt);
+	vtk_sqlite3_clear_bindings(stmt);
+	this->AddQueryProfileStatements(1, rows.size());
+
+	if(status != VTK_SQLITE_DONE)
+	{
+		return -1;
+	}
+	return rows.size();
+}
+
+
+//----------------------------------------------------------------------------------
+vtkFacetedVisualizerTokenIndex* vtkSlicerFacetedVisualizerLogic::GetTokenIndex(vtk_sqlite3* ptrDB)
+{
+	if(!this->tokenIndex->IsBuilt())
+	{
+		if(ptrDB == NULL || !this->tokenIndex->Build(ptrDB))
+		{
+			return NULL;
+		}
+		vtkFacetedVisualizerInfoMacro(" token index: "<<this->tokenIndex->GetNumberOfTokens()<<" tokens over "
+				<<this->tokenIndex->GetNumberOfSubjects()<<" subjects");
+	}
+	return this->tokenIndex;
+}
+
+//----------------------------------------------------------------------------------
+// The DB queries of the model matching, prepared once per connection
+struct vtkSlicerFacetedVisualizerLogic::SyncConnection
+{
+	vtk_sqlite3      *DB;
+	bool              Owned;
+	vtk_sqlite3_stmt *Statements[3];
+
+	SyncConnection()
+	{
+		this->DB = NULL;
+		this->Owned = false;
+		for (int n = 0; n < 3; ++n)
+		{
+			this->Statements[n] = NULL;
+		}
+	}
+
+	~SyncConnection()
+	{
+		for (int n = 0; n < 3; ++n)
+		{
+			if(this->Statements[n] != NULL)
+			{
+				vtk_sqlite3_finalize(this->Statements[n]);
+			}
+		}
+		if(this->Owned && this->DB != NULL)
+		{
+			vtk_sqlite3_close(this->DB);
+		}
+	}
+
+	void Attach(vtk_sqlite3* ptrDB)
+	{
+		this->DB = ptrDB;
+	}
+
+	bool Open(const std::string& fileName)
+	{
+		this->Owned = true;
+		if(fileName == "" ||
+		   vtk_sqlite3_open_v2(fileName.c_str(), &this->DB, VTK_SQLITE_OPEN_READONLY, NULL) != VTK_SQLITE_OK)
+		{
+			return false;
+		}
+		return true;
+	}
+
+	// first column of the first row of statement n for the term (and predicate), or "null"
+	std::string First(int n, const std::string& term, const char* predicate)
+	{
+		static const char* SQL[3] = {
+				"SELECT subject from resources where subject = ?1 or object = ?1 limit 1",
+				"SELECT subject from resources where subject = ?1 limit 1",
+				"SELECT subject from resources where object = ?1 and predicate = ?2 order by subject limit 1" };
+		if(this->DB == NULL)
+		{
+			return "null";
+		}
+		const char *unused;
+		if(this->Statements[n] == NULL &&
+		   vtk_sqlite3_prepare_v2(this->DB, SQL[n], -1, &this->Statements[n], &unused) != VTK_SQLITE_OK)
+		{
+			this->Statements[n] = NULL;
+			return "null";
+		}
+		vtk_sqlite3_bind_text(this->Statements[n], 1, term.c_str(), -1, VTK_SQLITE_STATIC);
+		if(predicate != NULL)
+		{
+			vtk_sqlite3_bind_text(this->Statements[n], 2, predicate, -1, VTK_SQLITE_STATIC);
+		}
+		std::string first = "null";
+		if(vtk_sqlite3_step(this->Statements[n]) == VTK_SQLITE_ROW)
+		{
+			const unsigned char *text = vtk_sqlite3_column_text(this->Statements[n], 0);
+			first = text != NULL ? reinterpret_cast< const char* >(text) : "";
+		}
+		vtk_sqlite3_reset(this->Statements[n]);
+		vtk_sqlite3_clear_bindings(this->Statements[n]);
+		return first;
+	}
+
+	// is the term a subject or an object of some triple
+	bool Exists(const std::string& term)
+	{
+		return this->First(0, term, NULL) != "null";
+	}
+
+	// the subject the term stands for, see GetDBSubject
+	std::string Resolve(const std::string& term)
+	{
+		std::string subject = this->First(1, term, NULL);
+		if(subject == "null")
+		{
+			subject = this->First(2, term, "non_english_equivalent");
+		}
+		if(subject == "null")
+		{
+			subject = this->First(2, term, "synonym");
+		}
+		return subject;
+	}
+};
+
+//----------------------------------------------------------------------------------
+struct vtkSlicerFacetedVisualizerLogic::SyncThreadData
+{
+	vtkSlicerFacetedVisualizerLogic                   *Self;
+	std::vector< vtkSlicerFacetedVisualizerLogic::ModelMatch > *Matches;
+	bool                                               Fuzzy;
+	vtk_sqlite3                                       *DB;
+	std::string                                        DBFileName;
+	// set by the threads that could not open a connection
+	std::vector< int >                                 Failed;
+};
+
+//----------------------------------------------------------------------------------
+// Converts the name of a hierarchy node to the DB form and the tokens used for fuzzy
+// matching. Reads the scene, so it has to run on the MRML thread.
+void vtkSlicerFacetedVisualizerLogic::PrepareModelMatch(vtkMRMLModelHierarchyNode *modelNode,
+		ModelMatch &match)
+{
+
+	// Following is to fix working with the Abdominal atlas
+	std::string modelName = modelNode->GetName();
+	std::string lomodelName;
+	this->toLower(modelName, lomodelName);
+	size_t posCheck = lomodelName.find("vtkmrmlmodelhierarchynode");
+	if(posCheck != std::string::npos)
+	{
+		modelName = vtkMRMLModelNode::SafeDownCast(modelNode->GetAssociatedNode())->GetName();
+		vtkFacetedVisualizerDebugMacro(" using mrmlmodelNode instead of hierarchy node "<<modelName);
+		this->toLower(modelName, lomodelName);
+		posCheck = lomodelName.find("_");
+		if(posCheck != std::string::npos)
+		{
+			lomodelName = lomodelName.substr(posCheck+1);
+			posCheck = lomodelName.find_first_of("_");
+			lomodelName = lomodelName.substr(posCheck+1);
+		}
+	}
+
+	// convert the model name string in to the correct form for use in the DB.
+	// Currently we assume that in the DB, the atoms are represented as "White_matter_of_cerebellum"
+	// following the way the atoms are represented in the FMA ontology
+	std::string string = lomodelName;
+	// convert string to DB form
+	size_t pos = string.find_first_of("'");
+	if(pos != std::string::npos)
+	{
+	  string = string.substr(pos+1);
+	}
+	pos = string.find_last_of("'");
+	if(pos != std::string::npos)
+	{
+	   string = string.substr(0, pos);
+	}
+	// remove any paranthesis
+	pos = string.find_first_of("(");
+	if(pos != std::string::npos)
+	{
+	   string = string.substr(pos+1);
+	}
+	pos = string.find_last_of(")");
+	if(pos != std::string::npos)
+	{
+	  string = string.substr(0, pos);
+	}
+	string[0] = std::toupper(string[0]);
+
+	std::vector< std::string > individualStrings;
+	int countNonWildCardStrings = 0;
+	pos = string.find_first_of(" ");
+
+	// the following gets rid of non-useful search strings to break down a complex string into
+	// individual strings so we can match the model to the DB using individual string combinations
+	// Ex: "White_matter_of_cerebellum" as "White_matter%", "%matter%cerebellum", etc.
+
+	while(pos != std::string::npos)
+	{
+	   std::string leadstr = string.substr(0, pos);
+	   std::string trailstr = string.substr(pos+1);
+	   size_t p = leadstr.find_last_of("_");
+	   std::string tmpstr = leadstr;
+	   if( p != std::string::npos)
+	   {
+		   tmpstr = leadstr.substr(p+1);
+	   }
+
+	   vtkFacetedVisualizerTraceMacro(" leadstr "<<tmpstr);
+
+	   bool foundIgnore = strcmp(tmpstr.c_str(), "of") == 0;
+	   if(!foundIgnore)
+	   {
+		 individualStrings.push_back(tmpstr);
+	   }
+
+	   string = leadstr + "_" + trailstr;
+	   pos = string.find_first_of(" ");
+
+	   if(pos == std::string::npos)
+	   {
+		   foundIgnore = strcmp(trailstr.c_str(), "of") == 0;
+		   if(!foundIgnore)
+		   {
+			   individualStrings.push_back(trailstr);
+		   }
+	   }
+	   countNonWildCardStrings = individualStrings.size();
+	}
+
+	modelName = string;
+	this->ToDBForm(modelName);
+
+	match.NodeName = modelNode->GetName();
+	match.DBName = modelName;
+	match.Tokens = individualStrings;
+	match.InDB = false;
+	match.Subject = "null";
+	match.Candidates.clear();
+}
+
+//----------------------------------------------------------------------------------
+// Matches a prepared name with the DB: first exactly, or with fuzzy set through the
+// token index, which has to be built beforehand. Only reads the connection, the term
+// dictionary and the token index, so models can be matched on several threads at once.
+void vtkSlicerFacetedVisualizerLogic::MatchModel(ModelMatch &match, SyncConnection &connection,
+		bool fuzzy)
+{
+	if(fuzzy)
+	{
+		// candidates are the subjects sharing the leading or trailing tokens of the name,
+		// found through the token index rather than leading-wildcard LIKE scans of the table
+		if(!match.InDB && !match.Tokens.empty() && this->tokenIndex->IsBuilt())
+		{
+			this->tokenIndex->Match(match.Tokens, match.Candidates);
+		}
+		return;
+	}
+
+	match.InDB = connection.Exists(match.DBName);
+	if(!match.InDB)
+	{
+		return;
+	}
+	// same resolution as GetDBSubject, without touching its caches
+	vtksys::hash_map< std::string, std::string >::const_iterator it = this->termDictionary.find(match.DBName);
+	if(it != this->termDictionary.end())
+	{
+		match.Subject = it->second;
+	}
+	else if(!this->termDictionaryComplete)
+	{
+		match.Subject = connection.Resolve(match.DBName);
+	}
+}
+
+//----------------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::ApplyModelMatch(const ModelMatch &match,
+		vtkFacetedVisualizerOrderedSet &possibleMatchingDBEntries)
+{
+   vtkFacetedVisualizerDebugMacro(" Synching model "<<match.DBName<<" with DB ");
+
+   if(match.InDB)
+   {
+	   vtkFacetedVisualizerDebugMacro(" inserting into modelDB pair "<<match.DBName<<" : "<<match.NodeName);
+	   mrmlDBTerms.insert(std::pair< std::string, std::string > (match.Subject, match.NodeName));
+       possibleMatchingDBEntries.Insert(match.Subject);
+   }
+   else if(match.Tokens.size() > 0)
+   {
+	   for (size_t c = 0; c < match.Candidates.size(); ++c)
+	   {
+		   possibleMatchingDBEntries.Insert(match.Candidates[c]);
+	   }
+	   if(match.Candidates.empty())
+	   {
+		   // Add the node as a local non-DB node
+		   this->nonDBElements.Insert(match.NodeName);
+	   }
+   }
+}
+
+//----------------------------------------------------------------------------------
+// Matches the models with the DB on up to numberOfSyncThreads threads. Every thread but
+// the first opens its own read-only connection; the term dictionary and the token index
+// are shared read-only. Each thread takes every n-th model and writes only its entries,
+// so the outcome does not depend on the number of threads.
+void vtkSlicerFacetedVisualizerLogic::MatchModelsWithDB(std::vector< ModelMatch > &matches,
+		vtk_sqlite3* ptrDB)
+{
+	int numberOfThreads = this->numberOfSyncThreads > 0 ? this->numberOfSyncThreads :
+			vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+	int maximumThreads = static_cast< int >((matches.size() + MinimumModelsPerSyncThread - 1) /
+			MinimumModelsPerSyncThread);
+	numberOfThreads = std::min(numberOfThreads, maximumThreads);
+	vtkNew< vtkMultiThreader > threader;
+	if(numberOfThreads > 1)
+	{
+		// vtkMultiThreader clamps the count to VTK_MAX_THREADS: the models are split by the
+		// number of threads it actually runs
+		threader->SetNumberOfThreads(numberOfThreads);
+		numberOfThreads = threader->GetNumberOfThreads();
+	}
+
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		bool fuzzy = pass == 1;
+		if(fuzzy)
+		{
+			bool needsTokenIndex = false;
+			for (size_t n = 0; n < matches.size() && !needsTokenIndex; ++n)
+			{
+				needsTokenIndex = !matches[n].InDB && !matches[n].Tokens.empty();
+			}
+			if(!needsTokenIndex || this->GetTokenIndex(ptrDB) == NULL)
+			{
+				return;
+			}
+		}
+
+		SyncThreadData data;
+		data.Self = this;
+		data.Matches = &matches;
+		data.Fuzzy = fuzzy;
+		data.DB = ptrDB;
+		data.DBFileName = this->dbSessionFileName;
+		data.Failed.assign(std::max(numberOfThreads, 1), 0);
+		if(numberOfThreads > 1)
+		{
+			threader->SetSingleMethod(SyncModelsThread, &data);
+			threader->SingleMethodExecute();
+		}
+		else
+		{
+			data.Failed[0] = 1;
+		}
+
+		// models of threads that could not open the DB are matched here
+		SyncConnection connection;
+		connection.Attach(ptrDB);
+		int stride = static_cast< int >(data.Failed.size());
+		for (int t = 0; t < stride; ++t)
+		{
+			for (size_t n = t; data.Failed[t] && n < matches.size(); n += stride)
+			{
+				this->MatchModel(matches[n], connection, fuzzy);
+			}
+		}
+	}
+}
+
+//----------------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkSlicerFacetedVisualizerLogic::SyncModelsThread(void *arg)
+{
+	vtkMultiThreader::ThreadInfo *info = static_cast< vtkMultiThreader::ThreadInfo* >(arg);
+	SyncThreadData *data = static_cast< SyncThreadData* >(info->UserData);
+
+	SyncConnection connection;
+	if(info->ThreadID == 0 || data->Fuzzy)
+	{
+		// the calling thread waits for the workers, its connection is free to use
+		connection.Attach(data->DB);
+	}
+	else if(!connection.Open(data->DBFileName))
+	{
+		data->Failed[info->ThreadID] = 1;
+		return VTK_THREAD_RETURN_VALUE;
+	}
+	std::vector< ModelMatch > &matches = *data->Matches;
+	for (size_t n = info->ThreadID; n < matches.size(); n += info->NumberOfThreads)
+	{
+		data->Self->MatchModel(matches[n], connection, data->Fuzzy);
+	}
+	return VTK_THREAD_RETURN_VALUE;
+}
+
+//------------------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic
+::SynchronizeAtlasWithDB(std::vector< std::vector< std::string > > &matchingDBAtoms,
+		std::vector< std::string > &MRMLAtoms)
+{
+	this->CancelQuery();
+
+	matchingDBAtoms.clear();
+	MRMLAtoms.clear();
+	this->nonDBElements.Clear();
+	this->mrmlDBTerms.clear();
+	this->displayCandidates.clear();
+	this->displayCandidateIndices.clear();
+	// cached display sets refer to the candidates and to the model / DB term mapping
+	this->resultCache->Clear();
+	this->syncedHierarchyNodes.clear();
+	this->atlasModelNodeIDs.clear();
+	this->pendingSyncNodeIDs.clear();
+	// from now on the scene events keep the mapping up to date
+	this->atlasSynchronized = true;
+
+   // renamed nodes are only noticed when the index is rebuilt
+   this->RebuildSceneNodeIndex();
+
+   // get the models in the atlas
+   vtk_sqlite3 *ptrDB = this->GetDBSession();
+   if(ptrDB == NULL)
+   {
+	   this->setValidDBFileName = false;
+     unsigned int nmodelNodes = static_cast< unsigned int >(this->sceneModelNodes.size());
+     vtkFacetedVisualizerDebugMacro(" Number Model Nodes "<<nmodelNodes);
+     // the first three are red, yellow and green slices
+     for (unsigned int n = 0; n < nmodelNodes; ++n)
+     {
+       vtkMRMLModelNode *modelNode = this->sceneModelNodes[n];
+
+       std::string modelName = modelNode->GetName();
+       this->nonDBElements.Insert(modelName);
+     }
+
+     return;
+   }
+   else
+   {
+      this->setValidDBFileName = true;
+   }
+ 
+   unsigned int nmodels = static_cast< unsigned int >(this->sceneHierarchyNodes.size());
+
+   std::vector< ModelMatch > matches(nmodels);
+   for (unsigned int n = 0; n < nmodels; n++)
+   {
+	  // get model name and check if the corresponding text exists in the database
+       vtkMRMLModelHierarchyNode *modelNode = this->sceneHierarchyNodes[n];
+
+       SyncedHierarchyNode &synced = this->syncedHierarchyNodes[modelNode->GetID()];
+       this->GetSyncedState(modelNode, synced);
+       std::vector< std::string > &modelNodeIDs = synced.ModelNodeIDs;
+       this->GetAtlasModelNodeIDs(modelNode, modelNodeIDs);
+       for (size_t t = 0; t < modelNodeIDs.size(); ++t)
+       {
+    	   ++this->atlasModelNodeIDs[modelNodeIDs[t]];
+       }
+       this->PrepareModelMatch(modelNode, matches[n]);
+   }
+
+   // the DB matching of the models is independent, the results are merged in scene order
+   this->MatchModelsWithDB(matches, ptrDB);
+
+   for (unsigned int n = 0; n < nmodels; n++)
+   {
+       vtkFacetedVisualizerOrderedSet possibleMatchingEntries;
+       this->ApplyModelMatch(matches[n], possibleMatchingEntries);
+       this->syncedHierarchyNodes[this->sceneHierarchyNodes[n]->GetID()].Match = matches[n];
+       //if(possibleMatchingEntries.size() > 0)
+       //{
+         matchingDBAtoms.push_back(possibleMatchingEntries.GetValues());
+         MRMLAtoms.push_back(matches[n].NodeName);
+       //}
+
+   }
+
+   // get all the model nodes and check if they are already used by the hierarchy nodes.
+   // otherwise we just add it as a non-DB node and use it directly for displaying when the appropriate
+   // user query is encountered. Useful for displaying user added models to the scene
+
+   unsigned int nmodelNodes = static_cast< unsigned int >(this->sceneModelNodes.size());
+   vtkFacetedVisualizerDebugMacro(" Number Model Nodes "<<nmodelNodes);
+   // the first three are red, yellow and green slices
+   for (unsigned int n = 0; n < nmodelNodes; ++n)
+   {
+	   vtkMRMLModelNode *modelNode = this->sceneModelNodes[n];
+
+	   std::string modelName = modelNode->GetName();
+	   std::string modelID = modelNode->GetID();
+
+	   if(this->atlasModelNodeIDs.find(modelID) == this->atlasModelNodeIDs.end())
+	   {
+	      this->nonDBElements.Insert(modelName);
+	   }
+   }
+
+   // index the display candidates up front, the matched models in the order of their DB
+   // terms (the order of mrmlDBTerms) and then the non-DB elements
+   std::multimap< std::string, std::string >::iterator itMRML;
+   for (itMRML = this->mrmlDBTerms.begin(); itMRML != this->mrmlDBTerms.end(); ++itMRML)
+   {
+	   this->GetDisplayCandidateIndex(itMRML->second);
+   }
+   for (unsigned k = 0; k < this->nonDBElements.GetNumberOfValues(); ++k)
+   {
+	   this->GetDisplayCandidateIndex(this->nonDBElements.GetValue(k));
+   }
+
+   this->UpdateSceneFingerprint();
+
+   // print out the Non DB nodes for debugging
+   vtkFacetedVisualizerDebugMacro(" num non DB elements "<<this->nonDBElements.GetNumberOfValues());
+   for (unsigned k = 0; k < this->nonDBElements.GetNumberOfValues(); ++k)
+   {
+	   vtkFacetedVisualizerTraceMacro(" "<<this->nonDBElements.GetValue(k));
+   }
+
+}
+
+//------------------------------------------------------------------------------------
+// The properties of a hierarchy node its match depends on
+void vtkSlicerFacetedVisualizerLogic::GetSyncedState(vtkMRMLModelHierarchyNode *node,
+		SyncedHierarchyNode &synced)
+{
+	synced.Name = node->GetName() != NULL ? node->GetName() : "";
+	synced.ParentNodeID = node->GetParentNodeID() != NULL ? node->GetParentNodeID() : "";
+	synced.AssociatedNodeID = node->GetAssociatedNodeID() != NULL ? node->GetAssociatedNodeID() : "";
+}
+
+//------------------------------------------------------------------------------------
+// IDs of the model nodes a hierarchy node takes out of the non-DB elements
+void vtkSlicerFacetedVisualizerLogic::GetAtlasModelNodeIDs(vtkMRMLModelHierarchyNode *modelNode,
+		std::vector< std::string > &modelNodeIDs)
+{
+	modelNodeIDs.clear();
+	if(modelNode->GetNumberOfChildrenNodes() == 0)
+	{
+		if(modelNode->GetAssociatedNodeID() != NULL)
+		{
+			modelNodeIDs.push_back(modelNode->GetAssociatedNodeID());
+		}
+		return;
+	}
+	const std::vector< vtkMRMLModelNode* > &children = this->GetChildModelNodes(modelNode);
+	for (size_t t = 0; t < children.size(); ++t)
+	{
+		modelNodeIDs.push_back(children[t]->GetID());
+	}
+}
+
+//------------------------------------------------------------------------------------
+// Matches a hierarchy node added after SynchronizeAtlasWithDB with the DB, or makes a
+// model node a non-DB element unless a hierarchy node already uses it.
+void vtkSlicerFacetedVisualizerLogic::SyncAddedNode(vtkMRMLNode *node)
+{
+	vtkMRMLModelHierarchyNode *hierarchyNode = vtkMRMLModelHierarchyNode::SafeDownCast(node);
+	if(hierarchyNode == NULL)
+	{
+		this->UpdateNonDBElement(node->GetName());
+		return;
+	}
+
+	vtk_sqlite3 *ptrDB = this->GetDBSession();
+	// without a DB the hierarchy nodes are not synchronized
+	if(ptrDB == NULL || this->syncedHierarchyNodes.find(node->GetID()) != this->syncedHierarchyNodes.end())
+	{
+		return;
+	}
+	SyncedHierarchyNode &synced = this->syncedHierarchyNodes[node->GetID()];
+	this->GetSyncedState(hierarchyNode, synced);
+	this->GetAtlasModelNodeIDs(hierarchyNode, synced.ModelNodeIDs);
+
+	ModelMatch &match = synced.Match;
+	this->PrepareModelMatch(hierarchyNode, match);
+	SyncConnection connection;
+	connection.Attach(ptrDB);
+	this->MatchModel(match, connection, false);
+	if(!match.InDB && !match.Tokens.empty() && this->GetTokenIndex(ptrDB) != NULL)
+	{
+		this->MatchModel(match, connection, true);
+	}
+	vtkFacetedVisualizerOrderedSet possibleMatchingEntries;
+	this->ApplyModelMatch(match, possibleMatchingEntries);
+	this->GetDisplayCandidateIndex(match.NodeName);
+
+	for (size_t t = 0; t < synced.ModelNodeIDs.size(); ++t)
+	{
+		if(++this->atlasModelNodeIDs[synced.ModelNodeIDs[t]] == 1)
+		{
+			vtkMRMLNode *modelNode = this->GetMRMLScene()->GetNodeByID(synced.ModelNodeIDs[t].c_str());
+			if(modelNode != NULL)
+			{
+				this->UpdateNonDBElement(modelNode->GetName());
+			}
+		}
+	}
+}
+
+//------------------------------------------------------------------------------------
+// Undoes what SynchronizeAtlasWithDB or SyncAddedNode did for a node that was removed
+// from the scene (and from the scene node index).
+void vtkSlicerFacetedVisualizerLogic::SyncRemovedNode(vtkMRMLNode *node)
+{
+	std::string name = node->GetName() != NULL ? node->GetName() : "";
+	if(vtkMRMLModelHierarchyNode::SafeDownCast(node) == NULL)
+	{
+		this->UpdateNonDBElement(name);
+		return;
+	}
+
+	vtksys::hash_map< std::string, SyncedHierarchyNode >::iterator it =
+			this->syncedHierarchyNodes.find(node->GetID());
+	if(it == this->syncedHierarchyNodes.end())
+	{
+		return;
+	}
+	SyncedHierarchyNode synced = it->second;
+	this->syncedHierarchyNodes.erase(it);
+
+	if(synced.Match.InDB)
+	{
+		std::pair< std::multimap< std::string, std::string >::iterator,
+		           std::multimap< std::string, std::string >::iterator > range =
+				this->mrmlDBTerms.equal_range(synced.Match.Subject);
+		for (std::multimap< std::string, std::string >::iterator itMRML = range.first;
+				itMRML != range.second; ++itMRML)
+		{
+			if(itMRML->second == synced.Match.NodeName)
+			{
+				this->mrmlDBTerms.erase(itMRML);
+				break;
+			}
+		}
+	}
+	this->UpdateNonDBElement(synced.Match.NodeName);
+
+	for (size_t t = 0; t < synced.ModelNodeIDs.size(); ++t)
+	{
+		vtksys::hash_map< std::string, int >::iterator itID = this->atlasModelNodeIDs.find(synced.ModelNodeIDs[t]);
+		if(itID == this->atlasModelNodeIDs.end() || --itID->second > 0)
+		{
+			continue;
+		}
+		this->atlasModelNodeIDs.erase(itID);
+		vtkMRMLNode *modelNode = this->GetMRMLScene()->GetNodeByID(synced.ModelNodeIDs[t].c_str());
+		if(modelNode != NULL)
+		{
+			this->UpdateNonDBElement(modelNode->GetName());
+		}
+	}
+}
+
+//------------------------------------------------------------------------------------
+// A name is a non-DB element if a model node of that name is not used by a hierarchy
+// node, or if a hierarchy node of that name matched nothing in the DB.
+void vtkSlicerFacetedVisualizerLogic::UpdateNonDBElement(const std::string& name)
+{
+	bool nonDB = false;
+	const std::vector< vtkMRMLModelNode* > &modelNodes = this->GetModelNodesByName(name);
+	for (size_t n = 0; n < modelNodes.size() && !nonDB; ++n)
+	{
+		nonDB = this->atlasModelNodeIDs.find(modelNodes[n]->GetID()) == this->atlasModelNodeIDs.end();
+	}
+	const std::vector< vtkMRMLModelHierarchyNode* > &hierarchyNodes = this->GetHierarchyNodesByName(name);
+	for (size_t n = 0; n < hierarchyNodes.size() && !nonDB; ++n)
+	{
+		vtksys::hash_map< std::string, SyncedHierarchyNode >::iterator it =
+				this->syncedHierarchyNodes.find(hierarchyNodes[n]->GetID());
+		nonDB = it != this->syncedHierarchyNodes.end() && !it->second.Match.InDB &&
+				!it->second.Match.Tokens.empty() && it->second.Match.Candidates.empty();
+	}
+	if(nonDB)
+	{
+		this->nonDBElements.Insert(name);
+		this->GetDisplayCandidateIndex(name);
+	}
+	else
+	{
+		this->nonDBElements.Remove(name);
+	}
+}
+
+//------------------------------------------------------------------------------------
+// Matches the nodes added since the last time, hierarchy nodes first as they take their
+// model nodes out of the non-DB elements
+void vtkSlicerFacetedVisualizerLogic::SyncPendingNodes()
+{
+	if(this->pendingSyncNodeIDs.empty())
+	{
+		return;
+	}
+	// the running query reads the mapping changed below
+	this->CancelQuery();
+	std::vector< std::string > pending;
+	pending.swap(this->pendingSyncNodeIDs);
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		for (size_t n = 0; n < pending.size(); ++n)
+		{
+			vtkMRMLNode *node = this->GetMRMLScene()->GetNodeByID(pending[n].c_str());
+			if(node != NULL && (vtkMRMLModelHierarchyNode::SafeDownCast(node) != NULL) == (pass == 0))
+			{
+				this->SyncAddedNode(node);
+			}
+		}
+	}
+	this->FinishIncrementalSync();
+}
+
+//------------------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::FinishIncrementalSync()
+{
+	// cached display sets refer to the model / DB term mapping
+	this->resultCache->Clear();
+	this->sceneFingerprintModified = true;
+}
+
+//------------------------------------------------------------------------------------
+// Key under which the result of a query operand is cached. Operands with the same
+// outcome get the same key: case and surrounding spaces are dropped and synonyms or
+// non-English equivalents are resolved to the DB subject. Names of models that are not
+// in the DB are matched by text, as ProcessSingleQuery does.
+std::string vtkSlicerFacetedVisualizerLogic::GetCanonicalQueryKey(const std::string& query,
+		vtk_sqlite3* ptrDB)
+{
+	std::string text;
+	this->toLower(query, text);
+	this->removeLeadingFollowingSpace(text);
+	size_t pos = text.find(";");
+	std::string firstPart = text.substr(0, pos);
+	if(pos == std::string::npos)
+	{
+		for (unsigned int l = 0; l < this->nonDBElements.GetNumberOfValues(); ++l)
+		{
+			std::string lqdb;
+			this->toLower(this->nonDBElements.GetValue(l), lqdb);
+			if(lqdb == text)
+			{
+				return "model:" + text;
+			}
+		}
+	}
+	std::string subject = ptrDB != NULL ? this->GetDBSubject(firstPart, ptrDB) : "null";
+	if(subject == "null")
+	{
+		return "text:" + text;
+	}
+	return pos == std::string::npos ? "db:" + subject : "db:" + subject + text.substr(pos);
+}
+
+//------------------------------------------------------------------------------------
+unsigned int vtkSlicerFacetedVisualizerLogic::GetDisplayCandidateIndex(const std::string& name)
+{
+	vtksys::hash_map< std::string, unsigned int >::iterator it = this->displayCandidateIndices.find(name);
+	if(it != this->displayCandidateIndices.end())
+	{
+		return it->second;
+	}
+	unsigned int index = static_cast< unsigned int >(this->displayCandidates.size());
+	this->displayCandidates.push_back(name);
+	this->displayCandidateIndices[name] = index;
+	return index;
+}
+
+//------------------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::AddDisplayTermsForDBTerm(std::string &term,
+		vtk_sqlite3* ptrDB, vtkFacetedVisualizerBitSet &displayTerms)
+{
+	std::pair< std::multimap< std::string, std::string >::iterator,
+	          std::multimap< std::string, std::string > ::iterator > mrmlIt;
+	mrmlIt = mrmlDBTerms.equal_range(this->GetDBSubject(term, ptrDB));
+	std::multimap< std::string, std::string >::iterator itMRML;
+	for(itMRML = mrmlIt.first; itMRML != mrmlIt.second; ++itMRML)
+	{
+		displayTerms.Set(this->GetDisplayCandidateIndex(itMRML->second));
+	}
+}
+
+//------------------------------------------------------------------------------------
+// Adds the display nodes of the subjects in rows to displayTerms and the terms reached
+// through rows that were not expanded yet in this query to the next frontier
+void vtkSlicerFacetedVisualizerLogic::ProcessTraversalRows(
+		std::vector< std::vector< std::string > > &rows, bool queryAsSubject,
+		vtk_sqlite3* ptrDB, vtkFacetedVisualizerBitSet &displayTerms,
+		std::vector< std::string > &nextFrontier)
+{
+	for (unsigned int nr = 0; nr < rows.size(); nr++)
+	{
+		std::vector< std::string> &term = rows[nr];
+
+		// with the term as subject we follow (term, part, object) to the object, otherwise
+		// (subject, part_of, term) back to the subject
+		std::string nextTerm = queryAsSubject ? term[2] : term[0];
+
+		this->AddDisplayTermsForDBTerm(term[0], ptrDB, displayTerms);
+
+		if(this->traversalVisited.insert(nextTerm).second)
+		{
+			nextFrontier.push_back(nextTerm);
+		}
+	}
+}
+
+//------------------------------------------------------------------------------------
+// Expands the rows of the seed lookup (queryTerm, Predicate) level by level over the
+// recursion predicates. Every term is expanded at most once per query, so inverse
+// predicate pairs and diamonds in the hierarchy do not cause repeated work.
+int vtkSlicerFacetedVisualizerLogic::RecursiveProcessQuery(std::string& queryTerm,
+		                              const std::string& Predicate,
+		                              vtk_sqlite3* ptrDB,
+		                              bool queryAsSubject,
+		                              vtkFacetedVisualizerBitSet &displayTerms)
+{
+
+	if(this->closureTableAvailable && this->IsClosurePredicate(Predicate, queryAsSubject))
+	{
+		return this->RecursiveProcessQueryClosureTable(queryTerm, Predicate, ptrDB, queryAsSubject, displayTerms);
+	}
+
+	if(this->traversalMode == TraversalRecursiveCTE && !this->GetInMemoryStoreInUse() &&
+	   vtk_sqlite3_libversion_number() >= 3008003)
+	{
+		return this->RecursiveProcessQueryCTE(queryTerm, Predicate, ptrDB, queryAsSubject, displayTerms);
+	}
+
+	std::vector< std::vector< std::string > > rows;
+	int nrows = this->ExecuteLookup(queryTerm, !queryAsSubject, queryAsSubject, Predicate, ptrDB, rows);
+	if(nrows <= 0)
+	{
+		return -1;
+	}
+	vtkFacetedVisualizerDebugMacro(" number of row results "<<nrows<<" for query "<<queryTerm<<";"<<Predicate);
+
+	this->traversalVisited.insert(queryTerm);
+	std::vector< std::string > frontier;
+	this->ProcessTraversalRows(rows, queryAsSubject, ptrDB, displayTerms, frontier);
+	this->AddTraversalLevelStatistics(0, 1, nrows, frontier.size());
+
+	unsigned int depth = 1;
+	while(!frontier.empty() && !this->IsQueryCancelled())
+	{
+		std::vector< std::string > nextFrontier;
+		unsigned int levelRows = 0;
+		if(this->traversalMode != TraversalPerTerm && !this->GetInMemoryStoreInUse())
+		{
+			int batchRows = this->ExpandFrontierBatched(frontier, ptrDB, displayTerms, nextFrontier);
+			if(batchRows >= 0)
+			{
+				this->AddTraversalLevelStatistics(depth, frontier.size(), batchRows, nextFrontier.size());
+				frontier.swap(nextFrontier);
+				++depth;
+				continue;
+			}
+			// the temporary table could not be used, expand this level term by term
+		}
+		for (unsigned ns = 0; ns < frontier.size() && !this->IsQueryCancelled(); ns++)
+		{
+			for (unsigned nrec = 0; nrec < recursionPredicates.size(); ++nrec)
+			{
+				std::string term = frontier[ns];
+				if(this->ExecuteLookup(term, false, true, recursionPredicates[nrec], ptrDB, rows) > 0)
+				{
+					levelRows += rows.size();
+					this->ProcessTraversalRows(rows, true, ptrDB, displayTerms, nextFrontier);
+				}
+			}
+
+			for (unsigned nrec = 0; nrec < addRecursionPredicates.size(); ++nrec)
+			{
+				std::string term = frontier[ns];
+				if(this->ExecuteLookup(term, true, false, addRecursionPredicates[nrec], ptrDB, rows) > 0)
+				{
+					levelRows += rows.size();
+					this->ProcessTraversalRows(rows, false, ptrDB, displayTerms, nextFrontier);
+				}
+			}
+		}
+		this->AddTraversalLevelStatistics(depth, frontier.size(), levelRows, nextFrontier.size());
+		frontier.swap(nextFrontier);
+		++depth;
+	}
+	return 0;
+}
+
+//------------------------------------------------------------------------------------
+std::string vtkSlicerFacetedVisualizerLogic::GetPredicateListSQL(const std::vector< std::string > &predicates)
+{
+	std::string list = "";
+	for (unsigned int n = 0; n < predicates.size(); ++n)
+	{
+		char *quoted = vtk_sqlite3_mprintf("%s%Q", n > 0 ? ", " : "", predicates[n].c_str());
+		list += quoted;
+		vtk_sqlite3_free(quoted);
+	}
+	return list;
+}
+
+//------------------------------------------------------------------------------------
+// Computes the same display terms as the level-by-level traversal with one WITH RECURSIVE
+// statement. "reached" holds every term the traversal would expand; the rows whose subjects
+// are displayed are the seed rows and the recursion rows of the reached terms.
+int vtkSlicerFacetedVisualizerLogic::RecursiveProcessQueryCTE(std::string& queryTerm,
+		const std::string& Predicate, vtk_sqlite3* ptrDB, bool queryAsSubject,
+		vtkFacetedVisualizerBitSet &displayTerms)
+{
+	this->ToDBForm(queryTerm);
+	if(ptrDB == NULL)
+	{
+		return -1;
+	}
+	if(ptrDB != this->lookupStatementsDB)
+	{
+		this->FinalizeLookupStatements();
+		this->lookupStatementsDB = ptrDB;
+	}
+
+	vtk_sqlite3_stmt *&stmt = this->closureStatements[queryAsSubject ? 1 : 0];
+	bool &failed = this->closureStatementsFailed[queryAsSubject ? 1 : 0];
+	if(stmt == NULL && !failed)
+	{
+		std::string recursionList = this->GetPredicateListSQL(this->recursionPredicates);
+		std::string addRecursionList = this->GetPredicateListSQL(this->addRecursionPredicates);
+		std::string seedColumn = queryAsSubject ? "subject" : "object";
+		std::string nextColumn = queryAsSubject ? "object" : "subject";
+		std::string nextTerm = "(CASE WHEN r.subject = reached.term THEN r.object ELSE r.subject END)";
+
+		// tag 0 rows are the reached terms, tag 1 rows the subjects to display
+		std::string closureSQL =
+				"WITH RECURSIVE reached(term) AS ("
+				" SELECT " + nextColumn + " from resources where " + seedColumn + " = ?1 and predicate = ?2"
+				"  and " + nextColumn + " != ?1"
+				" UNION"
+				" SELECT " + nextTerm + " from reached, resources r"
+				"  where ((r.subject = reached.term and r.predicate IN (" + recursionList + "))"
+				"   or (r.object = reached.term and r.predicate IN (" + addRecursionList + ")))"
+				"  and " + nextTerm + " != ?1)"
+				" SELECT 0, term from reached"
+				" UNION ALL"
+				" SELECT 1, subject from ("
+				"  SELECT subject from resources where " + seedColumn + " = ?1 and predicate = ?2"
+				"  UNION"
+				"  SELECT r.subject from reached, resources r"
+				"   where r.subject = reached.term and r.predicate IN (" + recursionList + ")"
+				"  UNION"
+				"  SELECT r.subject from reached, resources r"
+				"   where r.object = reached.term and r.predicate IN (" + addRecursionList + "))";
+
+		const char *unused;
+		if(vtk_sqlite3_prepare_v2(ptrDB, closureSQL.c_str(), -1, &stmt, &unused) != VTK_SQLITE_OK)
+		{
+			// e.g. sqlite older than 3.8.3; warned once per connection
+			vtkWarningMacro("Could not prepare the closure statement, using the batched traversal: "
+					<< vtk_sqlite3_errmsg(ptrDB));
+			stmt = NULL;
+			failed = true;
+		}
+	}
+	if(failed)
+	{
+		int mode = this->traversalMode;
+		this->traversalMode = TraversalBatched;
+		int status = this->RecursiveProcessQuery(queryTerm, Predicate, ptrDB, queryAsSubject, displayTerms);
+		this->traversalMode = mode;
+		return status;
+	}
+
+	vtk_sqlite3_bind_text(stmt, 1, queryTerm.c_str(), -1, VTK_SQLITE_STATIC);
+	vtk_sqlite3_bind_text(stmt, 2, Predicate.c_str(), -1, VTK_SQLITE_STATIC);
+	std::vector< std::string > subjects;
+	unsigned int reachedTerms = 0;
+	while(vtk_sqlite3_step(stmt) == VTK_SQLITE_ROW)
+	{
+		const unsigned char *text = vtk_sqlite3_column_text(stmt, 1);
+		std::string term = text != NULL ? reinterpret_cast< const char* >(text) : "";
+		if(vtk_sqlite3_column_int(stmt, 0) == 0)
+		{
+			this->traversalVisited.insert(term);
+			++reachedTerms;
+		}
+		else
+		{
+			subjects.push_back(term);
+		}
+	}
+	vtk_sqlite3_reset(stmt);
+	vtk_sqlite3_clear_bindings(stmt);
+	this->AddQueryProfileStatements(1, reachedTerms + subjects.size());
+
+	if(subjects.size() == 0)
+	{
+		return -1;
+	}
+	vtkFacetedVisualizerDebugMacro(" closure of "<<queryTerm<<";"<<Predicate<<" reached "<<reachedTerms<<" terms");
+	for (unsigned int n = 0; n < subjects.size(); ++n)
+	{
+		this->AddDisplayTermsForDBTerm(subjects[n], ptrDB, displayTerms);
+	}
+	this->AddTraversalLevelStatistics(0, 1, subjects.size(), reachedTerms);
+	return 0;
+}
+
+//------------------------------------------------------------------------------------
+// The closure table only holds the seeds the query processing uses: a recursion predicate
+// with the term as subject or an inverse recursion predicate with the term as object
+bool vtkSlicerFacetedVisualizerLogic::IsClosurePredicate(const std::string& Predicate,
+		bool queryAsSubject)
+{
+	const std::vector< std::string > &predicates =
+			queryAsSubject ? this->recursionPredicates : this->addRecursionPredicates;
+	for (unsigned int n = 0; n < predicates.size(); ++n)
+	{
+		if(predicates[n] == Predicate)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+//------------------------------------------------------------------------------------
+int vtkSlicerFacetedVisualizerLogic::RecursiveProcessQueryClosureTable(std::string& queryTerm,
+		const std::string& Predicate, vtk_sqlite3* ptrDB, bool queryAsSubject,
+		vtkFacetedVisualizerBitSet &displayTerms)
+{
+	this->ToDBForm(queryTerm);
+	if(ptrDB == NULL)
+	{
+		return -1;
+	}
+	if(ptrDB != this->lookupStatementsDB)
+	{
+		this->FinalizeLookupStatements();
+		this->lookupStatementsDB = ptrDB;
+	}
+	if(this->closureTableStatement == NULL)
+	{
+		const char *sql = "SELECT descendant, depth from closure"
+				" where ancestor = ?1 and predicate_class = ?2 order by depth";
+		const char *unused;
+		if(vtk_sqlite3_prepare_v2(ptrDB, sql, -1, &this->closureTableStatement, &unused) != VTK_SQLITE_OK)
+		{
+			vtkWarningMacro("Could not read the closure table: " << vtk_sqlite3_errmsg(ptrDB));
+			this->closureTableStatement = NULL;
+			this->closureTableAvailable = false;
+			return this->RecursiveProcessQuery(queryTerm, Predicate, ptrDB, queryAsSubject, displayTerms);
+		}
+	}
+
+	vtk_sqlite3_stmt *stmt = this->closureTableStatement;
+	vtk_sqlite3_bind_text(stmt, 1, queryTerm.c_str(), -1, VTK_SQLITE_STATIC);
+	vtk_sqlite3_bind_text(stmt, 2, Predicate.c_str(), -1, VTK_SQLITE_STATIC);
+	std::vector< std::string > descendants;
+	std::vector< unsigned int > rowsPerDepth;
+	while(vtk_sqlite3_step(stmt) == VTK_SQLITE_ROW)
+	{
+		const unsigned char *text = vtk_sqlite3_column_text(stmt, 0);
+		descendants.push_back(text != NULL ? reinterpret_cast< const char* >(text) : "");
+		unsigned int depth = static_cast< unsigned int >(vtk_sqlite3_column_int(stmt, 1));
+		if(depth >= rowsPerDepth.size())
+		{
+			rowsPerDepth.resize(depth + 1, 0);
+		}
+		++rowsPerDepth[depth];
+	}
+	vtk_sqlite3_reset(stmt);
+	vtk_sqlite3_clear_bindings(stmt);
+	this->AddQueryProfileStatements(1, descendants.size());
+
+	if(descendants.size() == 0)
+	{
+		return -1;
+	}
+	vtkFacetedVisualizerDebugMacro(" closure table gives "<<descendants.size()<<" terms for "<<queryTerm<<";"<<Predicate);
+	for (unsigned int n = 0; n < descendants.size(); ++n)
+	{
+		this->AddDisplayTermsForDBTerm(descendants[n], ptrDB, displayTerms);
+	}
+	for (unsigned int depth = 0; depth < rowsPerDepth.size(); ++depth)
+	{
+		this->AddTraversalLevelStatistics(depth, depth == 0 ? 1 : 0, rowsPerDepth[depth], 0);
+	}
+	return 0;
+}
+
+//------------------------------------------------------------------------------------
+// Identifies the recursion predicates the closure table was built with
+std::string vtkSlicerFacetedVisualizerLogic::GetClosureSignature()
+{
+	std::string signature = "";
+	for (unsigned int n = 0; n < this->recursionPredicates.size(); ++n)
+	{
+		signature += this->recursionPredicates[n] + ",";
+	}
+	signature += ";";
+	for (unsigned int n = 0; n < this->addRecursionPredicates.size(); ++n)
+	{
+		signature += this->addRecursionPredicates[n] + ",";
+	}
+	return signature;
+}
+
+//------------------------------------------------------------------------------------
+// Fingerprint of the file the triples of an indexed sidecar were copied from, which the
+// closure build does not write. A table built in the DB file itself changes that file, its
+// triples are only checked by their number.
+std::string vtkSlicerFacetedVisualizerLogic::GetClosureSourceFingerprint()
+{
+	if(this->dbSessionFileName == this->dbFileName)
+	{
+		return "";
+	}
+	return vtkFacetedVisualizerPersistentCache::ComputeFileFingerprint(this->dbFileName);
+}
+
+//------------------------------------------------------------------------------------
+// The table is only used if it was built with the current recursion predicates from the
+// same triples: same number of triples and, for a sidecar, same source file
+bool vtkSlicerFacetedVisualizerLogic::HasClosureTable(vtk_sqlite3* ptrDB, bool &stale)
+{
+	stale = false;
+	if(ptrDB == NULL)
+	{
+		return false;
+	}
+	const char *sql = "SELECT predicates, triples, source_fingerprint, (SELECT count(*) from resources)"
+			" from fv_closure_info";
+	vtk_sqlite3_stmt *stmt;
+	const char *unused;
+	if(vtk_sqlite3_prepare_v2(ptrDB, sql, -1, &stmt, &unused) != VTK_SQLITE_OK)
+	{
+		// no closure table, or one built before the fingerprint was stored
+		stale = vtk_sqlite3_exec(ptrDB, "SELECT 1 from fv_closure_info", NULL, NULL, NULL) == VTK_SQLITE_OK;
+		return false;
+	}
+	bool valid = false;
+	if(vtk_sqlite3_step(stmt) == VTK_SQLITE_ROW)
+	{
+		const unsigned char *predicates = vtk_sqlite3_column_text(stmt, 0);
+		const unsigned char *fingerprint = vtk_sqlite3_column_text(stmt, 2);
+		valid = predicates != NULL && fingerprint != NULL &&
+				this->GetClosureSignature() == reinterpret_cast< const char* >(predicates) &&
+				vtk_sqlite3_column_int64(stmt, 1) == vtk_sqlite3_column_int64(stmt, 3) &&
+				this->GetClosureSourceFingerprint() == reinterpret_cast< const char* >(fingerprint);
+	}
+	vtk_sqlite3_finalize(stmt);
+	stale = !valid;
+	return valid;
+}
+
+//------------------------------------------------------------------------------------
+bool vtkSlicerFacetedVisualizerLogic::BuildClosureTable()
+{
+	this->CancelQuery();
+	vtk_sqlite3* ptrDB = this->GetDBSession();
+	if(ptrDB == NULL)
+	{
+		vtkErrorMacro("BuildClosureTable: no ontology DB is open");
+		return false;
+	}
+	if(this->dbSessionFileName == this->dbFileName && this->indexProvisioningMode != IndexInPlace)
+	{
+		vtkErrorMacro("BuildClosureTable: " << this->dbFileName << " is only written in the"
+				<< " IndexInPlace provisioning mode and there is no indexed sidecar");
+		return false;
+	}
+	// identifies the triples the table is built from, see HasClosureTable
+	std::string sourceFingerprint = this->GetClosureSourceFingerprint();
+
+	// the closure is walked on the in-memory store, loaded just for the build if not in use
+	bool loadedForBuild = !this->tripleStore->IsLoaded();
+	if(loadedForBuild && !this->tripleStore->Load(ptrDB))
+	{
+		vtkErrorMacro("BuildClosureTable: could not read the resources table");
+		return false;
+	}
+
+	// predicates that do not occur in this ontology get no ID and are left out of the walk
+	std::vector< int > recursionIds;
+	std::vector< int > addRecursionIds;
+	std::vector< int > walkRecursionIds;
+	std::vector< int > walkAddRecursionIds;
+	for (unsigned int n = 0; n < this->recursionPredicates.size(); ++n)
+	{
+		recursionIds.push_back(this->tripleStore->GetTermId(this->recursionPredicates[n]));
+		if(recursionIds.back() >= 0)
+		{
+			walkRecursionIds.push_back(recursionIds.back());
+		}
+	}
+	for (unsigned int n = 0; n < this->addRecursionPredicates.size(); ++n)
+	{
+		addRecursionIds.push_back(this->tripleStore->GetTermId(this->addRecursionPredicates[n]));
+		if(addRecursionIds.back() >= 0)
+		{
+			walkAddRecursionIds.push_back(addRecursionIds.back());
+		}
+	}
+
+	// the schema change invalidates every prepared statement
+	this->FinalizeLookupStatements();
+	this->closureTableAvailable = false;
+
+	const char *createSQL =
+			"BEGIN;"
+			"DROP TABLE IF EXISTS closure;"
+			"DROP TABLE IF EXISTS fv_closure_info;"
+			"CREATE TABLE closure(ancestor TEXT, descendant TEXT, predicate_class TEXT, depth INTEGER);";
+	char *errMsg = NULL;
+	vtk_sqlite3_stmt *insert = NULL;
+	const char *unused;
+	bool ok = vtk_sqlite3_exec(ptrDB, createSQL, NULL, NULL, &errMsg) == VTK_SQLITE_OK &&
+			vtk_sqlite3_prepare_v2(ptrDB, "INSERT INTO closure VALUES (?1, ?2, ?3, ?4)", -1,
+					&insert, &unused) == VTK_SQLITE_OK;
+
+	unsigned long rowsWritten = 0;
+	std::vector< int > descendants;
+	std::vector< int > depths;
+	unsigned int numberOfTerms = this->tripleStore->GetNumberOfTerms();
+	for (int seedDirection = 0; ok && seedDirection < 2; ++seedDirection)
+	{
+		bool asSubject = seedDirection == 0;
+		const std::vector< int > &seedPredicates = asSubject ? recursionIds : addRecursionIds;
+		const std::vector< std::string > &seedNames =
+				asSubject ? this->recursionPredicates : this->addRecursionPredicates;
+		for (unsigned int p = 0; ok && p < seedPredicates.size(); ++p)
+		{
+			if(seedPredicates[p] < 0)
+			{
+				// not used in this ontology
+				continue;
+			}
+			for (unsigned int term = 0; ok && term < numberOfTerms; ++term)
+			{
+				this->tripleStore->ComputeClosure(term, seedPredicates[p], asSubject,
+						walkRecursionIds, walkAddRecursionIds, descendants, depths);
+				for (unsigned int d = 0; ok && d < descendants.size(); ++d)
+				{
+					vtk_sqlite3_bind_text(insert, 1, this->tripleStore->GetTerm(term).c_str(), -1, VTK_SQLITE_STATIC);
+					vtk_sqlite3_bind_text(insert, 2, this->tripleStore->GetTerm(descendants[d]).c_str(), -1, VTK_SQLITE_STATIC);
+					vtk_sqlite3_bind_text(insert, 3, seedNames[p].c_str(), -1, VTK_SQLITE_STATIC);
+					vtk_sqlite3_bind_int(insert, 4, depths[d]);
+					ok = vtk_sqlite3_step(insert) == VTK_SQLITE_DONE;
+					vtk_sqlite3_reset(insert);
+					++rowsWritten;
+				}
+			}
+		}
+	}
+	if(insert != NULL)
+	{
+		vtk_sqlite3_finalize(insert);
+	}
+
+	if(ok)
+	{
+		char *infoSQL = vtk_sqlite3_mprintf(
+				"CREATE INDEX fv_closure_apd ON closure(ancestor, predicate_class, depth, descendant);"
+				"CREATE TABLE fv_closure_info(predicates TEXT, triples INTEGER, source_fingerprint TEXT);"
+				"INSERT INTO fv_closure_info VALUES (%Q, %u, %Q);"
+				"COMMIT;",
+				this->GetClosureSignature().c_str(), this->tripleStore->GetNumberOfTriples(),
+				sourceFingerprint.c_str());
+		ok = vtk_sqlite3_exec(ptrDB, infoSQL, NULL, NULL, &errMsg) == VTK_SQLITE_OK;
+		vtk_sqlite3_free(infoSQL);
+	}
+	if(!ok)
+	{
+		vtkErrorMacro("Could not build the closure table in " << this->dbSessionFileName << ": "
+				<< (errMsg ? errMsg : vtk_sqlite3_errmsg(ptrDB)));
+		vtk_sqlite3_exec(ptrDB, "ROLLBACK", NULL, NULL, NULL);
+	}
+	if(errMsg != NULL)
+	{
+		vtk_sqlite3_free(errMsg);
+	}
+
+	if(loadedForBuild && !this->GetInMemoryStoreInUse())
+	{
+		this->tripleStore->Clear();
+	}
+	if(this->dbSessionFileName == this->dbFileName)
+	{
+		// written by us, the session stays valid
+		this->dbSessionModifiedTime = vtksys::SystemTools::ModifiedTime(this->dbFileName.c_str());
+	}
+	if(ok)
+	{
+		vtkFacetedVisualizerInfoMacro(" closure table of "<<this->dbSessionFileName<<" built with "<<rowsWritten<<" rows");
+		this->closureTableAvailable = true;
+	}
+	return ok;
+}
+
+//------------------------------------------------------------------------------------
+// Expands a whole level of the traversal in one statement: the frontier goes into a temporary
+// table that is joined against resources for all recursion predicates. Returns the number of
+// rows or -1 if the statements could not be prepared.
+int vtkSlicerFacetedVisualizerLogic::ExpandFrontierBatched(std::vector< std::string > &frontier,
+		vtk_sqlite3* ptrDB, vtkFacetedVisualizerBitSet &displayTerms,
+		std::vector< std::string > &nextFrontier)
+{
+	if(ptrDB == NULL)
+	{
+		return -1;
+	}
+	if(ptrDB != this->lookupStatementsDB)
+	{
+		this->FinalizeLookupStatements();
+		this->lookupStatementsDB = ptrDB;
+	}
+	if(this->frontierExpandStatement == NULL)
+	{
+		char *errmsg;
+		if(vtk_sqlite3_exec(ptrDB, "CREATE TEMP TABLE IF NOT EXISTS fv_frontier(term TEXT PRIMARY KEY)",
+				NULL, NULL, &errmsg) != VTK_SQLITE_OK)
+		{
+			vtkWarningMacro("Could not create the frontier table: " << errmsg);
+			vtk_sqlite3_free(errmsg);
+			return -1;
+		}
+
+		std::string recursionList = this->GetPredicateListSQL(this->recursionPredicates);
+		std::string addRecursionList = this->GetPredicateListSQL(this->addRecursionPredicates);
+		// the last column tells whether the frontier term is the subject of the row
+		std::string expandSQL =
+				"SELECT r.subject, r.predicate, r.object, 1 from fv_frontier f, resources r "
+				"where r.subject = f.term and r.predicate IN (" + recursionList + ") "
+				"UNION ALL "
+				"SELECT r.subject, r.predicate, r.object, 0 from fv_frontier f, resources r "
+				"where r.object = f.term and r.predicate IN (" + addRecursionList + ")";
+
+		const char *unused;
+		if(vtk_sqlite3_prepare_v2(ptrDB, "INSERT OR IGNORE INTO fv_frontier VALUES(?1)", -1,
+				&this->frontierInsertStatement, &unused) != VTK_SQLITE_OK ||
+		   vtk_sqlite3_prepare_v2(ptrDB, expandSQL.c_str(), -1,
+				&this->frontierExpandStatement, &unused) != VTK_SQLITE_OK)
+		{
+			vtkWarningMacro("Could not prepare the frontier statements: " << vtk_sqlite3_errmsg(ptrDB));
+			this->FinalizeLookupStatements();
+			return -1;
+		}
+	}
+
+	// a frontier table that was only partly filled would silently drop terms of the level
+	char *errmsg = NULL;
+	bool begun = vtk_sqlite3_exec(ptrDB, "BEGIN", NULL, NULL, &errmsg) == VTK_SQLITE_OK;
+	bool filled = begun && vtk_sqlite3_exec(ptrDB, "DELETE FROM fv_frontier", NULL, NULL, &errmsg) == VTK_SQLITE_OK;
+	for (unsigned int n = 0; filled && n < frontier.size(); ++n)
+	{
+		std::string term = frontier[n];
+		this->ToDBForm(term);
+		vtk_sqlite3_bind_text(this->frontierInsertStatement, 1, term.c_str(), -1, VTK_SQLITE_STATIC);
+		filled = vtk_sqlite3_step(this->frontierInsertStatement) == VTK_SQLITE_DONE;
+		vtk_sqlite3_reset(this->frontierInsertStatement);
+	}
+	filled = filled && vtk_sqlite3_exec(ptrDB, "COMMIT", NULL, NULL, &errmsg) == VTK_SQLITE_OK;
+	if(!filled)
+	{
+		vtkWarningMacro("Could not fill the frontier table: "
+				<< (errmsg != NULL ? errmsg : vtk_sqlite3_errmsg(ptrDB)));
+		vtk_sqlite3_free(errmsg);
+		if(begun)
+		{
+			// a failed COMMIT leaves the transaction open as well
+			vtk_sqlite3_exec(ptrDB, "ROLLBACK", NULL, NULL, NULL);
+		}
+		return -1;
+	}
+
+	std::vector< std::vector< std::string > > subjectRows;
+	std::vector< std::vector< std::string > > objectRows;
+	while(vtk_sqlite3_step(this->frontierExpandStatement) == VTK_SQLITE_ROW)
+	{
+		std::vector< std::string > row(3);
+		for (int nc = 0; nc < 3; ++nc)
+		{
+			const unsigned char *text = vtk_sqlite3_column_text(this->frontierExpandStatement, nc);
+			if(text != NULL)
+			{
+				row[nc] = reinterpret_cast< const char* >(text);
+			}
+		}
+		if(vtk_sqlite3_column_int(this->frontierExpandStatement, 3) != 0)
+		{
+			subjectRows.push_back(row);
+		}
+		else
+		{
+			objectRows.push_back(row);
+		}
+	}
+	vtk_sqlite3_reset(this->frontierExpandStatement);
+	// the inserts, BEGIN, DELETE, COMMIT and the expansion
+	this->AddQueryProfileStatements(frontier.size() + 4, subjectRows.size() + objectRows.size());
+
+	this->ProcessTraversalRows(subjectRows, true, ptrDB, displayTerms, nextFrontier);
+	this->ProcessTraversalRows(objectRows, false, ptrDB, displayTerms, nextFrontier);
+	return subjectRows.size() + objectRows.size();
+}
+
+//------------------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::AddTraversalLevelStatistics(unsigned int depth,
+		unsigned int terms, unsigned int rows, unsigned int newTerms)
+{
+	if(depth >= this->traversalStatistics.size())
+	{
+		TraversalLevelStatistics empty;
+		empty.Terms = 0;
+		empty.Rows = 0;
+		empty.NewTerms = 0;
+		this->traversalStatistics.resize(depth+1, empty);
+	}
+	this->traversalStatistics[depth].Terms += terms;
+	this->traversalStatistics[depth].Rows += rows;
+	this->traversalStatistics[depth].NewTerms += newTerms;
+}
+
+//------------------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::ResetQueryProfile(const std::string &queryText)
+{
+	this->lastQueryProfile = QueryProfile();
+	this->lastQueryProfile.Query = queryText;
+	this->profileCategory = NULL;
+}
+
+//------------------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::AddQueryProfileStatements(unsigned long statements,
+		unsigned long rows)
+{
+	if(this->queryProfiling)
+	{
+		this->lastQueryProfile.SQLStatements += statements;
+		this->lastQueryProfile.RowsFetched += rows;
+	}
+}
+
+//------------------------------------------------------------------------------------
+// one line per step of the plan, the operands indented below their operation
+static void PrintQueryProfileStep(ostream& os,
+		const vtkSlicerFacetedVisualizerLogic::QueryProfile &profile, int index, int depth)
+{
+	static const char *operations[] = { "TERM", "UNION", "INTERSECT", "DIFFERENCE", "NOT" };
+	static const char *sources[] = { "result cache", "persistent cache", "traversal", "skipped" };
+
+	const vtkFacetedVisualizerQueryPlan::Step &step = profile.Plan.GetStep(index);
+	os<<std::string(2 * depth + 1, ' ');
+	if(step.Type == vtkFacetedVisualizerQueryPlan::TermStep)
+	{
+		const vtkSlicerFacetedVisualizerLogic::QueryProfileTerm &term = profile.Terms[step.Term];
+		os<<"\""<<profile.Plan.GetTerm(step.Term)<<"\"  cost "<<term.EstimatedCost
+				<<", "<<sources[term.Source]<<", "<<term.DisplayTerms<<" models, "
+				<<term.Time * 1000.0<<" ms"<<std::endl;
+		return;
+	}
+	os<<operations[step.Type]<<"  cost "<<profile.StepCosts[index]<<std::endl;
+	for (unsigned n = 0; n < step.Operands.size(); n++)
+	{
+		PrintQueryProfileStep(os, profile, step.Operands[n], depth + 1);
+	}
+}
+
+//------------------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::PrintLastQueryProfile(ostream& os)
+{
+	const QueryProfile &profile = this->lastQueryProfile;
+	os<<"query: "<<profile.Query<<std::endl;
+	if(!profile.Plan.IsValid())
+	{
+		os<<" no plan"<<std::endl;
+		return;
+	}
+	os<<"plan:"<<std::endl;
+	PrintQueryProfileStep(os, profile, profile.Plan.GetRootStep(), 0);
+
+	os<<"SQL statements: "<<profile.SQLStatements<<", in-memory lookups: "<<profile.StoreLookups
+			<<", rows fetched: "<<profile.RowsFetched<<std::endl;
+	os<<"result cache: "<<profile.ResultCacheHits<<" hits, "<<profile.ResultCacheMisses
+			<<" misses; persistent cache: "<<profile.PersistentCacheHits<<" hits"<<std::endl;
+	for (unsigned d = 0; d < profile.Levels.size(); ++d)
+	{
+		os<<"traversal depth "<<d<<": "<<profile.Levels[d].Terms<<" terms, "
+				<<profile.Levels[d].Rows<<" rows, "<<profile.Levels[d].NewTerms<<" new terms"<<std::endl;
+	}
+	os<<"time (ms): planning "<<profile.PlanningTime * 1000.0
+			<<", resolution "<<profile.ResolutionTime * 1000.0
+			<<", traversal "<<profile.TraversalTime * 1000.0
+			<<", caches "<<profile.CacheTime * 1000.0
+			<<", formatting "<<profile.FormattingTime * 1000.0
+			<<", display "<<profile.DisplayTime * 1000.0
+			<<", total "<<(profile.EvaluationTime + profile.DisplayTime) * 1000.0<<std::endl;
+}
+
+
+//----------------------------------------------------------------------------------------------
+int vtkSlicerFacetedVisualizerLogic::ProcessSingleQuery(std::string& query, vtk_sqlite3* ptrDB,
+		vtkFacetedVisualizerOrderedSet &queryResults, vtkFacetedVisualizerBitSet &displayTerms)
+{
+
+	// first check if its a two-part query
+	size_t pos = query.find(";");
+	bool twoPartQuery = pos != std::string::npos;
+	std::string firstPart = query;
+	std::string secondPart = "";
+	vtkFacetedVisualizerDebugMacro(" query is "<<query);
+	if(twoPartQuery)
+	{
+	  firstPart = query.substr(0, pos);
+	  secondPart = query.substr(pos+1);
+
+	}
+	else
+	{
+		//std::map< std::string, std::string > ::iterator mrmlIt = mrmlDBTerms.find(this->GetDBSubject(firstPart, ptrDB));
+		std::pair< std::multimap< std::string, std::string >::iterator,
+					          std::multimap< std::string, std::string > ::iterator > mrmlIt;
+		mrmlIt = mrmlDBTerms.equal_range(this->GetDBSubject(firstPart, ptrDB));
+		std::multimap< std::string, std::string >::iterator itr1 = mrmlIt.first;
+		std::multimap<std::string, std::string>::iterator itr2 = mrmlIt.second;
+
+		if(itr1 != mrmlDBTerms.end())
+		{
+			std::multimap<std::string, std::string>::iterator itr3;
+			for(itr3 = itr1; itr3 != itr2; ++itr3)
+			{
+				displayTerms.Set(this->GetDisplayCandidateIndex(itr3->second));
+			}
+		}
+	}
+
+	if(!twoPartQuery)
+	{
+		// search the local db for non-DataBase queries (Examples: "mass", "tumor" models added to the scene by the user
+		bool found = false;
+		int indx = 0;
+		for (unsigned int l = 0; !found && l < nonDBElements.GetNumberOfValues(); l++)
+		{
+			std::string lqdb;
+			std::string lqQ;
+			this->toLower(nonDBElements.GetValue(l), lqdb);
+			this->toLower(query, lqQ);
+			found = lqdb == lqQ;
+			indx = l;
+		}
+		if(found)
+		{
+			displayTerms.Set(this->GetDisplayCandidateIndex(nonDBElements.GetValue(indx)));
+			return 0;
+		}
+	}
+  if(!this->setValidDBFileName)
+  {
+    return -1;
+  }
+
+	// if there is a second part to the query we need a more refined search
+	if(secondPart != "")
+	{
+			std::string subject = this->GetDBSubject(firstPart, ptrDB);
+			if(subject == "null")
+			{
+				return -1;
+			}
+			RecursiveProcessQuery(subject, secondPart, ptrDB, true, displayTerms);
+		std::vector< std::vector< std::string > > rows;
+		int nrows = this->ExecuteLookup(subject, false, true, secondPart, ptrDB, rows);
+		if(nrows <= 0)
+		{
+			return -1;
+		}
+		vtkFacetedVisualizerOrderedSet relations;
+		for (int nr = 0; nr < nrows; ++nr)
+		{
+			std::vector< std::string> &term = rows[nr];
+			// test if this is a ignore predicate
+			bool addToResults = true;
+
+			for (unsigned np= 0; addToResults && np < ignorePredicates.size(); ++np)
+			{
+				std::string lstr;
+				this->toLower(term[1], lstr);
+				addToResults = ignorePredicates[np] == lstr ? false : true; //std::strcmp(ignorePredicates,lstr) == 0;
+			}
+			if(addToResults)
+			{
+				// check if this is a recursion Predicate. In this case we keep the whole term for display
+				bool isRecursionPredicate = false;
+				for (unsigned c = 0; !isRecursionPredicate && c < recursionPredicates.size(); ++c)
+				{
+					isRecursionPredicate = recursionPredicates[c] == term[1] && term[1] != secondPart;
+				}
+				for (unsigned c = 0; !isRecursionPredicate && c < addRecursionPredicates.size(); ++c)
+				{
+					isRecursionPredicate = addRecursionPredicates[c] == term[1];
+				}
+				if(!isRecursionPredicate)
+				{
+					if(term[1] == secondPart)
+					{
+						std::string tmpstr = term[0]+";"+term[2];
+						queryResults.Insert(tmpstr);
+					}
+						// check if its a comment predicate
+					bool isCommentPredicate = false;
+					for (unsigned c = 0; !isCommentPredicate && c < commentPredicates.size(); ++c)
+					{
+						isCommentPredicate = commentPredicates[c] == term[1];
+					}
+					if(isCommentPredicate)
+					{
+						std::string tmpstr = term[0] +";comment;"+term[2];
+						queryResults.Insert(tmpstr);
+					}
+
+				}
+			}
+		}
+
+	}
+	else
+	{
+	   // there is no second part to the query
+	   // for display, we only need to check the recursion predicates
+	   std::string subject = this->GetDBSubject(firstPart, ptrDB);
+	   for (unsigned n = 0; n < recursionPredicates.size(); ++n)
+	   {
+		    std::string tmpstr = subject+";"+recursionPredicates[n];
+		    vtkFacetedVisualizerDebugMacro(" re-process as two-part query "<<tmpstr);
+			ProcessSingleQuery(tmpstr, ptrDB, queryResults, displayTerms);
+	   }
+	   for (unsigned n = 0; n < addRecursionPredicates.size(); ++n)
+	   {
+		   RecursiveProcessQuery(subject, addRecursionPredicates[n], ptrDB, false, displayTerms);
+	   }
+		// get all the predicates related to this query from the DB without recursion
+		std::vector< std::vector< std::string > > rows;
+		int nrows = this->ExecuteLookup(subject, false, true, "", ptrDB, rows);
+		if(nrows <= 0)
+		{
+			return -1;
+		}
+		vtkFacetedVisualizerOrderedSet relations;
+		for (int nr = 0; nr < nrows; ++nr)
+		{
+			std::vector< std::string> &term = rows[nr];
+			// test if this is a ignore predicate
+			bool addToResults = true;
+
+			for (unsigned np= 0; addToResults && np < ignorePredicates.size(); ++np)
+			{
+				std::string lstr;
+				this->toLower(term[1], lstr);
+				addToResults = ignorePredicates[np] == lstr ? false : true; //std::strcmp(ignorePredicates,lstr) == 0;
+			}
+			if(addToResults)
+			{
+				// check if this is a recursion Predicate. In this case we keep the whole term for display
+				bool isRecursionPredicate = false;
+				for (unsigned c = 0; !isRecursionPredicate && c < recursionPredicates.size(); ++c)
+				{
+					isRecursionPredicate = recursionPredicates[c] == term[1];
+				}
+				for (unsigned c = 0; !isRecursionPredicate && c < addRecursionPredicates.size(); ++c)
+				{
+					isRecursionPredicate = addRecursionPredicates[c] == term[1];
+				}
+				if(!isRecursionPredicate)
+				{
+						// check if its a comment predicate
+					bool isCommentPredicate = false;
+					for (unsigned c = 0; !isCommentPredicate && c < commentPredicates.size(); ++c)
+					{
+						isCommentPredicate = commentPredicates[c] == term[1];
+					}
+					if(isCommentPredicate)
+					{
+						std::string tmpstr = term[0] +";comment;"+term[2];
+						queryResults.Insert(tmpstr);
+					}
+					else
+					{
+						std::string tmpstr = term[0] + ";" + term[1];
+						relations.Insert(tmpstr);
+					}
+				}
+			}
+		}
+		// now construct terms using the relations and add to queryResult
+		for (unsigned r = 0; r < relations.GetNumberOfValues(); r++)
+		{
+			queryResults.Insert(relations.GetValue(r));
+		}
+	}
+
+	vtkFacetedVisualizerDebugMacro(" query "<<firstPart<<"; secondPart "<<queryResults.GetNumberOfValues());
+
+	return 0;
+}
+
+
+//-----------------------------------------------------------------------------------------
+// Evaluates one term of a query into the display candidates of its models, from the result
+// caches if they have it. If listResults, its results are added to the ones GetQueryResults
+// returns. Returns the status of ProcessSingleQuery and sets source to where the result
+// came from (QueryTermFromResultCache, ...).
+// A term "first;second" whose second part is a subject of the DB stands for that subject,
+// otherwise for the first part with the second as predicate
+std::string vtkSlicerFacetedVisualizerLogic::ResolveQueryTerm(const std::string &term, vtk_sqlite3* ptrDB)
+{
+	size_t pos = term.find(";");
+	if(pos != std::string::npos && this->setValidDBFileName)
+	{
+		QueryProfileTimer timer(this, &this->lastQueryProfile.ResolutionTime);
+		std::string secondPart = term.substr(pos+1);
+		std::vector< std::vector< std::string > > rows;
+		int numrows = this->ExecuteLookup(secondPart, false, true, "", ptrDB, rows);
+		if(numrows > 0)
+		{
+			return secondPart;
+		}
+	}
+	return term;
+}
+
+//-----------------------------------------------------------------------------------------
+int vtkSlicerFacetedVisualizerLogic::EvaluateQueryTerm(const std::string &term, vtk_sqlite3* ptrDB,
+		bool listResults, vtkFacetedVisualizerBitSet &displayTerms, int &source)
+{
+	vtkFacetedVisualizerOrderedSet queryResults;
+	std::string q = this->ResolveQueryTerm(term, ptrDB);
+
+	displayTerms.Resize(this->displayCandidates.size());
+	displayTerms.Clear();
+	std::string cacheKey = this->GetCanonicalQueryKey(q, ptrDB);
+	std::vector< std::string > cachedResults;
+	int status;
+	std::vector< std::string > displayNames;
+	QueryProfileTimer cacheTimer(this, &this->lastQueryProfile.CacheTime);
+	vtkFacetedVisualizerPersistentCache *persistent = this->GetPersistentCache();
+	if(this->resultCache->Lookup(cacheKey, status, cachedResults, displayTerms))
+	{
+		source = QueryTermFromResultCache;
+		queryResults.Assign(cachedResults);
+	}
+	else if(persistent != NULL && persistent->Lookup(cacheKey, status, cachedResults, displayNames))
+	{
+		source = QueryTermFromPersistentCache;
+		queryResults.Assign(cachedResults);
+		for (unsigned int d = 0; d < displayNames.size(); ++d)
+		{
+			displayTerms.Set(this->GetDisplayCandidateIndex(displayNames[d]));
+		}
+		this->resultCache->Insert(cacheKey, status, cachedResults, displayTerms);
+	}
+	else
+	{
+		source = QueryTermFromTraversal;
+		this->traversalVisited.clear();
+		{
+			QueryProfileTimer traversalTimer(this, &this->lastQueryProfile.TraversalTime);
+			status = ProcessSingleQuery(q, ptrDB, queryResults, displayTerms);
+		}
+		if(this->IsQueryCancelled())
+		{
+			// the traversal stopped part way, nothing of it may be cached
+			return status;
+		}
+		this->resultCache->Insert(cacheKey, status, queryResults.GetValues(), displayTerms);
+		if(persistent != NULL)
+		{
+			for (int d = displayTerms.NextSetBit(0); d >= 0; d = displayTerms.NextSetBit(d + 1))
+			{
+				displayNames.push_back(this->displayCandidates[d]);
+			}
+			persistent->Store(cacheKey, status, queryResults.GetValues(), displayNames);
+		}
+	}
+
+	QueryProfileTimer formattingTimer(this, &this->lastQueryProfile.FormattingTime);
+	for (unsigned i = 0; listResults && i < queryResults.GetNumberOfValues(); ++i)
+	{
+		const std::string &result = queryResults.GetValue(i);
+		size_t pos = result.find(";");
+		size_t p1 = q.find(";");
+		if(p1 != std::string::npos)
+		{
+		   std::string tmpstr = q.substr(0,p1)+"-"+q.substr(p1+1)+result.substr(pos);
+		   resultsForDisplay.push_back(tmpstr);
+		}
+		else
+		{
+		  std::string tmpstr = q+result.substr(pos);
+		  resultsForDisplay.push_back(tmpstr);
+		}
+	}
+
+	return status;
+}
+
+//-----------------------------------------------------------------------------------------
+// State of the evaluation of a query plan
+struct vtkSlicerFacetedVisualizerLogic::QueryEvaluation
+{
+	const vtkFacetedVisualizerQueryPlan       *Plan;
+	vtk_sqlite3                               *DB;
+	// estimated number of rows the traversal reads for each step
+	std::vector< double >                      StepCosts;
+	std::vector< vtkFacetedVisualizerBitSet >  TermSets;
+	std::vector< bool >                        TermEvaluated;
+	unsigned int                               NumberOfEvaluatedTerms;
+};
+
+//-----------------------------------------------------------------------------------------
+namespace
+{
+struct StepCostLess
+{
+	const std::vector< double > *Costs;
+
+	bool operator()(int a, int b) const
+	{
+		return (*this->Costs)[a] < (*this->Costs)[b];
+	}
+};
+}
+
+//-----------------------------------------------------------------------------------------
+// Number of rows of each predicate and of distinct subjects of the resources table, the
+// statistics the costs of query terms are estimated from
+void vtkSlicerFacetedVisualizerLogic::LoadPredicateStatistics(vtk_sqlite3* ptrDB)
+{
+	this->predicateRows.clear();
+	this->numberOfDBRows = 0;
+	this->numberOfDBSubjects = 0;
+	if(ptrDB == NULL)
+	{
+		return;
+	}
+	vtk_sqlite3_stmt *stmt;
+	const char *unused;
+	if(vtk_sqlite3_prepare_v2(ptrDB, "SELECT predicate, count(*) from resources group by predicate",
+			-1, &stmt, &unused) == VTK_SQLITE_OK)
+	{
+		while(vtk_sqlite3_step(stmt) == VTK_SQLITE_ROW)
+		{
+			const unsigned char *predicate = vtk_sqlite3_column_text(stmt, 0);
+			double rows = vtk_sqlite3_column_double(stmt, 1);
+			if(predicate != NULL)
+			{
+				this->predicateRows[reinterpret_cast< const char* >(predicate)] = rows;
+			}
+			this->numberOfDBRows += rows;
+		}
+		vtk_sqlite3_finalize(stmt);
+	}
+	if(vtk_sqlite3_prepare_v2(ptrDB, "SELECT count(DISTINCT subject) from resources",
+			-1, &stmt, &unused) == VTK_SQLITE_OK)
+	{
+		if(vtk_sqlite3_step(stmt) == VTK_SQLITE_ROW)
+		{
+			this->numberOfDBSubjects = vtk_sqlite3_column_double(stmt, 0);
+		}
+		vtk_sqlite3_finalize(stmt);
+	}
+	vtkFacetedVisualizerInfoMacro(" predicate statistics: "<<this->predicateRows.size()<<" predicates, "
+			<<this->numberOfDBRows<<" rows, "<<this->numberOfDBSubjects<<" subjects");
+}
+
+//-----------------------------------------------------------------------------------------
+// Average number of rows a term has with the predicate
+double vtkSlicerFacetedVisualizerLogic::GetPredicateFanOut(const std::string& predicate)
+{
+	if(this->numberOfDBSubjects <= 0)
+	{
+		return 1.0;
+	}
+	vtksys::hash_map< std::string, double >::iterator it = this->predicateRows.find(predicate);
+	return it == this->predicateRows.end() ? 0.0 : it->second / this->numberOfDBSubjects;
+}
+
+//-----------------------------------------------------------------------------------------
+// Estimated number of rows the evaluation of a term reads: none if it is cached or not a
+// DB term, otherwise the rows of the hierarchy below the term. The first level is counted
+// on the in-memory store when it is loaded, deeper levels grow by the average fan-out of
+// the recursion predicates.
+double vtkSlicerFacetedVisualizerLogic::EstimateQueryTermCost(const std::string& term, vtk_sqlite3* ptrDB)
+{
+	std::string key = this->GetCanonicalQueryKey(this->ResolveQueryTerm(term, ptrDB), ptrDB);
+	if(key.compare(0, 3, "db:") != 0 || this->resultCache->Contains(key))
+	{
+		return 0.0;
+	}
+	size_t pos = key.find(";");
+	std::string subject = key.substr(3, pos == std::string::npos ? std::string::npos : pos - 3);
+	std::vector< std::string > predicates;
+	if(pos != std::string::npos)
+	{
+		predicates.push_back(key.substr(pos + 1));
+	}
+	else
+	{
+		predicates = this->recursionPredicates;
+		predicates.insert(predicates.end(), this->addRecursionPredicates.begin(),
+				this->addRecursionPredicates.end());
+	}
+
+	double branching = 0.0;
+	for (unsigned int n = 0; n < this->recursionPredicates.size(); ++n)
+	{
+		branching += this->GetPredicateFanOut(this->recursionPredicates[n]);
+	}
+	int subjectId = this->tripleStore->IsLoaded() ? this->tripleStore->GetTermId(subject) : -1;
+	std::vector< int > objects;
+	// the lookup of the term itself, which reads all its rows without a predicate
+	double cost = 1.0;
+	if(pos == std::string::npos)
+	{
+		cost += this->numberOfDBRows / std::max(this->numberOfDBSubjects, 1.0);
+	}
+	for (unsigned int n = 0; n < predicates.size(); ++n)
+	{
+		double level = this->GetPredicateFanOut(predicates[n]);
+		int predicateId = subjectId >= 0 ? this->tripleStore->GetTermId(predicates[n]) : -1;
+		if(predicateId >= 0)
+		{
+			objects.clear();
+			this->tripleStore->GetObjects(subjectId, predicateId, objects);
+			level = static_cast< double >(objects.size());
+		}
+		// geometric growth over the levels of the hierarchy
+		for (int depth = 0; depth < MaximumEstimatedDepth && level >= 0.01; ++depth)
+		{
+			cost += level;
+			level *= branching;
+		}
+	}
+	return std::min(cost, std::max(this->numberOfDBRows, 1.0));
+}
+
+//-----------------------------------------------------------------------------------------
+// The cost of a set operation is the sum of the costs of its operands, as they may all
+// have to be evaluated
+void vtkSlicerFacetedVisualizerLogic::EstimateQueryPlanCosts(QueryEvaluation &evaluation)
+{
+	const vtkFacetedVisualizerQueryPlan &plan = *evaluation.Plan;
+	evaluation.StepCosts.assign(plan.GetNumberOfSteps(), 0.0);
+	for (unsigned int n = 0; n < plan.GetNumberOfSteps(); ++n)
+	{
+		const vtkFacetedVisualizerQueryPlan::Step &step = plan.GetStep(n);
+		if(step.Type == vtkFacetedVisualizerQueryPlan::TermStep)
+		{
+			evaluation.StepCosts[n] = this->EstimateQueryTermCost(plan.GetTerm(step.Term), evaluation.DB);
+			vtkFacetedVisualizerDebugMacro(" estimated cost of "<<plan.GetTerm(step.Term)<<": "<<evaluation.StepCosts[n]
+					<<" rows");
+		}
+		for (unsigned int o = 0; o < step.Operands.size(); ++o)
+		{
+			evaluation.StepCosts[n] += evaluation.StepCosts[step.Operands[o]];
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------------------
+// Evaluates a step of the plan, its operands first. Intersections evaluate the cheapest
+// operand first and stop once the intersection is empty; a difference skips its right
+// side when the left one is empty. Unions keep the typed order, which is the order of
+// the results tree, since all their operands are needed anyway.
+void vtkSlicerFacetedVisualizerLogic::EvaluateQueryStep(QueryEvaluation &evaluation, int stepIndex,
+		vtkFacetedVisualizerBitSet &result)
+{
+	const vtkFacetedVisualizerQueryPlan &plan = *evaluation.Plan;
+	const vtkFacetedVisualizerQueryPlan::Step &step = plan.GetStep(stepIndex);
+	result.Resize(this->displayCandidates.size());
+	result.Clear();
+	if(step.Type == vtkFacetedVisualizerQueryPlan::TermStep)
+	{
+		if(!evaluation.TermEvaluated[step.Term])
+		{
+			std::string q = plan.GetTerm(step.Term);
+			vtkFacetedVisualizerBitSet &termSet = evaluation.TermSets[step.Term];
+			QueryProfileTerm &termProfile = this->lastQueryProfile.Terms[step.Term];
+			double startTime = this->queryProfiling ? vtkTimerLog::GetUniversalTime() : 0.0;
+			int status = this->EvaluateQueryTerm(q, evaluation.DB, plan.IsTermListed(step.Term), termSet,
+					termProfile.Source);
+			vtkFacetedVisualizerDebugMacro(" number of display terms "<<termSet.Count());
+			if(status != 0)
+			{
+				termSet.Clear();
+			}
+			termProfile.DisplayTerms = termSet.Count();
+			if(this->queryProfiling)
+			{
+				termProfile.Time = vtkTimerLog::GetUniversalTime() - startTime;
+			}
+			evaluation.TermEvaluated[step.Term] = true;
+			++evaluation.NumberOfEvaluatedTerms;
+			this->SetQueryProgress(static_cast< double >(evaluation.NumberOfEvaluatedTerms) /
+					plan.GetNumberOfTerms());
+		}
+		result = evaluation.TermSets[step.Term];
+		return;
+	}
+
+	std::vector< int > operands = step.Operands;
+	if(step.Type == vtkFacetedVisualizerQueryPlan::IntersectStep)
+	{
+		StepCostLess less;
+		less.Costs = &evaluation.StepCosts;
+		std::stable_sort(operands.begin(), operands.end(), less);
+	}
+	vtkFacetedVisualizerBitSet operand;
+	for (size_t n = 0; n < operands.size() && !this->IsQueryCancelled(); ++n)
+	{
+		if(n > 0 && !result.Any() && step.Type != vtkFacetedVisualizerQueryPlan::UnionStep)
+		{
+			// nothing left to intersect with or subtract from
+			break;
+		}
+		this->EvaluateQueryStep(evaluation, operands[n], n == 0 ? result : operand);
+		if(n == 0)
+		{
+			continue;
+		}
+		if(step.Type == vtkFacetedVisualizerQueryPlan::UnionStep)
+		{
+			result.Union(operand);
+		}
+		else if(step.Type == vtkFacetedVisualizerQueryPlan::IntersectStep)
+		{
+			result.Intersect(operand);
+		}
+		else
+		{
+			result.Subtract(operand);
+		}
+	}
+	if(step.Type == vtkFacetedVisualizerQueryPlan::ComplementStep)
+	{
+		vtkFacetedVisualizerBitSet all(this->displayCandidates.size());
+		for (unsigned int d = 0; d < this->displayCandidates.size(); ++d)
+		{
+			all.Set(d);
+		}
+		all.Subtract(result);
+		result = all;
+	}
+}
+
+//-----------------------------------------------------------------------------------------
+// Returns the compiled plan of a query, compiling it the first time
+const vtkFacetedVisualizerQueryPlan& vtkSlicerFacetedVisualizerLogic::GetQueryPlan(const std::string &queryText)
+{
+	vtksys::hash_map< std::string, vtkFacetedVisualizerQueryPlan >::iterator it = this->queryPlans.find(queryText);
+	if(it != this->queryPlans.end())
+	{
+		return it->second;
+	}
+	if(this->queryPlans.size() >= this->queryPlansMaximumSize)
+	{
+		this->queryPlans.clear();
+	}
+	vtkFacetedVisualizerQueryPlan &plan = this->queryPlans[queryText];
+	plan.Compile(queryText);
+	return plan;
+}
+
+// to do: need to deal with non-DB queries such as "tumor", "mass" coming from user segmented
+// models added to the scene.
+//-----------------------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic
+::ComputeQueryResults(const std::string &queryText,
+		vtkFacetedVisualizerBitSet &queryDisplayResults)
+{
+	this->SyncPendingNodes();
+    // construct a query for the database
+	vtk_sqlite3 *ptrDB = this->GetDBSession();
+	this->setValidDBFileName = ptrDB != NULL;
+	this->ComputeQueryResults(queryText, ptrDB, queryDisplayResults);
+}
+
+//-----------------------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic
+::ComputeQueryResults(const std::string &queryText, vtk_sqlite3* ptrDB,
+		vtkFacetedVisualizerBitSet &queryDisplayResults)
+{
+	resultsForDisplay.clear();
+	this->traversalStatistics.clear();
+
+	double startTime = this->queryProfiling ? vtkTimerLog::GetUniversalTime() : 0.0;
+	this->ResetQueryProfile(queryText);
+	QueryProfile &profile = this->lastQueryProfile;
+	unsigned long resultCacheHits = this->resultCache->GetNumberOfHits();
+	unsigned long resultCacheMisses = this->resultCache->GetNumberOfMisses();
+	unsigned long persistentCacheHits = this->persistentCache->GetNumberOfHits();
+
+	queryDisplayResults.Clear();
+	QueryEvaluation evaluation;
+	{
+		QueryProfileTimer timer(this, &profile.PlanningTime);
+		const vtkFacetedVisualizerQueryPlan &plan = this->GetQueryPlan(queryText);
+		this->queryError = plan.GetError();
+		if(!plan.IsValid())
+		{
+			vtkWarningMacro("Invalid query \"" << queryText << "\": " << plan.GetError());
+			return;
+		}
+		evaluation.Plan = &plan;
+		evaluation.DB = ptrDB;
+		evaluation.TermSets.resize(plan.GetNumberOfTerms());
+		evaluation.TermEvaluated.resize(plan.GetNumberOfTerms(), false);
+		evaluation.NumberOfEvaluatedTerms = 0;
+		this->EstimateQueryPlanCosts(evaluation);
+	}
+	const vtkFacetedVisualizerQueryPlan &plan = *evaluation.Plan;
+	profile.Plan = plan;
+	profile.StepCosts = evaluation.StepCosts;
+	profile.Terms.resize(plan.GetNumberOfTerms());
+	for (unsigned n = 0; n < plan.GetNumberOfSteps(); n++)
+	{
+		if(plan.GetStep(n).Type == vtkFacetedVisualizerQueryPlan::TermStep)
+		{
+			QueryProfileTerm &term = profile.Terms[plan.GetStep(n).Term];
+			term.EstimatedCost = evaluation.StepCosts[n];
+			term.Source = QueryTermSkipped;
+			term.DisplayTerms = 0;
+			term.Time = 0.0;
+		}
+	}
+
+	this->EvaluateQueryStep(evaluation, plan.GetRootStep(), queryDisplayResults);
+	if(this->IsQueryCancelled())
+	{
+		queryDisplayResults.Clear();
+		return;
+	}
+	vtkFacetedVisualizerDebugMacro(" evaluated "<<evaluation.NumberOfEvaluatedTerms<<" of "<<plan.GetNumberOfTerms()
+			<<" query terms");
+
+	profile.Levels = this->traversalStatistics;
+	profile.ResultCacheHits = this->resultCache->GetNumberOfHits() - resultCacheHits;
+	profile.ResultCacheMisses = this->resultCache->GetNumberOfMisses() - resultCacheMisses;
+	profile.PersistentCacheHits = this->persistentCache->GetNumberOfHits() - persistentCacheHits;
+	QueryProfileTimer timer(this, &profile.FormattingTime);
+
+	for (unsigned d = 0; d < this->traversalStatistics.size(); ++d)
+	{
+		vtkFacetedVisualizerDebugMacro(" traversal depth "<<d<<": expanded "<<this->traversalStatistics[d].Terms
+				<<" terms, "<<this->traversalStatistics[d].Rows<<" rows, "
+				<<this->traversalStatistics[d].NewTerms<<" new terms");
+	}
+
+	vtkFacetedVisualizerDebugMacro(" result cache: "<<this->resultCache->GetNumberOfHits()<<" hits, "
+			<<this->resultCache->GetNumberOfMisses()<<" misses, "
+			<<this->resultCache->GetNumberOfEntries()<<" entries, "
+			<<this->resultCache->GetSize()<<" bytes");
+	if(this->persistentCache->IsOpen())
+	{
+		vtkFacetedVisualizerDebugMacro(" persistent result cache: "<<this->persistentCache->GetNumberOfHits()<<" hits, "
+				<<this->persistentCache->GetNumberOfMisses()<<" misses");
+	}
+
+	// the result lines are gathered for the log only
+	if(vtkFacetedVisualizerLogEnabled(FACETEDVISUALIZER_LOG_TRACE))
+	{
+		vtkFacetedVisualizerTraceMacro(" query results ");
+		std::vector< std::vector< std::string > > qResults;
+		std::vector< std::string > allQueries;
+		this->GetQueryResults(qResults, allQueries);
+		for (unsigned n = 0; n < allQueries.size(); n++)
+		{
+			vtkFacetedVisualizerTraceMacro("-"<<allQueries[n]);
+
+			for (unsigned j = 0; j < qResults[n].size(); ++j)
+			{
+				vtkFacetedVisualizerTraceMacro("---"<<qResults[n][j]);
+			}
+
+		}
+	}
+	if(this->queryProfiling)
+	{
+		profile.EvaluationTime = vtkTimerLog::GetUniversalTime() - startTime;
+	}
+}
+
+//-----------------------------------------------------------------------------------------
+// Shows the models of the display candidates in displayResults and hides every other model
+// the logic manages: the children of the hierarchy nodes and the non-DB elements. Only the
+// nodes whose visibility differs are modified, in one batch so the views render once.
+void vtkSlicerFacetedVisualizerLogic
+::ApplyQueryDisplay(const vtkFacetedVisualizerBitSet &displayResults)
+{
+	QueryProfileTimer timer(this, &this->lastQueryProfile.DisplayTime);
+	vtkMRMLScene *scene = this->GetMRMLScene();
+	if(scene == NULL)
+	{
+		return;
+	}
+
+	std::vector< vtkMRMLModelNode* > shown;
+	for (int j = displayResults.NextSetBit(0); j >= 0; j = displayResults.NextSetBit(j + 1))
+	{
+		const std::vector< vtkMRMLModelHierarchyNode* > &hierarchyNodes =
+				this->GetHierarchyNodesByName(this->displayCandidates[j]);
+		for (size_t h = 0; h < hierarchyNodes.size(); ++h)
+		{
+			const std::vector< vtkMRMLModelNode* > &children = this->GetChildModelNodes(hierarchyNodes[h]);
+			shown.insert(shown.end(), children.begin(), children.end());
+		}
+		if(hierarchyNodes.empty())
+		{
+			const std::vector< vtkMRMLModelNode* > &nodes = this->GetModelNodesByName(this->displayCandidates[j]);
+			shown.insert(shown.end(), nodes.begin(), nodes.end());
+		}
+	}
+	std::sort(shown.begin(), shown.end());
+	shown.erase(std::unique(shown.begin(), shown.end()), shown.end());
+
+	// the managed nodes and the shown nodes are the ones whose visibility the query decides
+	std::vector< vtkMRMLModelNode* > decided = shown;
+	for (size_t n = 0; n < this->sceneHierarchyNodes.size(); n++)
+	{
+		const std::vector< vtkMRMLModelNode* > &children = this->GetChildModelNodes(this->sceneHierarchyNodes[n]);
+		decided.insert(decided.end(), children.begin(), children.end());
+	}
+	for (unsigned n = 0; n < this->nonDBElements.GetNumberOfValues(); ++n)
+	{
+		const std::vector< vtkMRMLModelNode* > &nodes = this->GetModelNodesByName(this->nonDBElements.GetValue(n));
+		decided.insert(decided.end(), nodes.begin(), nodes.end());
+	}
+	std::sort(decided.begin(), decided.end());
+	decided.erase(std::unique(decided.begin(), decided.end()), decided.end());
+
+	std::vector< vtkMRMLModelNode* > changed;
+	for (size_t n = 0; n < decided.size(); ++n)
+	{
+		int visible = std::binary_search(shown.begin(), shown.end(), decided[n]) ? 1 : 0;
+		if(decided[n]->GetDisplayVisibility() != visible)
+		{
+			changed.push_back(decided[n]);
+		}
+	}
+	vtkFacetedVisualizerDebugMacro(" visibility changes "<<changed.size()<<" of "<<decided.size()<<" models");
+	if(changed.empty())
+	{
+		return;
+	}
+
+	this->applyingQueryDisplay = true;
+	scene->StartState(vtkMRMLScene::BatchProcessState);
+	for (size_t n = 0; n < changed.size(); ++n)
+	{
+		changed[n]->SetDisplayVisibility(std::binary_search(shown.begin(), shown.end(), changed[n]) ? 1 : 0);
+	}
+	scene->EndState(vtkMRMLScene::BatchProcessState);
+	this->applyingQueryDisplay = false;
+}
+
+//-----------------------------------------------------------------------------------------
+bool vtkSlicerFacetedVisualizerLogic
+::ProcessQuery()
+{
+	this->CancelQuery();
+	vtkFacetedVisualizerBitSet queryDisplayResults;
+	this->ComputeQueryResults(this->query, queryDisplayResults);
+
+	// display the results on the scene
+	this->ApplyQueryDisplay(queryDisplayResults);
+
+	return queryDisplayResults.Any();
+}
+
+//-----------------------------------------------------------------------------------------
+// Evaluates the current query on a worker thread. A query that is still running is
+// cancelled first, so the newest query always wins. FinishQuery applies the result.
+void vtkSlicerFacetedVisualizerLogic::StartQuery()
+{
+	this->CancelQuery();
+	this->SyncPendingNodes();
+
+	// (re)open the session and the results file here, the worker only uses them and
+	// CancelQuery interrupts the same connection
+	this->queryDB = this->GetDBSession();
+	this->setValidDBFileName = this->queryDB != NULL;
+	this->GetPersistentCache();
+	this->runningQuery = this->query;
+	this->queryLock->Lock();
+	this->queryCancelled = false;
+	this->queryDone = false;
+	this->queryProgress = 0.0;
+	this->queryLock->Unlock();
+	this->queryThreadId = this->queryThreader->SpawnThread(
+			(vtkThreadFunctionType) &vtkSlicerFacetedVisualizerLogic::QueryThread, this);
+}
+
+//-----------------------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkSlicerFacetedVisualizerLogic::QueryThread(void *arg)
+{
+	vtkMultiThreader::ThreadInfo *info = static_cast< vtkMultiThreader::ThreadInfo* >(arg);
+	vtkSlicerFacetedVisualizerLogic *self = static_cast< vtkSlicerFacetedVisualizerLogic* >(info->UserData);
+
+	self->ComputeQueryResults(self->runningQuery, self->queryDB, self->asyncDisplayResults);
+
+	self->queryLock->Lock();
+	self->queryDone = true;
+	self->queryLock->Unlock();
+	return VTK_THREAD_RETURN_VALUE;
+}
+
+//-----------------------------------------------------------------------------------------
+// To be polled from the main thread: once the worker is done, applies the visibility
+// changes of its query to the scene and returns QueryFinished.
+int vtkSlicerFacetedVisualizerLogic::FinishQuery(bool &visualizedResults)
+{
+	visualizedResults = false;
+	if(this->queryThreadId < 0)
+	{
+		return QueryIdle;
+	}
+	this->queryLock->Lock();
+	bool done = this->queryDone;
+	this->queryLock->Unlock();
+	if(!done)
+	{
+		return QueryRunning;
+	}
+	this->queryThreader->TerminateThread(this->queryThreadId);
+	this->queryThreadId = -1;
+	this->queryDB = NULL;
+
+	this->ApplyQueryDisplay(this->asyncDisplayResults);
+	visualizedResults = this->asyncDisplayResults.Any();
+	return QueryFinished;
+}
+
+//-----------------------------------------------------------------------------------------
+// Stops a running query and waits for its thread. The traversal checks the flag between
+// lookups and a long SQL statement is interrupted.
+void vtkSlicerFacetedVisualizerLogic::CancelQuery()
+{
+	if(this->queryThreadId < 0)
+	{
+		return;
+	}
+	this->queryLock->Lock();
+	this->queryCancelled = true;
+	this->queryLock->Unlock();
+	if(this->queryDB != NULL)
+	{
+		vtk_sqlite3_interrupt(this->queryDB);
+	}
+	this->queryThreader->TerminateThread(this->queryThreadId);
+	this->queryThreadId = -1;
+	this->queryDB = NULL;
+
+	// the thread is joined, queries evaluated from now on must run to the end
+	this->queryLock->Lock();
+	this->queryCancelled = false;
+	this->queryLock->Unlock();
+}
+
+//-----------------------------------------------------------------------------------------
+bool vtkSlicerFacetedVisualizerLogic::IsQueryCancelled()
+{
+	this->queryLock->Lock();
+	bool cancelled = this->queryCancelled;
+	this->queryLock->Unlock();
+	return cancelled;
+}
+
+//-----------------------------------------------------------------------------------------
+double vtkSlicerFacetedVisualizerLogic::GetQueryProgress()
+{
+	this->queryLock->Lock();
+	double progress = this->queryProgress;
+	this->queryLock->Unlock();
+	return progress;
+}
+
+//-----------------------------------------------------------------------------------------
+void vtkSlicerFacetedVisualizerLogic::SetQueryProgress(double progress)
+{
+	this->queryLock->Lock();
+	this->queryProgress = progress;
+	this->queryLock->Unlock();
+}
+
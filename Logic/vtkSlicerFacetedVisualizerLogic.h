@@ -1,187 +1,722 @@
-/*==============================================================================
-
-  Program: 3D Slicer
-
-  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
-
-  See COPYRIGHT.txt
-  or http://www.slicer.org/copyright/copyright.txt for details.
-
-  Unless required by applicable law or agreed to in writing, software
-  distributed under the License is distributed on an "AS IS" BASIS,
-  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
-  See the License for the specific language governing permissions and
-  limitations under the License.
-
-==============================================================================*/
-
-// .NAME vtkSlicerFacetedVisualizerLogic - slicer logic class for volumes manipulation
-// .SECTION Description
-// This class manages the logic associated with reading, saving,
-// and changing propertied of the volumes
-
-
-#ifndef __vtkSlicerFacetedVisualizerLogic_h
-#define __vtkSlicerFacetedVisualizerLogic_h
-
-// Slicer includes
-#include "vtkSlicerModuleLogic.h"
-
-// MRML includes
-#include "vtkMRMLScene.h"
-// STD includes
-#include <cstdlib>
-
-#include "vtkSlicerFacetedVisualizerModuleLogicExport.h"
-
-#include <string>
-#include <vector>
-#include <map>
-#include <utility>
-
-#include <vtk_sqlite3.h>
-
-#include <vtkMRMLModelHierarchyNode.h>
-
-/// \ingroup Slicer_QtModules_FacetedVisualizer
-class VTK_SLICER_FACETEDVISUALIZER_MODULE_LOGIC_EXPORT vtkSlicerFacetedVisualizerLogic :
-  public vtkSlicerModuleLogic
-{
-public:
-  
-  static vtkSlicerFacetedVisualizerLogic *New();
-  vtkTypeMacro(vtkSlicerFacetedVisualizerLogic,vtkSlicerModuleLogic);
-  void PrintSelf(ostream& os, vtkIndent indent);
-
-
-  bool ProcessQuery();
-
- //BTX
-  void SynchronizeAtlasWithDB(std::vector< std::vector< std::string > >&matchingDBAtoms,
-   		  std::vector< std::string > &unMatchedMRMLAtoms);
-
-  void GetQueryResults( std::vector< std::vector < std::string > > &results,
-     		std::vector< std::string> &queries);
-
-  void SetCorrespondingDBTermforMRMLNode(std::string DBAtom, std::string mrmlNode)
-  {
-   	  mrmlDBTerms.insert(std::pair< std::string, std::string> (DBAtom, mrmlNode));
-  }
-//ETX
-
-  //void AddQueryResultToCache(std::string &text);
-
-  
-  void SetDBFileName(std::string fname)
-  {
-	  dbFileName = fname;
-          setValidDBFileName = true;
-  }
-
-
-  void SetQuery(std::string newquery)
-  {
-	  query = newquery;
-  }
-
-  std::string GetQuery()
-  {
-	  return query;
-  }
-
-
-protected:
-  vtkSlicerFacetedVisualizerLogic();
-  virtual ~vtkSlicerFacetedVisualizerLogic();
-
-  virtual void SetMRMLSceneInternal(vtkMRMLScene * newScene);
-  /// Register MRML Node classes to Scene. Gets called automatically when the MRMLScene is attached to this logic class.
-  virtual void RegisterNodes();
-  virtual void UpdateFromMRMLScene();
-  virtual void OnMRMLSceneNodeAdded(vtkMRMLNode* node);
-  virtual void OnMRMLSceneNodeRemoved(vtkMRMLNode* node);
-
-
-
-private:
-
-  // Helper methods
-    void toLower(std::string origstr, std::string& newstr);
-
-    void toUpper(std::string origstr, std::string& newstr);
-
-    char* ProduceQuery(std::string& string, bool asObject,
-    		             bool asSubject, std::string Predicate);
-
-    void removeLeadingFollowingSpace(std::string& origstr);
-
-//BTX
-
-    int AddQueryResult(std::string &text, std::vector< std::string >& store);
-
-    std::string GetDBSubject(std::string& query, vtk_sqlite3* ptrDB);
-
-    ///////////////////////////////////////////////////////////////////////////////
-    void SyncModelWithDB(vtkMRMLModelHierarchyNode *modelNode, vtk_sqlite3* ptrDB,
-     		  std::vector< std::string > &possibleMatches);
-
-    int ProcessSingleQuery(std::string& query, vtk_sqlite3* ptrDB,
-    		std::vector< std::string > &queryResults,
-    		std::vector< std::string > &displayTerms);
-
-
-    int RecursiveProcessQuery(char* queryText, vtk_sqlite3* ptrDB,
-  		  	  	  	  	  	bool queryAsSubject,
-  		                    std::vector< std::string> &displayTerms);
-
-
-    // Cache management -- currently commented out in the cxx file. HV
-    int ManageQueryCache(std::vector< std::string >& queries,
-  		  std::string query, std::vector< std::string> & queryResults);
-
-
- //ETX
-private:
-
- //BTX
-  std::string                             dbFileName;
-  std::string                             query;
-
-  std::vector < std::string >              recursionPredicates;
-
-  std::vector< std::string >               addRecursionPredicates;
-
-  std::vector< std::string >               ignorePredicates;
-
-  std::vector< std::string >               commentPredicates;
-
-   // do we cache results? How much?
-  std::multimap< std::string, int > queryCacheMap;
-  std::vector< std::string > queryResultCache;
-
-  std::map< std::string, std::string> eqQueryMap;
-
-  // how often is a specific query accessed. The least frequent query is the one that
-  // is removed from the cache first
-  std::map< std::string, int  >          queryResultAge;
-
-  std::vector< std::string >             resultsForDisplay;
-
-  std::multimap< std::string, std::string >             mrmlDBTerms;
-
-  std::vector< std::string >             nonDBElements; // these are models that are added by the user to the scene
-//ETX
-  int                                  maxQueryHistory;
-
-  int                                  cacheSize;
-
-  bool                                 setValidDBFileName;
-  // private methods
-  vtkSlicerFacetedVisualizerLogic(const vtkSlicerFacetedVisualizerLogic&); // Not implemented
-  void operator=(const vtkSlicerFacetedVisualizerLogic&);               // Not implemented
-
-
-};
-
-#endif
-
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkSlicerFacetedVisualizerLogic - slicer logic class for volumes manipulation
+// .SECTION Description
+// This class manages the logic associated with reading, saving,
+// and changing propertied of the volumes
+
+
+#ifndef __vtkSlicerFacetedVisualizerLogic_h
+#define __vtkSlicerFacetedVisualizerLogic_h
+
+// Slicer includes
+#include "vtkSlicerModuleLogic.h"
+
+// MRML includes
+#include "vtkMRMLScene.h"
+// STD includes
+#include <cstdlib>
+
+#include "vtkSlicerFacetedVisualizerModuleLogicExport.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+
+#include <vtk_sqlite3.h>
+#include <vtksys/hash_map.hxx>
+#include <vtksys/hash_set.hxx>
+
+#include <vtkMRMLModelHierarchyNode.h>
+#include <vtkMultiThreader.h>
+
+#include "vtkFacetedVisualizerBitSet.h"
+#include "vtkFacetedVisualizerOrderedSet.h"
+#include "vtkFacetedVisualizerQueryPlan.h"
+
+class vtkMRMLModelNode;
+class vtkMutexLock;
+class vtkFacetedVisualizerTermCompleter;
+class vtkFacetedVisualizerTokenIndex;
+class vtkFacetedVisualizerTripleStore;
+class vtkFacetedVisualizerResultCache;
+class vtkFacetedVisualizerPersistentCache;
+
+/// \ingroup Slicer_QtModules_FacetedVisualizer
+class VTK_SLICER_FACETEDVISUALIZER_MODULE_LOGIC_EXPORT vtkSlicerFacetedVisualizerLogic :
+  public vtkSlicerModuleLogic
+{
+public:
+  
+  static vtkSlicerFacetedVisualizerLogic *New();
+  vtkTypeMacro(vtkSlicerFacetedVisualizerLogic,vtkSlicerModuleLogic);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+
+  bool ProcessQuery();
+
+  // The two halves of ProcessQuery: evaluates the query into the display candidates to
+  // show, then updates the visibility of the models that differ from it in one scene batch.
+//BTX
+  void ComputeQueryResults(const std::string &queryText, vtkFacetedVisualizerBitSet &displayResults);
+//ETX
+  void ApplyQueryDisplay(const vtkFacetedVisualizerBitSet &displayResults);
+
+  // Asynchronous version of ProcessQuery for the GUI. StartQuery evaluates the current
+  // query on a worker thread, cancelling the one still running. FinishQuery is polled
+  // from the main thread and applies the results to the scene once the worker is done;
+  // visualizedResults is then what ProcessQuery would have returned. The scene and DB
+  // must not be changed while a query runs; the logic's own entry points that do so
+  // cancel it first.
+  enum
+  {
+	  QueryIdle = 0,
+	  QueryRunning,
+	  QueryFinished
+  };
+  void StartQuery();
+  int FinishQuery(bool &visualizedResults);
+  void CancelQuery();
+  // fraction of the operands of the running query evaluated so far
+  double GetQueryProgress();
+
+ //BTX
+  void SynchronizeAtlasWithDB(std::vector< std::vector< std::string > >&matchingDBAtoms,
+   		  std::vector< std::string > &unMatchedMRMLAtoms);
+
+  void GetQueryResults( std::vector< std::vector < std::string > > &results,
+     		std::vector< std::string> &queries);
+
+  void SetCorrespondingDBTermforMRMLNode(std::string DBAtom, std::string mrmlNode);
+
+  // Appends up to maximumCompletions DB terms (subjects, non-English equivalents and
+  // synonyms) starting with the prefix, for type-ahead in the query line edit. The terms
+  // are read once per DB session with the first call.
+  void GetQueryTermCompletions(const std::string &prefix, unsigned int maximumCompletions,
+		  std::vector< std::string > &completions);
+//ETX
+
+  // Cache of evaluated query operands, cleared whenever the DB session or the mapping of
+  // models to DB terms changes. Its size and hit/miss counters can be set and read here.
+  vtkFacetedVisualizerResultCache* GetResultCache()
+  {
+	  return resultCache;
+  }
+
+  // When on (the default), evaluated queries are also kept in "<DB file>.results.sqlite3"
+  // (see vtkFacetedVisualizerPersistentCache) so that later sessions on the same DB and
+  // scene start with them. The file is opened with the first query after SetDBFileName.
+  void SetUsePersistentCache(bool use);
+
+  // Maximum number of terms (subjects, non-English equivalents and synonyms) preloaded
+  // when a DB is opened to resolve query terms without SQL. With a larger ontology the
+  // terms that did not fit are resolved with SQL. Takes effect with the next DB session.
+  void SetTermDictionaryMaximumSize(unsigned int terms)
+  {
+	  termDictionaryMaximumSize = terms;
+  }
+  unsigned int GetTermDictionaryMaximumSize()
+  {
+	  return termDictionaryMaximumSize;
+  }
+
+  bool GetUsePersistentCache()
+  {
+	  return usePersistentCache;
+  }
+
+  
+  // Sets the ontology DB file and opens a session on it. The session is kept open and reused
+  // by all queries; it is only reopened when a different file is set or the file changes on disk.
+  void SetDBFileName(std::string fname);
+
+  // sqlite page cache size (in pages) and memory-mapped I/O size (in MB) used by the DB session.
+  // A value of -1 keeps the sqlite default. mmap is ignored by sqlite versions without support.
+  void SetDBCacheSize(int pages);
+  int GetDBCacheSize()
+  {
+	  return dbCacheSize;
+  }
+
+  void SetDBMMapSize(int megabytes);
+  int GetDBMMapSize()
+  {
+	  return dbMMapSize;
+  }
+
+  // How covering indexes on resources(subject, predicate, object) and (object, predicate, subject)
+  // are provided when a DB without them is opened: not at all (only reported), created in the
+  // user's file (needs write access and the user's consent), or in an indexed copy of the
+  // resources table kept next to the file ("<file>.indexed.sqlite3"), which is the default.
+  enum
+  {
+	  IndexReportOnly = 0,
+	  IndexInPlace,
+	  IndexSidecar
+  };
+  void SetIndexProvisioningMode(int mode)
+  {
+	  indexProvisioningMode = mode;
+  }
+  int GetIndexProvisioningMode()
+  {
+	  return indexProvisioningMode;
+  }
+
+  // How the recursion over the part-of hierarchy is evaluated: one lookup per term and
+  // recursion predicate, one SQL statement per level of the hierarchy that joins the
+  // whole frontier against resources for all recursion predicates at once, or a single
+  // WITH RECURSIVE statement for the whole transitive closure. The recursive statement
+  // needs sqlite 3.8.3, with older versions the batched traversal is used instead. The
+  // in-memory store always uses per-term lookups as they do not involve SQL.
+  enum
+  {
+	  TraversalPerTerm = 0,
+	  TraversalBatched,
+	  TraversalRecursiveCTE
+  };
+  void SetTraversalMode(int mode)
+  {
+	  traversalMode = mode;
+  }
+  int GetTraversalMode()
+  {
+	  return traversalMode;
+  }
+
+//BTX
+  // Work done by the ontology traversal of the last ProcessQuery, per depth of the hierarchy
+  // (depth 0 is the lookup the traversal started from)
+  struct TraversalLevelStatistics
+  {
+	  unsigned int Terms;     // terms expanded at this depth
+	  unsigned int Rows;      // rows returned by their lookups
+	  unsigned int NewTerms;  // terms reached for the first time, expanded at the next depth
+  };
+  void GetLastTraversalStatistics(std::vector< TraversalLevelStatistics >& levels)
+  {
+	  levels = traversalStatistics;
+  }
+
+  // Profile of the last query, recorded while query profiling is on. Times are in seconds
+  // and exclusive: the resolution of terms during the traversal is not traversal time.
+  enum
+  {
+	  QueryTermFromResultCache = 0,
+	  QueryTermFromPersistentCache,
+	  QueryTermFromTraversal,
+	  QueryTermSkipped
+  };
+  struct QueryProfileTerm
+  {
+	  double       EstimatedCost;  // rows, see the ordering of intersections
+	  int          Source;         // one of the QueryTerm* values above
+	  unsigned int DisplayTerms;   // models the term shows
+	  double       Time;           // evaluation including the caches
+  };
+  struct QueryProfile
+  {
+	  std::string                              Query;
+	  vtkFacetedVisualizerQueryPlan            Plan;
+	  std::vector< double >                    StepCosts;
+	  std::vector< QueryProfileTerm >          Terms;   // by term of the plan
+	  unsigned long                            SQLStatements;
+	  unsigned long                            StoreLookups;    // on the in-memory store
+	  unsigned long                            RowsFetched;
+	  unsigned long                            ResultCacheHits;
+	  unsigned long                            ResultCacheMisses;
+	  unsigned long                            PersistentCacheHits;
+	  std::vector< TraversalLevelStatistics >  Levels;
+	  double                                   PlanningTime;    // parsing and cost estimates
+	  double                                   ResolutionTime;  // terms to DB subjects
+	  double                                   TraversalTime;
+	  double                                   CacheTime;
+	  double                                   FormattingTime;  // result lines
+	  double                                   DisplayTime;     // MRML visibility update
+	  double                                   EvaluationTime;  // all of the query but the display
+  };
+  void GetLastQueryProfile(QueryProfile& profile)
+  {
+	  profile = lastQueryProfile;
+  }
+
+  // EXPLAIN style report of the last query profile: the plan with the estimated and the
+  // actual work of every term, then the counters and times
+  void PrintLastQueryProfile(ostream& os);
+
+  // Lookups of the current DB session that still scan the whole resources table, as
+  // "<SQL>: <query plan>" strings. Empty when every lookup can use an index.
+  void GetUnindexedAccessPaths(std::vector< std::string >& paths)
+  {
+	  paths = unindexedAccessPaths;
+  }
+//ETX
+
+  // Precomputes the transitive closure of every traversal seed over the recursion predicates
+  // into a closure(ancestor, descendant, predicate_class, depth) table of the DB session
+  // (the indexed sidecar, or the DB itself when indexes are provisioned in place), so that
+  // later queries on the same ontology are a single indexed lookup. predicate_class is the
+  // recursion predicate of the seed and depth the level at which the descendant is first
+  // reached. The table is detected when a session is opened and used while it matches the
+  // recursion predicates and the resources table; an out-of-date table is reported and
+  // ignored until it is built again. The DB file itself is only written in the IndexInPlace
+  // mode: without an indexed sidecar, the other modes refuse to build the table.
+  bool BuildClosureTable();
+  bool GetClosureTableAvailable()
+  {
+	  return closureTableAvailable;
+  }
+
+  // When on, lookups are answered from an in-memory copy of the resources table
+  // (see vtkFacetedVisualizerTripleStore) that is loaded once per DB session, instead of SQL.
+  // If the copy cannot be loaded the session falls back to SQL lookups and
+  // GetInMemoryStoreInUse returns false, while the setting stays on for the next session.
+  void SetUseInMemoryStore(bool use);
+  bool GetUseInMemoryStore()
+  {
+	  return useInMemoryStore;
+  }
+  bool GetInMemoryStoreInUse()
+  {
+	  return useInMemoryStore && !inMemoryStoreFailed;
+  }
+
+  // Number of threads SynchronizeAtlasWithDB matches the hierarchy nodes with the DB on.
+  // 0 (the default) uses one per core, 1 matches them on the calling thread.
+  void SetNumberOfSyncThreads(int numberOfThreads)
+  {
+	  numberOfSyncThreads = numberOfThreads;
+  }
+  int GetNumberOfSyncThreads()
+  {
+	  return numberOfSyncThreads;
+  }
+
+
+  void SetQuery(std::string newquery)
+  {
+	  query = newquery;
+  }
+
+  std::string GetQuery()
+  {
+	  return query;
+  }
+
+  // When on, every query records a QueryProfile. Off by default, the timers are not free.
+  void SetQueryProfiling(bool profiling)
+  {
+	  queryProfiling = profiling;
+  }
+  bool GetQueryProfiling()
+  {
+	  return queryProfiling;
+  }
+
+  // Syntax error of the last query evaluated, empty if it was valid. See
+  // vtkFacetedVisualizerQueryPlan for the query language.
+  std::string GetQueryError()
+  {
+	  return queryError;
+  }
+
+
+protected:
+  vtkSlicerFacetedVisualizerLogic();
+  virtual ~vtkSlicerFacetedVisualizerLogic();
+
+  virtual void SetMRMLSceneInternal(vtkMRMLScene * newScene);
+  /// Register MRML Node classes to Scene. Gets called automatically when the MRMLScene is attached to this logic class.
+  virtual void RegisterNodes();
+  virtual void UpdateFromMRMLScene();
+  virtual void OnMRMLSceneNodeAdded(vtkMRMLNode* node);
+  virtual void OnMRMLSceneNodeRemoved(vtkMRMLNode* node);
+  virtual void OnMRMLSceneEndBatchProcess();
+  /// Keeps the scene node index current when an indexed node is renamed or moved in
+  /// the model hierarchy, the scene only tells about added and removed nodes
+  virtual void ProcessMRMLNodesEvents(vtkObject* caller, unsigned long event, void* callData);
+
+
+
+private:
+
+  // Helper methods
+    void toLower(std::string origstr, std::string& newstr);
+
+    void toUpper(std::string origstr, std::string& newstr);
+
+    // converts a term to the form used for atoms in the DB, e.g. "White_matter_of_cerebellum"
+    void ToDBForm(std::string& string);
+
+    void removeLeadingFollowingSpace(std::string& origstr);
+
+//BTX
+    // DB session management. GetDBSession returns the open connection, reopening it if the
+    // file was modified since it was opened, or NULL if the file could not be opened.
+    bool OpenDBSession();
+    void CloseDBSession();
+    vtk_sqlite3* GetDBSession();
+    void ApplyDBSessionSettings();
+
+    // index provisioning and validation for the DB session
+    bool HasCoveringIndexes(vtk_sqlite3* ptrDB);
+    bool CreateCoveringIndexes(vtk_sqlite3* ptrDB);
+    void ProvisionIndexes();
+    vtk_sqlite3* OpenIndexSidecar(const std::string& sidecarFileName);
+    void ValidateAccessPaths();
+
+    // closure table support, see BuildClosureTable
+    std::string GetClosureSignature();
+    std::string GetClosureSourceFingerprint();
+    // stale is set if there is a closure table but it is out of date
+    bool HasClosureTable(vtk_sqlite3* ptrDB, bool &stale);
+    bool IsClosurePredicate(const std::string& Predicate, bool queryAsSubject);
+    int RecursiveProcessQueryClosureTable(std::string& term, const std::string& Predicate,
+    		vtk_sqlite3* ptrDB, bool queryAsSubject, vtkFacetedVisualizerBitSet &displayTerms);
+//ETX
+
+//BTX
+
+    std::string GetDBSubject(std::string& query, vtk_sqlite3* ptrDB);
+
+    // term dictionary used by GetDBSubject, loaded per DB session
+    void LoadTermDictionary(vtk_sqlite3* ptrDB);
+    void ClearTermDictionary();
+
+    // Looks up the (subject, predicate, object) rows of the resources table that match term
+    // as subject, object or either, optionally restricted to a predicate. The term is converted
+    // to DB form in place. Returns the number of rows found or -1 on error.
+    int ExecuteLookup(std::string& term, bool asObject, bool asSubject,
+    		const std::string& Predicate, vtk_sqlite3* ptrDB,
+    		std::vector< std::vector< std::string > > &rows);
+
+    // Prepared statements for the lookups above, one per (subject/object/both) x
+    // (predicate/no predicate) shape. They are compiled on first use and re-bound for
+    // every lookup until the DB is closed.
+    vtk_sqlite3_stmt* GetLookupStatement(vtk_sqlite3* ptrDB, bool asObject, bool asSubject,
+    		bool withPredicate);
+
+    void FinalizeLookupStatements();
+
+    ///////////////////////////////////////////////////////////////////////////////
+    // token index over the DB subjects, built on first use in a DB session; NULL if the
+    // subjects could not be read
+    vtkFacetedVisualizerTokenIndex* GetTokenIndex(vtk_sqlite3* ptrDB);
+
+    // Index of the model and model hierarchy nodes of the scene, in scene order and by
+    // name, kept up to date from the node added / removed events and the modified events
+    // of the indexed nodes. The child model nodes of a hierarchy node are resolved on
+    // first use and dropped when nodes are added or removed, or when the name, parent or
+    // model of a hierarchy node changes.
+    void RebuildSceneNodeIndex();
+    void AddToSceneNodeIndex(vtkMRMLNode* node);
+    void RemoveFromSceneNodeIndex(vtkMRMLNode* node);
+    const std::vector< vtkMRMLModelHierarchyNode* >& GetHierarchyNodesByName(const std::string& name);
+    const std::vector< vtkMRMLModelNode* >& GetModelNodesByName(const std::string& name);
+    const std::vector< vtkMRMLModelNode* >& GetChildModelNodes(vtkMRMLModelHierarchyNode* node);
+
+    // A hierarchy node being synchronized: the name in DB form and its tokens, prepared
+    // on the MRML thread, and the outcome of matching it with the DB
+    struct ModelMatch
+    {
+      std::string                NodeName;
+      std::string                DBName;
+      std::vector< std::string > Tokens;
+      bool                       InDB;
+      std::string                Subject;
+      std::vector< std::string > Candidates;
+    };
+    struct SyncConnection;
+    struct SyncThreadData;
+
+    void PrepareModelMatch(vtkMRMLModelHierarchyNode *modelNode, ModelMatch &match);
+    void MatchModel(ModelMatch &match, SyncConnection &connection, bool fuzzy);
+    void MatchModelsWithDB(std::vector< ModelMatch > &matches, vtk_sqlite3* ptrDB);
+    void ApplyModelMatch(const ModelMatch &match, vtkFacetedVisualizerOrderedSet &possibleMatches);
+    static VTK_THREAD_RETURN_TYPE SyncModelsThread(void *arg);
+
+    bool IsQueryCancelled();
+    void SetQueryProgress(double progress);
+    static VTK_THREAD_RETURN_TYPE QueryThread(void *arg);
+    // ComputeQueryResults on a session that was opened beforehand on the main thread,
+    // the query thread must not open or close it
+    void ComputeQueryResults(const std::string &queryText, vtk_sqlite3* ptrDB,
+    		vtkFacetedVisualizerBitSet &displayResults);
+
+    // Once the atlas was synchronized, nodes added to or removed from the scene are
+    // matched / unmatched one at a time. Added nodes are matched at the end of the batch
+    // process or before the next query, once their model and children are set; a synced
+    // hierarchy node whose name, parent or model changes is unmatched and matched again
+    // the same way.
+    struct SyncedHierarchyNode
+    {
+      ModelMatch                 Match;
+      std::vector< std::string > ModelNodeIDs;
+      // what the node was matched with, see GetSyncedState
+      std::string                Name;
+      std::string                ParentNodeID;
+      std::string                AssociatedNodeID;
+    };
+    void GetSyncedState(vtkMRMLModelHierarchyNode *node, SyncedHierarchyNode &synced);
+    void GetAtlasModelNodeIDs(vtkMRMLModelHierarchyNode *modelNode, std::vector< std::string > &modelNodeIDs);
+    void SyncAddedNode(vtkMRMLNode *node);
+    void SyncRemovedNode(vtkMRMLNode *node);
+    void UpdateNonDBElement(const std::string& name);
+    void SyncPendingNodes();
+    void FinishIncrementalSync();
+
+    int ProcessSingleQuery(std::string& query, vtk_sqlite3* ptrDB,
+    		vtkFacetedVisualizerOrderedSet &queryResults,
+    		vtkFacetedVisualizerBitSet &displayTerms);
+
+    std::string ResolveQueryTerm(const std::string &term, vtk_sqlite3* ptrDB);
+    int EvaluateQueryTerm(const std::string &term, vtk_sqlite3* ptrDB, bool listResults,
+    		vtkFacetedVisualizerBitSet &displayTerms, int &source);
+
+    const vtkFacetedVisualizerQueryPlan& GetQueryPlan(const std::string &queryText);
+
+    // query profiling
+    class QueryProfileTimer;
+    void ResetQueryProfile(const std::string &queryText);
+    void AddQueryProfileStatements(unsigned long statements, unsigned long rows);
+
+    // cost based evaluation of query plans
+    struct QueryEvaluation;
+    void LoadPredicateStatistics(vtk_sqlite3* ptrDB);
+    double GetPredicateFanOut(const std::string& predicate);
+    double EstimateQueryTermCost(const std::string& term, vtk_sqlite3* ptrDB);
+    void EstimateQueryPlanCosts(QueryEvaluation &evaluation);
+    void EvaluateQueryStep(QueryEvaluation &evaluation, int stepIndex,
+    		vtkFacetedVisualizerBitSet &result);
+
+
+    int RecursiveProcessQuery(std::string& term, const std::string& Predicate,
+    		                vtk_sqlite3* ptrDB, bool queryAsSubject,
+  		                    vtkFacetedVisualizerBitSet &displayTerms);
+
+    void ProcessTraversalRows(std::vector< std::vector< std::string > > &rows,
+    		bool queryAsSubject, vtk_sqlite3* ptrDB,
+    		vtkFacetedVisualizerBitSet &displayTerms, std::vector< std::string > &nextFrontier);
+
+    // evaluates the whole traversal from a seed lookup in one statement, see TraversalRecursiveCTE
+    int RecursiveProcessQueryCTE(std::string& term, const std::string& Predicate,
+    		vtk_sqlite3* ptrDB, bool queryAsSubject, vtkFacetedVisualizerBitSet &displayTerms);
+
+    // quoted, comma separated list of predicates for use in an IN (...) clause
+    std::string GetPredicateListSQL(const std::vector< std::string > &predicates);
+
+    // Dense index of a model name that can be displayed by a query, assigned on first use.
+    // Display results are sets of these indices.
+    unsigned int GetDisplayCandidateIndex(const std::string& name);
+
+    void AddDisplayTermsForDBTerm(std::string &term, vtk_sqlite3* ptrDB,
+    		vtkFacetedVisualizerBitSet &displayTerms);
+
+    // expands all terms of the frontier with one statement, see TraversalBatched
+    int ExpandFrontierBatched(std::vector< std::string > &frontier, vtk_sqlite3* ptrDB,
+    		vtkFacetedVisualizerBitSet &displayTerms, std::vector< std::string > &nextFrontier);
+
+    void AddTraversalLevelStatistics(unsigned int depth, unsigned int terms,
+    		unsigned int rows, unsigned int newTerms);
+
+
+    // key of a query operand in the result cache
+    std::string GetCanonicalQueryKey(const std::string& query, vtk_sqlite3* ptrDB);
+
+    // the persistent cache of the DB session or NULL if not in use
+    vtkFacetedVisualizerPersistentCache* GetPersistentCache();
+    // computed again by GetPersistentCache once sceneFingerprintModified is set, so
+    // changes of the mapping one node at a time do not each sort the whole mapping
+    void UpdateSceneFingerprint();
+
+
+ //ETX
+private:
+
+ //BTX
+  std::string                             dbFileName;
+  std::string                             query;
+
+  std::vector < std::string >              recursionPredicates;
+
+  std::vector< std::string >               addRecursionPredicates;
+
+  std::vector< std::string >               ignorePredicates;
+
+  std::vector< std::string >               commentPredicates;
+
+  // DB form of a term -> DB subject it resolves to, and terms known not to resolve
+  // (only used when the dictionary is incomplete)
+  vtksys::hash_map< std::string, std::string > termDictionary;
+  vtksys::hash_set< std::string >        unknownTerms;
+
+  // by query text, plans do not depend on the DB or the scene
+  vtksys::hash_map< std::string, vtkFacetedVisualizerQueryPlan > queryPlans;
+
+  std::vector< std::string >             resultsForDisplay;
+
+  std::multimap< std::string, std::string >             mrmlDBTerms;
+
+  vtkFacetedVisualizerOrderedSet         nonDBElements; // these are models that are added by the user to the scene
+
+  // display candidates (model names) by dense index and the index of each name
+  std::vector< std::string >             displayCandidates;
+  vtksys::hash_map< std::string, unsigned int > displayCandidateIndices;
+
+  // prepared lookup statements, indexed by shape (see GetLookupStatement) and the
+  // connection they were compiled against
+  vtk_sqlite3_stmt*                      lookupStatements[6];
+  vtk_sqlite3*                           lookupStatementsDB;
+
+  // statements filling the temporary frontier table and expanding it, see TraversalBatched
+  vtk_sqlite3_stmt*                      frontierInsertStatement;
+  vtk_sqlite3_stmt*                      frontierExpandStatement;
+
+  // recursive closure statements seeded with the term as subject [1] or as object [0], and
+  // whether preparing them failed on this connection (the queries then use TraversalBatched)
+  vtk_sqlite3_stmt*                      closureStatements[2];
+  bool                                   closureStatementsFailed[2];
+
+  // lookup of the materialized closure table
+  vtk_sqlite3_stmt*                      closureTableStatement;
+
+  // long-lived connection to dbFileName and the modification time of the file when opened
+  vtk_sqlite3*                           dbSession;
+  long int                               dbSessionModifiedTime;
+
+  // file the session is connected to: dbFileName or its indexed sidecar
+  std::string                            dbSessionFileName;
+
+  std::vector< std::string >             unindexedAccessPaths;
+
+  // terms already expanded by the traversal of the current query
+  vtksys::hash_set< std::string >        traversalVisited;
+
+  std::vector< TraversalLevelStatistics > traversalStatistics;
+
+  QueryProfile                         lastQueryProfile;
+//ETX
+  bool                                 queryProfiling;
+  // time category of the innermost QueryProfileTimer and when it last changed
+  double*                              profileCategory;
+  double                               profileMark;
+//BTX
+
+  std::string                            sceneFingerprint;
+//ETX
+  bool                                 sceneFingerprintModified;
+  int                                  indexProvisioningMode;
+
+  int                                  traversalMode;
+
+  vtkFacetedVisualizerTripleStore*     tripleStore;
+
+  vtkFacetedVisualizerTokenIndex*      tokenIndex;
+
+  vtkFacetedVisualizerTermCompleter*   termCompleter;
+
+  int                                  numberOfSyncThreads;
+
+//BTX
+  std::vector< vtkMRMLModelHierarchyNode* >                          sceneHierarchyNodes;
+  std::vector< vtkMRMLModelNode* >                                   sceneModelNodes;
+  vtksys::hash_map< std::string, std::vector< vtkMRMLModelHierarchyNode* > > hierarchyNodesByName;
+  vtksys::hash_map< std::string, std::vector< vtkMRMLModelNode* > >  modelNodesByName;
+  // name each observed node is indexed under, to find it again once renamed
+  std::map< vtkMRMLNode*, std::string >                             sceneNodeNames;
+  // by ID of the hierarchy node
+  vtksys::hash_map< std::string, std::vector< vtkMRMLModelNode* > >  hierarchyChildModelNodes;
+//ETX
+
+  // set while ApplyQueryDisplay changes the scene
+  bool                                 applyingQueryDisplay;
+
+  vtkMultiThreader*                    queryThreader;
+  // -1 when no query thread was spawned
+  int                                  queryThreadId;
+  // guards queryCancelled, queryDone and queryProgress
+  vtkMutexLock*                        queryLock;
+  bool                                 queryCancelled;
+  bool                                 queryDone;
+  double                               queryProgress;
+  // the session the running query uses, to interrupt its statements
+  vtk_sqlite3*                         queryDB;
+//BTX
+  std::string                          runningQuery;
+//ETX
+  vtkFacetedVisualizerBitSet           asyncDisplayResults;
+
+//BTX
+  // by node ID
+  vtksys::hash_map< std::string, SyncedHierarchyNode >               syncedHierarchyNodes;
+  // model node ID -> number of hierarchy nodes using it
+  vtksys::hash_map< std::string, int >                               atlasModelNodeIDs;
+  std::vector< std::string >                                         pendingSyncNodeIDs;
+//ETX
+
+  bool                                 atlasSynchronized;
+
+  bool                                 closureTableAvailable;
+
+  bool                                 useInMemoryStore;
+
+  // the in-memory store could not be loaded in this DB session
+  bool                                 inMemoryStoreFailed;
+
+  int                                  dbCacheSize;
+
+  int                                  dbMMapSize;
+  vtkFacetedVisualizerResultCache*     resultCache;
+
+  vtkFacetedVisualizerPersistentCache* persistentCache;
+
+  bool                                 usePersistentCache;
+
+  // whether the persistent cache was opened (or tried) for the current session
+  bool                                 persistentCacheOpened;
+
+  bool                                 termDictionaryComplete;
+
+  unsigned int                         termDictionaryMaximumSize;
+
+  unsigned int                         unknownTermsMaximumSize;
+
+  unsigned int                         queryPlansMaximumSize;
+
+//BTX
+  // rows per predicate of the resources table
+  vtksys::hash_map< std::string, double > predicateRows;
+//ETX
+  double                               numberOfDBRows;
+  double                               numberOfDBSubjects;
+
+//BTX
+  std::string                          queryError;
+//ETX
+
+  bool                                 setValidDBFileName;
+  // private methods
+  vtkSlicerFacetedVisualizerLogic(const vtkSlicerFacetedVisualizerLogic&); // Not implemented
+  void operator=(const vtkSlicerFacetedVisualizerLogic&);               // Not implemented
+
+
+};
+
+#endif
+
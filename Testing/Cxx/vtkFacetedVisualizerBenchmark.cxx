@@ -0,0 +1,822 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Query benchmark of the faceted visualizer logic. Generates a synthetic ontology shaped
+// like the FMA (a part-of hierarchy with inverse relations, attributes, synonyms and
+// non-English equivalents) and an atlas scene of models named after its terms, then times
+// SynchronizeAtlasWithDB, ProcessQuery and GetQueryResults over mixes of representative
+// queries. Prints the percentiles of every operation as JSON. Fails if a query shows
+// nothing or if its results change once it is cached.
+//
+// Usage: vtkFacetedVisualizerBenchmark [options]
+//   --db <file>              DB to generate (default FacetedVisualizerBenchmark.sqlite3)
+//   --reuse-db               keep an existing DB file instead of generating it again
+//   --triples <n>            size of the ontology (default 100000), 10k to 5M are sensible
+//   --depth <n>              levels of the part-of hierarchy below the root (default 6)
+//   --branching <n>          children per term, by default the smallest that reaches --triples
+//   --synonyms <fraction>    terms with a synonym (default 0.3), half as many get a
+//                            non-English equivalent
+//   --models <n>             models in the atlas scene (default 300)
+//   --unmatched <fraction>   models whose name is not a DB term (default 0.05)
+//   --queries <n>            queries per mix (default 10)
+//   --repetitions <n>        times every query and the synchronization are run (default 3)
+//   --traversal <mode>       per-term, batched or cte (default: the logic's)
+//   --in-memory              use the in-memory triple store
+//   --closure-table          build and use the closure table
+//   --persistent-cache       keep the persistent result cache on (default off)
+//   --seed <n>               seed of the generator (default 1)
+//   --output <file>          write the JSON there instead of the standard output
+//   --verbose                keep the logic's diagnostics
+
+// FacetedVisualizer Logic includes
+#include "vtkFacetedVisualizerLog.h"
+#include "vtkFacetedVisualizerResultCache.h"
+#include "vtkSlicerFacetedVisualizerLogic.h"
+
+// MRML includes
+#include <vtkMRMLModelDisplayNode.h>
+#include <vtkMRMLModelHierarchyNode.h>
+#include <vtkMRMLModelNode.h>
+#include <vtkMRMLScene.h>
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkTimerLog.h>
+#include <vtk_sqlite3.h>
+
+// STD includes
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+struct BenchmarkOptions
+{
+	std::string DBFileName;
+	bool ReuseDB;
+	unsigned long Triples;
+	int Depth;
+	int Branching;
+	double Synonyms;
+	int Models;
+	double Unmatched;
+	int Queries;
+	int Repetitions;
+	int TraversalMode;
+	bool InMemory;
+	bool ClosureTable;
+	bool PersistentCache;
+	unsigned long Seed;
+	std::string OutputFileName;
+	bool Verbose;
+};
+
+//----------------------------------------------------------------------------
+// Linear congruential generator, so that a seed gives the same ontology on every platform
+class BenchmarkRandom
+{
+public:
+	explicit BenchmarkRandom(unsigned long seed)
+	{
+		this->State = seed & 0x7fffffffUL;
+	}
+
+	// uniform in [0, n)
+	unsigned long Next(unsigned long n)
+	{
+		this->State = (1103515245UL * this->State + 12345UL) & 0x7fffffffUL;
+		return (this->State >> 4) % n;
+	}
+
+	bool Chance(double probability)
+	{
+		return this->Next(1000000) < static_cast< unsigned long >(probability * 1000000.0);
+	}
+
+private:
+	unsigned long State;
+};
+
+//----------------------------------------------------------------------------
+const char *Parts[] = { "regional_part", "constitutional_part", "systemic_part" };
+const char *PartsOf[] = { "regional_part_of", "constitutional_part_of", "systemic_part_of" };
+
+//----------------------------------------------------------------------------
+struct OntologyTerm
+{
+	std::string Name;     // DB form, "Part_0_2_1"
+	std::string Synonym;  // empty if the term has none
+	int Parent;
+	int Part;             // index in Parts of the relation of the parent to the term
+	int Depth;
+};
+
+//----------------------------------------------------------------------------
+struct Ontology
+{
+	std::vector< OntologyTerm > Terms;
+	std::vector< std::vector< int > > TermsByDepth;
+	std::vector< int > ModelTerms;  // terms with a model in the scene
+	unsigned long Triples;
+};
+
+//----------------------------------------------------------------------------
+struct TimingSeries
+{
+	std::string Operation;
+	std::string Mix;
+	std::string Cache;
+	std::vector< double > Seconds;
+};
+
+//----------------------------------------------------------------------------
+// "Part_0_2_1" as a user types it: "part 0 2 1"
+std::string ToTypedForm(const std::string &name)
+{
+	std::string typed = name;
+	for (size_t n = 0; n < typed.size(); ++n)
+	{
+		typed[n] = typed[n] == '_' ? ' ' : static_cast< char >(std::tolower(typed[n]));
+	}
+	return typed;
+}
+
+//----------------------------------------------------------------------------
+double EstimateTriples(int depth, int branching, double synonyms)
+{
+	// per term: the part-of relation both ways, a definition and an FMA ID, plus the
+	// synonyms and the non-English equivalents stored both ways
+	double termsAtDepth = 1.0;
+	double terms = 1.0;
+	for (int d = 0; d < depth; ++d)
+	{
+		termsAtDepth *= branching;
+		terms += termsAtDepth;
+	}
+	return terms * (4.0 + 2.0 * synonyms);
+}
+
+//----------------------------------------------------------------------------
+class TripleWriter
+{
+public:
+	TripleWriter(vtk_sqlite3_stmt *insert, unsigned long &count)
+		: Insert(insert), Count(count)
+	{
+	}
+
+	void Write(const std::string &subject, const char *predicate, const std::string &object)
+	{
+		vtk_sqlite3_bind_text(this->Insert, 1, subject.c_str(), -1, VTK_SQLITE_TRANSIENT);
+		vtk_sqlite3_bind_text(this->Insert, 2, predicate, -1, VTK_SQLITE_STATIC);
+		vtk_sqlite3_bind_text(this->Insert, 3, object.c_str(), -1, VTK_SQLITE_TRANSIENT);
+		vtk_sqlite3_step(this->Insert);
+		vtk_sqlite3_reset(this->Insert);
+		++this->Count;
+	}
+
+private:
+	vtk_sqlite3_stmt *Insert;
+	unsigned long &Count;
+};
+
+//----------------------------------------------------------------------------
+// Generates the terms breadth first until the hierarchy is options.Depth deep or the
+// triples reach options.Triples, and writes them to a new resources table unless the DB
+// is reused. The terms are generated either way, the queries and the scene need them.
+bool GenerateOntology(const BenchmarkOptions &options, int branching, bool writeDB,
+		Ontology &ontology)
+{
+	vtk_sqlite3 *db = NULL;
+	vtk_sqlite3_stmt *insert = NULL;
+	if(writeDB)
+	{
+		std::remove(options.DBFileName.c_str());
+		if(vtk_sqlite3_open(options.DBFileName.c_str(), &db) != VTK_SQLITE_OK)
+		{
+			std::cerr << "Could not create " << options.DBFileName << std::endl;
+			return false;
+		}
+		const char *unused;
+		if(vtk_sqlite3_exec(db, "CREATE TABLE resources(subject TEXT, predicate TEXT, object TEXT);"
+				"BEGIN", NULL, NULL, NULL) != VTK_SQLITE_OK ||
+		   vtk_sqlite3_prepare_v2(db, "INSERT INTO resources VALUES(?1, ?2, ?3)", -1,
+				&insert, &unused) != VTK_SQLITE_OK)
+		{
+			std::cerr << "Could not write " << options.DBFileName << ": " << vtk_sqlite3_errmsg(db) << std::endl;
+			vtk_sqlite3_close(db);
+			return false;
+		}
+	}
+
+	BenchmarkRandom random(options.Seed);
+	unsigned long triples = 0;
+	ontology.Terms.clear();
+	ontology.TermsByDepth.assign(options.Depth + 1, std::vector< int >());
+
+	OntologyTerm root;
+	root.Name = "Body";
+	root.Parent = -1;
+	root.Part = 0;
+	root.Depth = 0;
+	ontology.Terms.push_back(root);
+	ontology.TermsByDepth[0].push_back(0);
+
+	for (int depth = 1; depth <= options.Depth && triples < options.Triples; ++depth)
+	{
+		const std::vector< int > &parents = ontology.TermsByDepth[depth - 1];
+		for (size_t p = 0; p < parents.size() && triples < options.Triples; ++p)
+		{
+			for (int c = 0; c < branching && triples < options.Triples; ++c)
+			{
+				OntologyTerm term;
+				std::ostringstream name;
+				name << (parents[p] == 0 ? std::string("Part") : ontology.Terms[parents[p]].Name) << "_" << c;
+				term.Name = name.str();
+				term.Parent = parents[p];
+				term.Depth = depth;
+
+				// mostly regional parts, as in the FMA
+				unsigned long kind = random.Next(20);
+				term.Part = kind < 12 ? 0 : (kind < 17 ? 1 : 2);
+				bool synonym = random.Chance(options.Synonyms);
+				bool nonEnglish = random.Chance(options.Synonyms / 2.0);
+				if(synonym)
+				{
+					// only the first letter of DB terms is upper case, as ToDBForm makes it
+					term.Synonym = "Alt_" + term.Name;
+					for (size_t n = 1; n < term.Synonym.size(); ++n)
+					{
+						term.Synonym[n] = static_cast< char >(std::tolower(term.Synonym[n]));
+					}
+				}
+
+				std::ostringstream fmaid;
+				fmaid << 100000 + ontology.Terms.size();
+				if(writeDB)
+				{
+					TripleWriter writer(insert, triples);
+					const std::string &parentName = ontology.Terms[parents[p]].Name;
+					writer.Write(parentName, Parts[term.Part], term.Name);
+					writer.Write(term.Name, PartsOf[term.Part], parentName);
+					writer.Write(term.Name, "definition", "Synthetic part " + term.Name);
+					writer.Write(term.Name, "fmaid", fmaid.str());
+					if(synonym)
+					{
+						writer.Write(term.Name, "synonym", term.Synonym);
+					}
+					if(nonEnglish)
+					{
+						writer.Write("Pars_" + term.Name, "non_english_equivalent", term.Name);
+						writer.Write(term.Name, "non_english_equivalent", "Pars_" + term.Name);
+					}
+				}
+				else
+				{
+					triples += 4 + (synonym ? 1 : 0) + (nonEnglish ? 2 : 0);
+				}
+
+				ontology.TermsByDepth[depth].push_back(static_cast< int >(ontology.Terms.size()));
+				ontology.Terms.push_back(term);
+			}
+		}
+	}
+	ontology.Triples = triples;
+
+	if(writeDB)
+	{
+		vtk_sqlite3_finalize(insert);
+		vtk_sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
+		vtk_sqlite3_close(db);
+		std::remove((options.DBFileName + ".indexed.sqlite3").c_str());
+		std::remove((options.DBFileName + ".results.sqlite3").c_str());
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------
+// One model per picked term under an "Atlas" hierarchy node, as in the atlases the module
+// is used with. Some models get a name that is not in the DB, the synchronization then
+// has to fall back to fuzzy matching for them.
+void GenerateScene(const BenchmarkOptions &options, Ontology &ontology, vtkMRMLScene *scene)
+{
+	BenchmarkRandom random(options.Seed + 1);
+
+	vtkNew< vtkMRMLModelHierarchyNode > atlas;
+	atlas->SetName("Atlas");
+	scene->AddNode(atlas.GetPointer());
+
+	int numberOfModels = std::min(options.Models, static_cast< int >(ontology.Terms.size()) - 1);
+	std::vector< bool > picked(ontology.Terms.size(), false);
+	for (int m = 0; m < numberOfModels; ++m)
+	{
+		// favor the deeper levels, atlases mostly model the leaves of the hierarchy
+		int depth = static_cast< int >(ontology.TermsByDepth.size()) - 1;
+		while(depth > 1 && (ontology.TermsByDepth[depth].empty() || random.Chance(0.3)))
+		{
+			--depth;
+		}
+		const std::vector< int > &level = ontology.TermsByDepth[depth];
+		int term = level[random.Next(level.size())];
+		if(picked[term])
+		{
+			continue;
+		}
+		picked[term] = true;
+		ontology.ModelTerms.push_back(term);
+
+		std::string name = ToTypedForm(ontology.Terms[term].Name);
+		if(random.Chance(options.Unmatched))
+		{
+			name = "left " + name;
+		}
+
+		vtkNew< vtkMRMLModelNode > model;
+		model->SetName(name.c_str());
+		scene->AddNode(model.GetPointer());
+		vtkNew< vtkMRMLModelDisplayNode > display;
+		scene->AddNode(display.GetPointer());
+		model->SetAndObserveDisplayNodeID(display->GetID());
+
+		vtkNew< vtkMRMLModelHierarchyNode > hierarchy;
+		hierarchy->SetName(name.c_str());
+		scene->AddNode(hierarchy.GetPointer());
+		hierarchy->SetParentNodeID(atlas->GetID());
+		hierarchy->SetAssociatedNodeID(model->GetID());
+	}
+}
+
+//----------------------------------------------------------------------------
+size_t CountResults(const std::vector< std::vector< std::string > > &results)
+{
+	size_t count = 0;
+	for (size_t n = 0; n < results.size(); ++n)
+	{
+		count += results[n].size();
+	}
+	return count;
+}
+
+//----------------------------------------------------------------------------
+int PickTerm(const Ontology &ontology, BenchmarkRandom &random, int minimumDepth, int maximumDepth)
+{
+	int depth = minimumDepth + static_cast< int >(random.Next(maximumDepth - minimumDepth + 1));
+	while(depth > 0 && ontology.TermsByDepth[depth].empty())
+	{
+		--depth;
+	}
+	const std::vector< int > &level = ontology.TermsByDepth[depth];
+	return level[random.Next(level.size())];
+}
+
+//----------------------------------------------------------------------------
+// Mixes of the queries users type: whole subtrees, leaves, a single relation, synonyms
+// and set operations over related terms
+void GenerateQueryMixes(const BenchmarkOptions &options, const Ontology &ontology,
+		std::vector< std::string > &mixes, std::vector< std::vector< std::string > > &queries)
+{
+	BenchmarkRandom random(options.Seed + 2);
+	int deepest = static_cast< int >(ontology.TermsByDepth.size()) - 1;
+	while(deepest > 0 && ontology.TermsByDepth[deepest].empty())
+	{
+		--deepest;
+	}
+	int middle = std::max(1, deepest / 2);
+
+	mixes.push_back("root");
+	queries.push_back(std::vector< std::string >(1, "body"));
+
+	mixes.push_back("subtree");
+	mixes.push_back("leaf");
+	mixes.push_back("predicate");
+	mixes.push_back("synonym");
+	mixes.push_back("compound");
+	queries.resize(mixes.size());
+	std::vector< std::string > &subtree = queries[1];
+	std::vector< std::string > &leaf = queries[2];
+	std::vector< std::string > &predicate = queries[3];
+	std::vector< std::string > &synonym = queries[4];
+	std::vector< std::string > &compound = queries[5];
+
+	for (int q = 0; q < options.Queries; ++q)
+	{
+		const OntologyTerm &inner = ontology.Terms[PickTerm(ontology, random, 1, middle)];
+		subtree.push_back(ToTypedForm(inner.Name));
+		// the terms of models, mostly leaves, as users look up single structures of the atlas
+		int modelTerm = ontology.ModelTerms.empty() ? PickTerm(ontology, random, deepest, deepest) :
+				ontology.ModelTerms[random.Next(ontology.ModelTerms.size())];
+		leaf.push_back(ToTypedForm(ontology.Terms[modelTerm].Name));
+		// the relation of the parent of a model to it, so that the query shows something
+		const OntologyTerm &modelPart = ontology.Terms[modelTerm];
+		predicate.push_back(ToTypedForm(ontology.Terms[std::max(modelPart.Parent, 0)].Name) + ";" +
+				Parts[modelPart.Part]);
+
+		// a term with a synonym, a few tries before settling for any term
+		int term = PickTerm(ontology, random, 1, deepest);
+		for (int t = 0; t < 20 && ontology.Terms[term].Synonym.empty(); ++t)
+		{
+			term = PickTerm(ontology, random, 1, deepest);
+		}
+		const OntologyTerm &synonymTerm = ontology.Terms[term];
+		synonym.push_back(ToTypedForm(synonymTerm.Synonym.empty() ? synonymTerm.Name : synonymTerm.Synonym));
+
+		// an ancestor with one of its descendants below the first level, so that it has
+		// an ancestor other than the root, and two unrelated terms
+		int descendant = PickTerm(ontology, random, std::min(std::max(middle, 2), deepest), deepest);
+		int ancestor = descendant;
+		while(ontology.Terms[ancestor].Depth > 1 && random.Chance(0.6))
+		{
+			ancestor = ontology.Terms[ancestor].Parent;
+		}
+		if(ancestor == descendant && ontology.Terms[ancestor].Parent > 0)
+		{
+			ancestor = ontology.Terms[ancestor].Parent;
+		}
+		std::string a = ToTypedForm(ontology.Terms[ancestor].Name);
+		std::string d = ToTypedForm(ontology.Terms[descendant].Name);
+		std::string other = ToTypedForm(ontology.Terms[PickTerm(ontology, random, 1, middle)].Name);
+		switch(q % 4)
+		{
+		case 0:
+			compound.push_back(a + " + " + other);
+			break;
+		case 1:
+			compound.push_back(a + " AND " + d);
+			break;
+		case 2:
+			compound.push_back(a + " - " + d);
+			break;
+		default:
+			// a complement alone lists no term, it needs a listed operand to show results
+			compound.push_back(a + " AND NOT " + d);
+			break;
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+// nearest rank percentile of sorted samples
+double Percentile(const std::vector< double > &sorted, double percent)
+{
+	size_t rank = static_cast< size_t >(percent / 100.0 * sorted.size() + 0.999999);
+	rank = std::max< size_t >(rank, 1);
+	return sorted[std::min(rank, sorted.size()) - 1];
+}
+
+//----------------------------------------------------------------------------
+std::string JSONString(const std::string &text)
+{
+	std::string quoted = "\"";
+	for (size_t n = 0; n < text.size(); ++n)
+	{
+		if(text[n] == '"' || text[n] == '\\')
+		{
+			quoted += '\\';
+		}
+		quoted += text[n];
+	}
+	return quoted + "\"";
+}
+
+//----------------------------------------------------------------------------
+void WriteJSON(std::ostream &os, const BenchmarkOptions &options, int branching,
+		const Ontology &ontology, double generationTime, double openTime,
+		const std::vector< TimingSeries > &series)
+{
+	os << "{\n";
+	os << "  \"benchmark\": \"FacetedVisualizer\",\n";
+	os << "  \"unit\": \"ms\",\n";
+	os << "  \"configuration\": {\"triples\": " << options.Triples << ", \"depth\": " << options.Depth
+			<< ", \"branching\": " << branching << ", \"synonyms\": " << options.Synonyms
+			<< ", \"models\": " << options.Models << ", \"unmatched\": " << options.Unmatched
+			<< ", \"queries\": " << options.Queries << ", \"repetitions\": " << options.Repetitions
+			<< ", \"traversal\": " << options.TraversalMode
+			<< ", \"in_memory\": " << (options.InMemory ? "true" : "false")
+			<< ", \"closure_table\": " << (options.ClosureTable ? "true" : "false")
+			<< ", \"persistent_cache\": " << (options.PersistentCache ? "true" : "false")
+			<< ", \"seed\": " << options.Seed << "},\n";
+	os << "  \"ontology\": {\"triples\": " << ontology.Triples << ", \"terms\": " << ontology.Terms.size()
+			<< ", \"generation_ms\": " << generationTime * 1000.0
+			<< ", \"open_ms\": " << openTime * 1000.0 << "},\n";
+	os << "  \"results\": [";
+	for (size_t s = 0; s < series.size(); ++s)
+	{
+		std::vector< double > sorted = series[s].Seconds;
+		if(sorted.empty())
+		{
+			continue;
+		}
+		std::sort(sorted.begin(), sorted.end());
+		double total = 0.0;
+		for (size_t n = 0; n < sorted.size(); ++n)
+		{
+			total += sorted[n];
+		}
+		os << (s > 0 ? ",\n" : "\n");
+		os << "    {\"operation\": " << JSONString(series[s].Operation)
+				<< ", \"mix\": " << JSONString(series[s].Mix)
+				<< ", \"cache\": " << JSONString(series[s].Cache)
+				<< ", \"samples\": " << sorted.size()
+				<< ", \"min\": " << sorted.front() * 1000.0
+				<< ", \"p50\": " << Percentile(sorted, 50.0) * 1000.0
+				<< ", \"p90\": " << Percentile(sorted, 90.0) * 1000.0
+				<< ", \"p95\": " << Percentile(sorted, 95.0) * 1000.0
+				<< ", \"p99\": " << Percentile(sorted, 99.0) * 1000.0
+				<< ", \"max\": " << sorted.back() * 1000.0
+				<< ", \"mean\": " << total / sorted.size() * 1000.0 << "}";
+	}
+	os << "\n  ]\n}\n";
+}
+
+//----------------------------------------------------------------------------
+bool ParseOptions(int argc, char *argv[], BenchmarkOptions &options)
+{
+	options.DBFileName = "FacetedVisualizerBenchmark.sqlite3";
+	options.ReuseDB = false;
+	options.Triples = 100000;
+	options.Depth = 6;
+	options.Branching = 0;
+	options.Synonyms = 0.3;
+	options.Models = 300;
+	options.Unmatched = 0.05;
+	options.Queries = 10;
+	options.Repetitions = 3;
+	options.TraversalMode = -1;
+	options.InMemory = false;
+	options.ClosureTable = false;
+	options.PersistentCache = false;
+	options.Seed = 1;
+	options.Verbose = false;
+
+	for (int n = 1; n < argc; ++n)
+	{
+		std::string option = argv[n];
+		const char *value = n + 1 < argc ? argv[n + 1] : NULL;
+		bool usesValue = true;
+		if(option == "--reuse-db" || option == "--in-memory" || option == "--closure-table" ||
+		   option == "--persistent-cache" || option == "--verbose")
+		{
+			usesValue = false;
+			options.ReuseDB = options.ReuseDB || option == "--reuse-db";
+			options.InMemory = options.InMemory || option == "--in-memory";
+			options.ClosureTable = options.ClosureTable || option == "--closure-table";
+			options.PersistentCache = options.PersistentCache || option == "--persistent-cache";
+			options.Verbose = options.Verbose || option == "--verbose";
+		}
+		else if(value == NULL)
+		{
+			std::cerr << "Missing value of " << option << std::endl;
+			return false;
+		}
+		else if(option == "--db")
+		{
+			options.DBFileName = value;
+		}
+		else if(option == "--triples")
+		{
+			options.Triples = std::strtoul(value, NULL, 10);
+		}
+		else if(option == "--depth")
+		{
+			options.Depth = std::atoi(value);
+		}
+		else if(option == "--branching")
+		{
+			options.Branching = std::atoi(value);
+		}
+		else if(option == "--synonyms")
+		{
+			options.Synonyms = std::atof(value);
+		}
+		else if(option == "--models")
+		{
+			options.Models = std::atoi(value);
+		}
+		else if(option == "--unmatched")
+		{
+			options.Unmatched = std::atof(value);
+		}
+		else if(option == "--queries")
+		{
+			options.Queries = std::atoi(value);
+		}
+		else if(option == "--repetitions")
+		{
+			options.Repetitions = std::atoi(value);
+		}
+		else if(option == "--traversal")
+		{
+			std::string mode = value;
+			options.TraversalMode = mode == "per-term" ? vtkSlicerFacetedVisualizerLogic::TraversalPerTerm :
+					(mode == "batched" ? vtkSlicerFacetedVisualizerLogic::TraversalBatched :
+					(mode == "cte" ? vtkSlicerFacetedVisualizerLogic::TraversalRecursiveCTE : -2));
+			if(options.TraversalMode == -2)
+			{
+				std::cerr << "Unknown traversal mode " << mode << std::endl;
+				return false;
+			}
+		}
+		else if(option == "--seed")
+		{
+			options.Seed = std::strtoul(value, NULL, 10);
+		}
+		else if(option == "--output")
+		{
+			options.OutputFileName = value;
+		}
+		else
+		{
+			std::cerr << "Unknown option " << option << std::endl;
+			return false;
+		}
+		if(usesValue)
+		{
+			++n;
+		}
+	}
+
+	if(options.Triples < 10 || options.Depth < 1 || options.Models < 1 || options.Queries < 1 ||
+	   options.Repetitions < 1)
+	{
+		std::cerr << "--triples, --depth, --models, --queries and --repetitions must be positive" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------
+// index of a new, empty series
+size_t AddSeries(std::vector< TimingSeries > &series, const std::string &operation,
+		const std::string &mix, const std::string &cache)
+{
+	TimingSeries timing;
+	timing.Operation = operation;
+	timing.Mix = mix;
+	timing.Cache = cache;
+	series.push_back(timing);
+	return series.size() - 1;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+	BenchmarkOptions options;
+	if(!ParseOptions(argc, argv, options))
+	{
+		return EXIT_FAILURE;
+	}
+	if(!options.Verbose)
+	{
+		vtkFacetedVisualizerLog::SetLevel(FACETEDVISUALIZER_LOG_NONE);
+	}
+
+	int branching = options.Branching;
+	if(branching < 1)
+	{
+		branching = 2;
+		while(EstimateTriples(options.Depth, branching, options.Synonyms) < options.Triples)
+		{
+			++branching;
+		}
+	}
+
+	bool writeDB = true;
+	if(options.ReuseDB)
+	{
+		std::ifstream existing(options.DBFileName.c_str());
+		writeDB = !existing.good();
+	}
+	Ontology ontology;
+	double start = vtkTimerLog::GetUniversalTime();
+	if(!GenerateOntology(options, branching, writeDB, ontology))
+	{
+		return EXIT_FAILURE;
+	}
+	double generationTime = writeDB ? vtkTimerLog::GetUniversalTime() - start : 0.0;
+
+	vtkNew< vtkMRMLScene > scene;
+	GenerateScene(options, ontology, scene.GetPointer());
+
+	vtkNew< vtkSlicerFacetedVisualizerLogic > logic;
+	logic->SetMRMLScene(scene.GetPointer());
+	logic->SetUsePersistentCache(options.PersistentCache);
+	logic->SetUseInMemoryStore(options.InMemory);
+	if(options.TraversalMode >= 0)
+	{
+		logic->SetTraversalMode(options.TraversalMode);
+	}
+
+	// opening includes building the indexed copy of the new DB and loading the term dictionary
+	start = vtkTimerLog::GetUniversalTime();
+	logic->SetDBFileName(options.DBFileName);
+	if(options.ClosureTable && !logic->BuildClosureTable())
+	{
+		std::cerr << "Could not build the closure table" << std::endl;
+		return EXIT_FAILURE;
+	}
+	double openTime = vtkTimerLog::GetUniversalTime() - start;
+
+	std::vector< TimingSeries > series;
+	size_t synchronization = AddSeries(series, "SynchronizeAtlasWithDB", "atlas", "none");
+	for (int r = 0; r < options.Repetitions; ++r)
+	{
+		std::vector< std::vector< std::string > > matchingDBAtoms;
+		std::vector< std::string > unMatchedMRMLAtoms;
+		start = vtkTimerLog::GetUniversalTime();
+		logic->SynchronizeAtlasWithDB(matchingDBAtoms, unMatchedMRMLAtoms);
+		series[synchronization].Seconds.push_back(vtkTimerLog::GetUniversalTime() - start);
+	}
+
+	std::vector< std::string > mixes;
+	std::vector< std::vector< std::string > > queries;
+	GenerateQueryMixes(options, ontology, mixes, queries);
+	int failedQueries = 0;
+	for (size_t m = 0; m < mixes.size(); ++m)
+	{
+		size_t cold = AddSeries(series, "ProcessQuery", mixes[m], "cold");
+		size_t warm = AddSeries(series, "ProcessQuery", mixes[m], "warm");
+		size_t results = AddSeries(series, "GetQueryResults", mixes[m], "warm");
+		for (int r = 0; r < options.Repetitions; ++r)
+		{
+			for (size_t q = 0; q < queries[m].size(); ++q)
+			{
+				logic->SetQuery(queries[m][q]);
+
+				// cold: nothing of the query is in the result cache
+				logic->GetResultCache()->Clear();
+				start = vtkTimerLog::GetUniversalTime();
+				logic->ProcessQuery();
+				series[cold].Seconds.push_back(vtkTimerLog::GetUniversalTime() - start);
+
+				// timings of queries that find nothing or change when cached are meaningless
+				std::vector< std::vector< std::string > > coldResults;
+				std::vector< std::string > coldTerms;
+				logic->GetQueryResults(coldResults, coldTerms);
+				if(CountResults(coldResults) == 0)
+				{
+					std::cerr << "No results for the " << mixes[m] << " query \"" << queries[m][q]
+							<< "\"" << std::endl;
+					++failedQueries;
+				}
+
+				start = vtkTimerLog::GetUniversalTime();
+				logic->ProcessQuery();
+				series[warm].Seconds.push_back(vtkTimerLog::GetUniversalTime() - start);
+
+				std::vector< std::vector< std::string > > queryResults;
+				std::vector< std::string > queryTerms;
+				start = vtkTimerLog::GetUniversalTime();
+				logic->GetQueryResults(queryResults, queryTerms);
+				series[results].Seconds.push_back(vtkTimerLog::GetUniversalTime() - start);
+				if(queryResults != coldResults || queryTerms != coldTerms)
+				{
+					std::cerr << "The warm results of the " << mixes[m] << " query \"" << queries[m][q]
+							<< "\" differ from the cold ones" << std::endl;
+					++failedQueries;
+				}
+			}
+		}
+	}
+
+	if(options.OutputFileName.empty())
+	{
+		WriteJSON(std::cout, options, branching, ontology, generationTime, openTime, series);
+	}
+	else
+	{
+		std::ofstream output(options.OutputFileName.c_str());
+		if(!output)
+		{
+			std::cerr << "Could not write " << options.OutputFileName << std::endl;
+			return EXIT_FAILURE;
+		}
+		WriteJSON(output, options, branching, ontology, generationTime, openTime, series);
+	}
+	return failedQueries == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
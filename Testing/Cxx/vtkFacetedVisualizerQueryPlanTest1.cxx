@@ -0,0 +1,219 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// FacetedVisualizer Logic includes
+#include "vtkFacetedVisualizerQueryPlan.h"
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Writes the subtree of a step in postfix notation: [term], |n and &n for unions and
+// intersections of n operands, - for a difference and ~ for a complement
+bool WritePostfix(const vtkFacetedVisualizerQueryPlan &plan, int index, std::ostream &os)
+{
+	const vtkFacetedVisualizerQueryPlan::Step &step = plan.GetStep(static_cast< unsigned int >(index));
+	for (size_t n = 0; n < step.Operands.size(); ++n)
+	{
+		// the steps must come after the steps of their operands
+		if(step.Operands[n] < 0 || step.Operands[n] >= index ||
+		   !WritePostfix(plan, step.Operands[n], os))
+		{
+			return false;
+		}
+		os << " ";
+	}
+	switch(step.Type)
+	{
+		case vtkFacetedVisualizerQueryPlan::TermStep:
+			os << "[" << plan.GetTerm(static_cast< unsigned int >(step.Term)) << "]";
+			return step.Operands.empty();
+		case vtkFacetedVisualizerQueryPlan::UnionStep:
+			os << "|" << step.Operands.size();
+			return step.Operands.size() >= 2;
+		case vtkFacetedVisualizerQueryPlan::IntersectStep:
+			os << "&" << step.Operands.size();
+			return step.Operands.size() >= 2;
+		case vtkFacetedVisualizerQueryPlan::SubtractStep:
+			os << "-";
+			return step.Operands.size() == 2;
+		case vtkFacetedVisualizerQueryPlan::ComplementStep:
+			os << "~";
+			return step.Operands.size() == 1;
+	}
+	return false;
+}
+
+//----------------------------------------------------------------------------
+bool TestPlan(int line, const std::string &query, const std::string &expected)
+{
+	vtkFacetedVisualizerQueryPlan plan;
+	if(!plan.Compile(query))
+	{
+		std::cerr << "Line " << line << ": \"" << query << "\" does not compile: "
+				<< plan.GetError() << std::endl;
+		return false;
+	}
+	std::ostringstream postfix;
+	bool wellFormed = WritePostfix(plan, plan.GetRootStep(), postfix);
+	if(!wellFormed || postfix.str() != expected)
+	{
+		std::cerr << "Line " << line << ": \"" << query << "\" gives " << postfix.str()
+				<< (wellFormed ? "" : " (malformed)") << " instead of " << expected << std::endl;
+		return false;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------
+bool TestError(int line, const std::string &query, const std::string &expected)
+{
+	vtkFacetedVisualizerQueryPlan plan;
+	if(plan.Compile(query) || plan.IsValid() || plan.GetNumberOfSteps() != 0)
+	{
+		std::cerr << "Line " << line << ": \"" << query << "\" compiles" << std::endl;
+		return false;
+	}
+	if(plan.GetError() != expected)
+	{
+		std::cerr << "Line " << line << ": \"" << query << "\" fails with \"" << plan.GetError()
+				<< "\" instead of \"" << expected << "\"" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------
+// expected is the text of the term at position, "" if there is none
+bool TestTermAt(int line, const std::string &query, size_t position, const std::string &expected)
+{
+	size_t begin, end;
+	bool found = vtkFacetedVisualizerQueryPlan::FindTermAt(query, position, begin, end);
+	std::string term = found ? query.substr(begin, end - begin) : "";
+	if(found != !expected.empty() || term != expected)
+	{
+		std::cerr << "Line " << line << ": the term at " << position << " of \"" << query
+				<< "\" is \"" << term << "\" instead of \"" << expected << "\"" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkFacetedVisualizerQueryPlanTest1(int vtkNotUsed(argc), char * vtkNotUsed(argv)[])
+{
+	bool ok = true;
+
+	// terms, lower case and trimmed
+	ok = TestPlan(__LINE__, "Brain", "[brain]") && ok;
+	ok = TestPlan(__LINE__, "  Left   Hemisphere ", "[left hemisphere]") && ok;
+
+	// precedence: AND binds tighter than OR, parentheses override it
+	ok = TestPlan(__LINE__, "a OR b AND c", "[a] [b] [c] &2 |2") && ok;
+	ok = TestPlan(__LINE__, "a AND b OR c", "[a] [b] &2 [c] |2") && ok;
+	ok = TestPlan(__LINE__, "(a OR b) AND c", "[a] [b] |2 [c] &2") && ok;
+
+	// chains of unions or intersections are one step, whatever the operator spelling
+	ok = TestPlan(__LINE__, "a OR b + c, d", "[a] [b] [c] [d] |4") && ok;
+	ok = TestPlan(__LINE__, "a AND (b AND c)", "[a] [b] [c] &3") && ok;
+
+	// the difference is left associative and has the precedence of the union
+	ok = TestPlan(__LINE__, "a - b - c", "[a] [b] - [c] -") && ok;
+	ok = TestPlan(__LINE__, "a - (b - c)", "[a] [b] [c] - -") && ok;
+	ok = TestPlan(__LINE__, "a - b OR c", "[a] [b] - [c] |2") && ok;
+	ok = TestPlan(__LINE__, "a - b AND c", "[a] [b] [c] &2 -") && ok;
+	ok = TestPlan(__LINE__, "(a)-(b)", "[a] [b] -") && ok;
+
+	// hyphens inside words do not subtract
+	ok = TestPlan(__LINE__, "left-hemisphere", "[left-hemisphere]") && ok;
+	ok = TestPlan(__LINE__, "left-hemisphere - brain", "[left-hemisphere] [brain] -") && ok;
+	ok = TestPlan(__LINE__, "a -b", "[a -b]") && ok;
+
+	// quoted phrases keep operators and delimiters as text; lower case operators are words
+	ok = TestPlan(__LINE__, "'liver AND kidney' OR brain", "[liver and kidney] [brain] |2") && ok;
+	ok = TestPlan(__LINE__, "'a, (b) - c'", "[a, (b) - c]") && ok;
+	ok = TestPlan(__LINE__, "liver and kidney", "[liver and kidney]") && ok;
+
+	// complement
+	ok = TestPlan(__LINE__, "NOT a", "[a] ~") && ok;
+	ok = TestPlan(__LINE__, "NOT a AND b", "[a] ~ [b] &2") && ok;
+	ok = TestPlan(__LINE__, "NOT (a OR b)", "[a] [b] |2 ~") && ok;
+	ok = TestPlan(__LINE__, "NOT NOT a", "[a] ~ ~") && ok;
+
+	// repeated terms are evaluated once; subtracted and negated terms are not listed
+	vtkFacetedVisualizerQueryPlan plan;
+	if(!plan.Compile("a - b OR NOT c OR (A AND c)") || plan.GetNumberOfTerms() != 3 ||
+	   plan.GetTerm(0) != "a" || plan.GetTerm(1) != "b" || plan.GetTerm(2) != "c" ||
+	   !plan.IsTermListed(0) || plan.IsTermListed(1) || !plan.IsTermListed(2))
+	{
+		std::cerr << "Line " << __LINE__ << ": wrong terms of \"a - b OR NOT c OR (A AND c)\"" << std::endl;
+		ok = false;
+	}
+	if(!plan.Compile("a - b") || plan.GetNumberOfTerms() != 2 || plan.IsTermListed(1))
+	{
+		std::cerr << "Line " << __LINE__ << ": \"b\" is listed in \"a - b\"" << std::endl;
+		ok = false;
+	}
+
+	// errors: unbalanced parentheses, missing operands
+	ok = TestError(__LINE__, "", "the query is empty") && ok;
+	ok = TestError(__LINE__, "   ", "the query is empty") && ok;
+	ok = TestError(__LINE__, "(a OR b", "missing ')' for the '(' at 0") && ok;
+	ok = TestError(__LINE__, "a AND ((b OR c)", "missing ')' for the '(' at 6") && ok;
+	ok = TestError(__LINE__, "a OR b)", "unexpected ')' at 6") && ok;
+	ok = TestError(__LINE__, "()", "a term is missing before ')' at 1") && ok;
+	ok = TestError(__LINE__, "a OR", "a term is missing at the end of the query") && ok;
+	ok = TestError(__LINE__, "a -", "a term is missing at the end of the query") && ok;
+	ok = TestError(__LINE__, "NOT", "a term is missing at the end of the query") && ok;
+	ok = TestError(__LINE__, "a AND OR b", "a term is missing before 'OR' at 6") && ok;
+	ok = TestError(__LINE__, "AND a", "a term is missing before 'AND' at 0") && ok;
+	ok = TestError(__LINE__, "a, , b", "a term is missing before ',' at 3") && ok;
+	ok = TestError(__LINE__, "'liver", "missing closing quote of the term at 0") && ok;
+
+	// the term under the cursor, as completed while typing
+	ok = TestTermAt(__LINE__, "liver AND kid", 13, "kid") && ok;
+	ok = TestTermAt(__LINE__, "liver AND kid", 2, "liver") && ok;
+	ok = TestTermAt(__LINE__, "liver AND kid", 5, "liver") && ok;
+	ok = TestTermAt(__LINE__, "liver AND kid", 7, "") && ok;
+	ok = TestTermAt(__LINE__, "(right lobe) - brain", 8, "right lobe") && ok;
+	ok = TestTermAt(__LINE__, "(right lo)", 9, "right lo") && ok;
+	ok = TestTermAt(__LINE__, "a, ", 3, "") && ok;
+	ok = TestTermAt(__LINE__, "NOT 'left hem", 13, "left hem") && ok;
+	ok = TestTermAt(__LINE__, "'left hemisphere' OR b", 3, "left hemisphere") && ok;
+
+	// a failed compilation leaves no steps behind from the previous query
+	if(!plan.Compile("a OR b") || plan.Compile("a OR (") || plan.GetNumberOfSteps() != 0 ||
+	   plan.GetNumberOfTerms() != 0)
+	{
+		std::cerr << "Line " << __LINE__ << ": a failed compilation keeps steps" << std::endl;
+		ok = false;
+	}
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,156 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+
+// FacetedVisualizer Logic includes
+#include "vtkFacetedVisualizerResultCache.h"
+
+// VTK includes
+#include <vtkNew.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Inserts an entry whose status is its number and whose display set holds that bit
+void Insert(vtkFacetedVisualizerResultCache *cache, const std::string &key, int number,
+		const std::vector< std::string > &results)
+{
+	vtkFacetedVisualizerBitSet display(64);
+	display.Set(static_cast< unsigned int >(number));
+	cache->Insert(key, number, results, display);
+}
+
+//----------------------------------------------------------------------------
+bool Lookup(vtkFacetedVisualizerResultCache *cache, const std::string &key, int number,
+		const std::vector< std::string > &expected)
+{
+	int status = -1;
+	std::vector< std::string > results;
+	vtkFacetedVisualizerBitSet display;
+	if(!cache->Lookup(key, status, results, display))
+	{
+		return false;
+	}
+	if(status != number || results != expected || !display.Test(static_cast< unsigned int >(number)))
+	{
+		std::cerr << "Line " << __LINE__ << ": entry " << key << " comes back modified" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+} // end of anonymous namespace
+
+#define CHECK(condition) \
+	if(!(condition)) \
+	{ \
+		std::cerr << "Line " << __LINE__ << ": failed " #condition << std::endl; \
+		return EXIT_FAILURE; \
+	}
+
+//----------------------------------------------------------------------------
+int vtkFacetedVisualizerResultCacheTest1(int vtkNotUsed(argc), char * vtkNotUsed(argv)[])
+{
+	vtkNew< vtkFacetedVisualizerResultCache > cache;
+	std::vector< std::string > results;
+	results.push_back("Brain regional_part Cerebellum");
+	results.push_back("Cerebellum regional_part Cerebellar_cortex");
+
+	// hits and misses
+	CHECK(!Lookup(cache.GetPointer(), "key0", 0, results));
+	CHECK(cache->GetNumberOfMisses() == 1 && cache->GetNumberOfHits() == 0);
+	Insert(cache.GetPointer(), "key0", 0, results);
+	CHECK(cache->GetNumberOfEntries() == 1 && cache->Contains("key0"));
+	CHECK(Lookup(cache.GetPointer(), "key0", 0, results));
+	CHECK(cache->GetNumberOfMisses() == 1 && cache->GetNumberOfHits() == 1);
+	CHECK(!Lookup(cache.GetPointer(), "key1", 1, results));
+	CHECK(cache->GetNumberOfMisses() == 2);
+
+	// replacing an entry keeps a single copy of it
+	unsigned long entryBytes = cache->GetSize();
+	CHECK(entryBytes > 0);
+	Insert(cache.GetPointer(), "key0", 0, results);
+	CHECK(cache->GetNumberOfEntries() == 1 && cache->GetSize() == entryBytes);
+
+	// keys of the same length give entries of the same size: room for three of them
+	cache->Clear();
+	cache->ResetStatistics();
+	cache->SetMaximumSize(3 * entryBytes);
+	Insert(cache.GetPointer(), "key0", 0, results);
+	Insert(cache.GetPointer(), "key1", 1, results);
+	Insert(cache.GetPointer(), "key2", 2, results);
+	CHECK(cache->GetNumberOfEntries() == 3 && cache->GetSize() == 3 * entryBytes);
+	CHECK(cache->GetNumberOfEvictions() == 0);
+
+	// looking key0 up makes key1 the least recently used entry
+	CHECK(Lookup(cache.GetPointer(), "key0", 0, results));
+	Insert(cache.GetPointer(), "key3", 3, results);
+	CHECK(cache->GetNumberOfEvictions() == 1);
+	CHECK(!cache->Contains("key1"));
+	CHECK(cache->Contains("key0") && cache->Contains("key2") && cache->Contains("key3"));
+
+	// Contains does not change the order: key2 goes next
+	CHECK(cache->Contains("key2"));
+	Insert(cache.GetPointer(), "key4", 4, results);
+	CHECK(!cache->Contains("key2"));
+	CHECK(cache->Contains("key0") && cache->Contains("key3") && cache->Contains("key4"));
+	CHECK(cache->GetSize() == 3 * entryBytes);
+
+	// an entry larger than the whole budget is not stored and evicts nothing
+	std::vector< std::string > largeResults(results);
+	largeResults.push_back(std::string(3 * entryBytes, 'x'));
+	Insert(cache.GetPointer(), "key5", 5, largeResults);
+	CHECK(!cache->Contains("key5"));
+	CHECK(cache->GetNumberOfEntries() == 3 && cache->GetNumberOfEvictions() == 2);
+
+	// an entry twice the size of the others evicts the two least recently used ones
+	std::vector< std::string > doubleResults(results);
+	doubleResults.push_back(std::string(entryBytes - sizeof(std::string), 'x'));
+	Insert(cache.GetPointer(), "key6", 6, doubleResults);
+	CHECK(cache->Contains("key6") && Lookup(cache.GetPointer(), "key6", 6, doubleResults));
+	CHECK(!cache->Contains("key0") && !cache->Contains("key3") && cache->Contains("key4"));
+	CHECK(cache->GetNumberOfEvictions() == 4);
+	CHECK(cache->GetSize() == 3 * entryBytes);
+
+	// lowering the budget evicts right away, least recently used first
+	cache->SetMaximumSize(2 * entryBytes);
+	CHECK(cache->GetNumberOfEntries() == 1 && cache->Contains("key6"));
+	CHECK(cache->GetSize() <= cache->GetMaximumSize());
+
+	// Clear drops the entries but keeps the statistics
+	cache->Clear();
+	CHECK(cache->GetNumberOfEntries() == 0 && cache->GetSize() == 0);
+	CHECK(!cache->Contains("key6") && !Lookup(cache.GetPointer(), "key6", 6, doubleResults));
+	CHECK(cache->GetNumberOfEvictions() == 5);
+	Insert(cache.GetPointer(), "key0", 0, results);
+	CHECK(Lookup(cache.GetPointer(), "key0", 0, results));
+
+	// a budget of 0 disables the cache
+	cache->SetMaximumSize(0);
+	CHECK(cache->GetNumberOfEntries() == 0);
+	Insert(cache.GetPointer(), "key0", 0, results);
+	CHECK(!cache->Contains("key0"));
+
+	return EXIT_SUCCESS;
+}
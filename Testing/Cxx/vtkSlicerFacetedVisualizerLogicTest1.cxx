@@ -0,0 +1,246 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// FacetedVisualizer Logic includes
+#include "vtkFacetedVisualizerResultCache.h"
+#include "vtkSlicerFacetedVisualizerLogic.h"
+
+// MRML includes
+#include <vtkMRMLModelDisplayNode.h>
+#include <vtkMRMLModelHierarchyNode.h>
+#include <vtkMRMLModelNode.h>
+#include <vtkMRMLScene.h>
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtk_sqlite3.h>
+
+// STD includes
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+bool CreateDB(const std::string &fileName)
+{
+	static const char *triples[][3] = {
+		{"Brain", "regional_part", "Cerebellum"},
+		{"Cerebellum", "regional_part_of", "Brain"},
+		{"Brain", "regional_part", "Cerebrum"},
+		{"Cerebrum", "regional_part_of", "Brain"},
+		{"Cerebellum", "regional_part", "Cerebellar_cortex"},
+		{"Cerebellar_cortex", "regional_part_of", "Cerebellum"},
+		{"Cerebrum", "regional_part", "Left_hemisphere"},
+		{"Left_hemisphere", "regional_part_of", "Cerebrum"},
+		{"Liver", "regional_part", "Right_lobe_of_liver"},
+		{"Right_lobe_of_liver", "regional_part_of", "Liver"}
+	};
+
+	std::remove(fileName.c_str());
+	std::remove((fileName + ".indexed.sqlite3").c_str());
+	std::remove((fileName + ".results.sqlite3").c_str());
+	vtk_sqlite3 *db;
+	if(vtk_sqlite3_open(fileName.c_str(), &db) != VTK_SQLITE_OK)
+	{
+		return false;
+	}
+	bool ok = vtk_sqlite3_exec(db, "CREATE TABLE resources(subject TEXT, predicate TEXT, object TEXT)",
+			NULL, NULL, NULL) == VTK_SQLITE_OK;
+	for (size_t n = 0; ok && n < sizeof(triples) / sizeof(triples[0]); ++n)
+	{
+		char *insert = vtk_sqlite3_mprintf("INSERT INTO resources VALUES('%q', '%q', '%q')",
+				triples[n][0], triples[n][1], triples[n][2]);
+		ok = vtk_sqlite3_exec(db, insert, NULL, NULL, NULL) == VTK_SQLITE_OK;
+		vtk_sqlite3_free(insert);
+	}
+	vtk_sqlite3_close(db);
+	return ok;
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLModelHierarchyNode* AddModel(vtkMRMLScene *scene, vtkMRMLModelHierarchyNode *atlas,
+		const char *name)
+{
+	vtkNew< vtkMRMLModelNode > model;
+	model->SetName(name);
+	scene->AddNode(model.GetPointer());
+	vtkNew< vtkMRMLModelDisplayNode > display;
+	scene->AddNode(display.GetPointer());
+	model->SetAndObserveDisplayNodeID(display->GetID());
+
+	vtkNew< vtkMRMLModelHierarchyNode > hierarchy;
+	hierarchy->SetName(name);
+	scene->AddNode(hierarchy.GetPointer());
+	hierarchy->SetParentNodeID(atlas->GetID());
+	hierarchy->SetAssociatedNodeID(model->GetID());
+	return hierarchy.GetPointer();
+}
+
+//----------------------------------------------------------------------------
+unsigned int CountResults(vtkSlicerFacetedVisualizerLogic *logic)
+{
+	std::vector< std::vector< std::string > > results;
+	std::vector< std::string > queries;
+	logic->GetQueryResults(results, queries);
+	unsigned int count = 0;
+	for (size_t n = 0; n < results.size(); ++n)
+	{
+		count += static_cast< unsigned int >(results[n].size());
+	}
+	return count;
+}
+
+//----------------------------------------------------------------------------
+bool IsShown(vtkMRMLModelHierarchyNode *hierarchy)
+{
+	return hierarchy->GetModelNode()->GetDisplayVisibility() != 0;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkSlicerFacetedVisualizerLogicTest1(int argc, char * argv[])
+{
+	std::string dbFileName = std::string(argc > 1 ? argv[1] : ".") +
+			"/vtkSlicerFacetedVisualizerLogicTest1.sqlite3";
+	if(!CreateDB(dbFileName))
+	{
+		std::cerr << "Line " << __LINE__ << ": could not create " << dbFileName << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	vtkNew< vtkMRMLScene > scene;
+	vtkNew< vtkMRMLModelHierarchyNode > atlas;
+	atlas->SetName("Atlas");
+	scene->AddNode(atlas.GetPointer());
+	vtkMRMLModelHierarchyNode *cerebellum = AddModel(scene.GetPointer(), atlas.GetPointer(), "cerebellum");
+	AddModel(scene.GetPointer(), atlas.GetPointer(), "cerebellar cortex");
+	AddModel(scene.GetPointer(), atlas.GetPointer(), "left hemisphere");
+	vtkMRMLModelHierarchyNode *liver = AddModel(scene.GetPointer(), atlas.GetPointer(), "right lobe of liver");
+	vtkMRMLModelHierarchyNode *spare = AddModel(scene.GetPointer(), atlas.GetPointer(), "spare");
+
+	vtkNew< vtkSlicerFacetedVisualizerLogic > logic;
+	logic->SetMRMLScene(scene.GetPointer());
+	logic->SetUsePersistentCache(false);
+	logic->SetDBFileName(dbFileName);
+	std::vector< std::vector< std::string > > matchingDBAtoms;
+	std::vector< std::string > unMatchedMRMLAtoms;
+	logic->SynchronizeAtlasWithDB(matchingDBAtoms, unMatchedMRMLAtoms);
+
+	logic->SetQuery("brain");
+	if(!logic->ProcessQuery() || CountResults(logic.GetPointer()) == 0)
+	{
+		std::cerr << "Line " << __LINE__ << ": \"brain\" shows nothing" << std::endl;
+		return EXIT_FAILURE;
+	}
+	unsigned int brainResults = CountResults(logic.GetPointer());
+
+	// a cancelled query must not stop the queries that follow it
+	logic->SetQuery("cerebellum");
+	logic->StartQuery();
+	logic->CancelQuery();
+	logic->GetResultCache()->Clear();
+	logic->SetQuery("brain");
+	if(!logic->ProcessQuery() || CountResults(logic.GetPointer()) != brainResults)
+	{
+		std::cerr << "Line " << __LINE__ << ": \"brain\" after a cancelled query gives "
+				<< CountResults(logic.GetPointer()) << " results instead of " << brainResults << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// the asynchronous path gives the same results
+	logic->GetResultCache()->Clear();
+	logic->StartQuery();
+	bool visualizedResults = false;
+	int state;
+	while((state = logic->FinishQuery(visualizedResults)) == vtkSlicerFacetedVisualizerLogic::QueryRunning)
+	{
+	}
+	if(state != vtkSlicerFacetedVisualizerLogic::QueryFinished || !visualizedResults ||
+	   CountResults(logic.GetPointer()) != brainResults)
+	{
+		std::cerr << "Line " << __LINE__ << ": asynchronous \"brain\" gives "
+				<< CountResults(logic.GetPointer()) << " results instead of " << brainResults << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// a modification that does not affect the matching keeps the running query and the cache
+	unsigned int cachedResults = logic->GetResultCache()->GetNumberOfEntries();
+	logic->StartQuery();
+	cerebellum->Modified();
+	while((state = logic->FinishQuery(visualizedResults)) == vtkSlicerFacetedVisualizerLogic::QueryRunning)
+	{
+	}
+	if(state != vtkSlicerFacetedVisualizerLogic::QueryFinished || cachedResults == 0 ||
+	   logic->GetResultCache()->GetNumberOfEntries() != cachedResults)
+	{
+		std::cerr << "Line " << __LINE__ << ": modifying a hierarchy node cancelled the query"
+				" or cleared the result cache" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// a node renamed to the name of a display candidate is shown with it
+	spare->SetName("right lobe of liver");
+	spare->GetModelNode()->SetName("right lobe of liver");
+	logic->SetQuery("liver");
+	if(!logic->ProcessQuery() || !IsShown(liver) || !IsShown(spare) || IsShown(cerebellum))
+	{
+		std::cerr << "Line " << __LINE__ << ": \"liver\" does not show the renamed model" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// a hierarchy node moved below another one is shown with its new parent
+	logic->SetQuery("cerebellum");
+	if(!logic->ProcessQuery() || !IsShown(cerebellum) || IsShown(liver))
+	{
+		std::cerr << "Line " << __LINE__ << ": \"cerebellum\" shows the liver" << std::endl;
+		return EXIT_FAILURE;
+	}
+	liver->SetParentNodeID(cerebellum->GetID());
+	if(!logic->ProcessQuery() || !IsShown(cerebellum) || !IsShown(liver))
+	{
+		std::cerr << "Line " << __LINE__ << ": \"cerebellum\" does not show the model moved below it"
+				<< std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// a hierarchy node is matched once its name and model are set, not when it is added
+	vtkNew< vtkMRMLModelHierarchyNode > cerebrum;
+	scene->AddNode(cerebrum.GetPointer());
+	cerebrum->SetName("cerebrum");
+	cerebrum->SetParentNodeID(atlas->GetID());
+	vtkNew< vtkMRMLModelNode > cerebrumModel;
+	cerebrumModel->SetName("cerebrum model");
+	scene->AddNode(cerebrumModel.GetPointer());
+	vtkNew< vtkMRMLModelDisplayNode > cerebrumDisplay;
+	scene->AddNode(cerebrumDisplay.GetPointer());
+	cerebrumModel->SetAndObserveDisplayNodeID(cerebrumDisplay->GetID());
+	cerebrum->SetAssociatedNodeID(cerebrumModel->GetID());
+	logic->SetQuery("brain");
+	if(!logic->ProcessQuery() || !IsShown(cerebrum.GetPointer()) || IsShown(spare))
+	{
+		std::cerr << "Line " << __LINE__ << ": \"brain\" does not show the added cerebrum" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -21,6 +21,8 @@
 // Qt includes
 #include <QtGui>
 #include <QTreeView>
+#include <QCompleter>
+#include <QStringListModel>
 #include <QStandardItemModel>
 #include <QPalette>
 //#include <QItemSelectionModel>
@@ -30,11 +32,14 @@
 #include "ui_qSlicerFacetedVisualizerModule.h"
 
 // logic includes
+#include "vtkFacetedVisualizerLog.h"
+#include "vtkFacetedVisualizerQueryPlan.h"
 #include "vtkSlicerFacetedVisualizerLogic.h"
 
 
 #include <vector>
 #include <string>
+#include <sstream>
 
 //-----------------------------------------------------------------------------
 /// \ingroup Slicer_QtModules_FacetedVisualizer
@@ -104,6 +109,23 @@ void qSlicerFacetedVisualizerModuleWidget::setup()
 
 	favoritesModel = new QStandardItemModel;
 
+   queryTimer = new QTimer(this);
+   queryTimer->setInterval(50);
+   connect(queryTimer, SIGNAL(timeout()), this, SLOT(onQueryTimer()));
+   queryRestarted = false;
+   d->progressBar_query->setRange(0, 100);
+   d->progressBar_query->hide();
+
+   // the completions are computed in onQueryTextChanged, the completer only shows them
+   queryCompletionModel = new QStringListModel(this);
+   queryCompleter = new QCompleter(queryCompletionModel, this);
+   queryCompleter->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+   queryCompleter->setWidget(d->lineEdit_query);
+   queryCompletionSuffixLength = 0;
+   connect(queryCompleter, SIGNAL(activated(const QString &)),
+		   this, SLOT(onQueryCompletionActivated(const QString &)));
+
+   connect(d->checkBox_profile, SIGNAL(toggled(bool)), this, SLOT(onQueryProfilingToggled(bool)));
 
    this->Superclass::setup();
   
@@ -135,7 +157,20 @@ void qSlicerFacetedVisualizerModuleWidget::onOntologyFileName()
    // sync the mrml models with the ontology file
    vtkSlicerFacetedVisualizerLogic *logic = d->logic();
    logic->SetDBFileName(path.toStdString());
-   std::cout<<" Set the Database file name .. Now synchronizing atlas with the DB... "<<std::endl;
+
+   // tell the user when lookups on this DB will scan the whole resources table
+   std::vector< std::string > unindexedPaths;
+   logic->GetUnindexedAccessPaths(unindexedPaths);
+   QString scanText = "";
+   for (unsigned int i = 0; i < unindexedPaths.size(); ++i)
+   {
+	  scanText += QString::fromStdString(unindexedPaths[i]) + "\n";
+   }
+   d->label_warning->setText(unindexedPaths.size() > 0 ?
+		   "<font color='red'>DB is not indexed, queries will be slow</font>" : "");
+   d->label_warning->setToolTip(scanText);
+
+   vtkFacetedVisualizerInfoMacro(" Set the Database file name .. Now synchronizing atlas with the DB... ");
 
    logic->SynchronizeAtlasWithDB(this->matchingDBAtoms, this->unMatchedMRMLAtoms);
 
@@ -155,7 +190,7 @@ void qSlicerFacetedVisualizerModuleWidget::onOntologyFileName()
 		 //this->GetUserMatchesForMRMLTerms(unMatchedMRMLAtoms[count]);
 	  }
    }
-   std::cout<<" Done syncrhonizing atlas with DB... "<<std::endl;
+   vtkFacetedVisualizerInfoMacro(" Done syncrhonizing atlas with DB... ");
 
 }
 
@@ -167,6 +202,52 @@ void qSlicerFacetedVisualizerModuleWidget::onQueryTextChanged(const QString &tex
 	vtkSlicerFacetedVisualizerLogic *logic = d->logic();
 
     logic->SetQuery(text.toStdString());
+
+    // no suggestions for text set from the query log or the results tree
+    if(!this->setDBFile || !d->lineEdit_query->hasFocus())
+    {
+    	return;
+    }
+    // complete the term under the cursor, as the query grammar splits the text; Latin-1
+    // keeps the offsets of the characters
+    size_t begin, end;
+    int cursor = d->lineEdit_query->cursorPosition();
+    if(!vtkFacetedVisualizerQueryPlan::FindTermAt(text.toLatin1().constData(), cursor, begin, end))
+    {
+    	queryCompleter->popup()->hide();
+    	return;
+    }
+    int start = static_cast< int >(begin);
+    QString operand = text.mid(start, cursor - start);
+    std::vector< std::string > completions;
+    logic->GetQueryTermCompletions(operand.toStdString(), 20, completions);
+    // nothing to suggest once the operand is a complete term
+    if(completions.empty() ||
+       (completions.size() == 1 && operand.compare(QString::fromStdString(completions[0]), Qt::CaseInsensitive) == 0))
+    {
+    	queryCompleter->popup()->hide();
+    	return;
+    }
+    // a completion replaces the whole term, the text after it is kept
+    QStringList items;
+    for (unsigned int i = 0; i < completions.size(); ++i)
+    {
+    	items << text.left(start) + QString::fromStdString(completions[i]) + text.mid(static_cast< int >(end));
+    }
+    queryCompletionSuffixLength = text.size() - static_cast< int >(end);
+    queryCompletionModel->setStringList(items);
+    queryCompleter->complete();
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerFacetedVisualizerModuleWidget::onQueryCompletionActivated(const QString &text)
+{
+	Q_D(qSlicerFacetedVisualizerModuleWidget);
+	// setText moves the cursor to the end and completes again from there
+	int cursor = text.size() - queryCompletionSuffixLength;
+	d->lineEdit_query->setText(text);
+	d->lineEdit_query->setCursorPosition(cursor);
+	queryCompleter->popup()->hide();
 }
 
 //-----------------------------------------------------------------------------
@@ -194,22 +275,90 @@ void qSlicerFacetedVisualizerModuleWidget::onQuery()
 		pal.setColor(QPalette::Text, Qt::red);
 		d->label_warning->setPalette(pal);
 	}
-	bool visualizedResults = logic->ProcessQuery();
+	// the query runs on a worker thread, onQueryTimer shows the results once it is done.
+	// A query still running is cancelled.
+	this->runningQuery = logic->GetQuery();
+	this->queryRestarted = false;
+	logic->StartQuery();
+	d->progressBar_query->setValue(0);
+	d->progressBar_query->show();
+	queryTimer->start();
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerFacetedVisualizerModuleWidget::onQueryTimer()
+{
+	Q_D(qSlicerFacetedVisualizerModuleWidget);
+
+	vtkSlicerFacetedVisualizerLogic *logic = d->logic();
+
+	bool visualizedResults = false;
+	int state = logic->FinishQuery(visualizedResults);
+	if(state == vtkSlicerFacetedVisualizerLogic::QueryRunning)
+	{
+		d->progressBar_query->setValue(static_cast< int >(100 * logic->GetQueryProgress()));
+		return;
+	}
+	if(state != vtkSlicerFacetedVisualizerLogic::QueryFinished && !this->queryRestarted)
+	{
+		// cancelled by the logic, e.g. the DB or the atlas changed: run it again on the new
+		// state, the text in the line edit stays the query of the next onQuery
+		this->queryRestarted = true;
+		std::string typedQuery = logic->GetQuery();
+		logic->SetQuery(this->runningQuery);
+		logic->StartQuery();
+		logic->SetQuery(typedQuery);
+		d->progressBar_query->setValue(0);
+		return;
+	}
+	queryTimer->stop();
+	d->progressBar_query->hide();
+	if(state != vtkSlicerFacetedVisualizerLogic::QueryFinished)
+	{
+		d->label_warning->setText("<font color='red'>The query was cancelled, the DB or the models"
+				" changed while it ran</font>");
+		return;
+	}
+
+	std::string error = logic->GetQueryError();
+	if(!error.empty())
+	{
+		d->label_warning->setText("<font color='red'>" + QString::fromStdString(error) + "</font>");
+	}
 
 	// display the results of query on treeview and comment box
 	this->UpdateResultsTree(visualizedResults);
 	if(queryLog.size() < maxQueryLog)
 	{
-		queryLog.push_back(logic->GetQuery());
+		queryLog.push_back(this->runningQuery);
 	}
 	else
 	{
 		queryLog.pop_front();
-		queryLog.push_back(logic->GetQuery());
+		queryLog.push_back(this->runningQuery);
 	}
 
 	// update the queryLog
 	this->UpdateQueryLogView();
+
+	if(logic->GetQueryProfiling())
+	{
+		std::ostringstream explain;
+		logic->PrintLastQueryProfile(explain);
+		d->plainTextEdit_explain->setPlainText(QString::fromStdString(explain.str()));
+	}
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerFacetedVisualizerModuleWidget::onQueryProfilingToggled(bool profiling)
+{
+	Q_D(qSlicerFacetedVisualizerModuleWidget);
+
+	d->logic()->SetQueryProfiling(profiling);
+	if(!profiling)
+	{
+		d->plainTextEdit_explain->clear();
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -270,7 +419,7 @@ void qSlicerFacetedVisualizerModuleWidget::onFavoritesItemSelected(const QItemSe
 void qSlicerFacetedVisualizerModuleWidget::onTreeItemSelected(const QItemSelection &/*oldItem*/,
 		const QItemSelection & /*newItem*/)
 {
-	std::cout<<" tree item selected.."<<std::endl;
+	vtkFacetedVisualizerDebugMacro(" tree item selected..");
 
 
 	Q_D(qSlicerFacetedVisualizerModuleWidget);
@@ -294,7 +443,7 @@ void qSlicerFacetedVisualizerModuleWidget::onTreeItemSelected(const QItemSelecti
 		seekroot = seekroot.parent();
 	  }
 	  QString parentText = currParent.data(Qt::DisplayRole).toString();
-	  std::cout<<"Selected text "<<selectedText.toStdString()<<" parent node "<<parentText.toStdString()<<std::endl;
+	  vtkFacetedVisualizerDebugMacro("Selected text "<<selectedText.toStdString()<<" parent node "<<parentText.toStdString());
 	  std::string ptext = parentText.toStdString();
 	  size_t pos = ptext.find("-");
 	  if(pos == std::string::npos)
@@ -548,8 +697,8 @@ void qSlicerFacetedVisualizerModuleWidget::onMRMLAtomChanged(const QString &text
 	// set up the tree
 	int indx = this->selectedMRMLAtomIndex;
 
-	std::cout<<" UPDATING MATCHING DB TERMS FOR "<<text.toStdString()<<" matching atoms "<<
-			this->matchingDBAtoms[indx].size()<<std::endl;
+	vtkFacetedVisualizerDebugMacro(" UPDATING MATCHING DB TERMS FOR "<<text.toStdString()<<" matching atoms "<<
+			this->matchingDBAtoms[indx].size());
 
 	QStandardItemModel *standardModel = new QStandardItemModel;
 	QStandardItem *rootNode = standardModel->invisibleRootItem();
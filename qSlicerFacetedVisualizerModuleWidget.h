@@ -33,6 +33,9 @@ class QString;
 class QItemSelectionModel;
 class QItemSelection;
 class QStandardItemModel;
+class QTimer;
+class QCompleter;
+class QStringListModel;
 
 /// \ingroup Slicer_QtModules_FacetedVisualizer
 class Q_SLICER_QTMODULES_FACETEDVISUALIZER_EXPORT qSlicerFacetedVisualizerModuleWidget :
@@ -67,6 +70,12 @@ public slots:
 
    void onCheckedFavorites();
 
+   void onQueryTimer();
+
+   void onQueryCompletionActivated(const QString &text);
+
+   void onQueryProfilingToggled(bool profiling);
+
 protected:
   QScopedPointer<qSlicerFacetedVisualizerModuleWidgetPrivate> d_ptr;
   
@@ -96,10 +105,23 @@ private:
 
   QStandardItemModel *favoritesModel;
 
+  // polls the logic for the end of the query started by onQuery, and whether the query
+  // was started again after the logic cancelled it
+  QTimer             *queryTimer;
+  bool                queryRestarted;
+
+  // type-ahead of DB terms for the operand being typed, and the length of the query text
+  // after that operand, which a completion keeps
+  QCompleter         *queryCompleter;
+  QStringListModel   *queryCompletionModel;
+  int                 queryCompletionSuffixLength;
+
   //QStandardItem      *favoritesRootNode;
   //BTX
    std::list< std::string >         queryLog;
 
+   std::string                      runningQuery;
+
    std::vector< std::string >         favoriteQueries;
 
    std::vector< std::vector< std::string > > matchingDBAtoms;